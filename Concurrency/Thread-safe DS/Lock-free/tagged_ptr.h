@@ -0,0 +1,341 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace my {
+
+	// Pointer + tag in one machine word, for lock-free structures that need a version counter against ABA
+	// or a few flag bits next to a pointer.
+	//
+	//  - the low log2(Alignment) bits of an aligned pointer are always zero, the tag goes there
+	//  - on x86-64 user-space pointers are 48-bit (bits 48-63 are copies of bit 47), so the top 16 bits hold the tag too;
+	//    get() sign-extends them back. Kernels with 5-level paging hand out wider addresses only if asked to by an mmap hint
+	//  - a tag that overflows tag_bits wraps around. With 16 + 3 bits that's 512k operations on the same node
+	//    between a thread's load and its CAS for an ABA to slip through; if that's not enough, use counted_ptr below
+	//
+	// A Treiber stack on top of it:
+	//     my::atomic_tagged_ptr<node> head;
+	//     auto old = head.load(std::memory_order_acquire);
+	//     do { n->next = old.get(); } while (!head.compare_exchange_weak(old, old.next(n)));
+	// every successful CAS bumps the tag, so a head that was popped and pushed back doesn't compare equal
+
+	template<typename T, std::size_t Alignment = alignof(T)>
+	class tagged_ptr {
+
+		static_assert(std::has_single_bit(Alignment), "the alignment must be a power of two");
+
+#if defined(__x86_64__) || defined(_M_X64)
+		static constexpr unsigned high_bits = 16;
+#else
+		static constexpr unsigned high_bits = 0;
+#endif
+		static constexpr unsigned address_bits = 64 - high_bits;
+		static constexpr unsigned low_bits = std::countr_zero(Alignment);
+		static constexpr std::uintptr_t low_mask = (std::uintptr_t(1) << low_bits) - 1;
+		static constexpr std::uintptr_t address_mask = (high_bits ? (std::uintptr_t(1) << address_bits) - 1 : ~std::uintptr_t(0)) & ~low_mask;
+
+		static_assert(sizeof(std::uintptr_t) == 8 || high_bits == 0);
+
+		std::uintptr_t bits = 0;
+
+		static std::uintptr_t pack(T* p, std::uintptr_t tag) noexcept;
+
+	public:
+		static constexpr unsigned tag_bits = low_bits + high_bits;
+		static constexpr std::uintptr_t max_tag = tag_bits == 0 ? 0 : (~std::uintptr_t(0) >> (sizeof(std::uintptr_t) * 8 - tag_bits));
+
+		constexpr tagged_ptr() noexcept = default;
+
+		// p must be Alignment-aligned; the tag is taken modulo max_tag + 1
+		explicit tagged_ptr(T* p, std::uintptr_t tag = 0) noexcept;
+
+		static constexpr tagged_ptr from_raw(std::uintptr_t raw) noexcept;
+		constexpr std::uintptr_t raw() const noexcept { return bits; }
+
+		T* get() const noexcept;
+		constexpr std::uintptr_t tag() const noexcept;
+
+		tagged_ptr with_tag(std::uintptr_t tag) const noexcept;
+		tagged_ptr with_ptr(T* p) const noexcept;
+
+		// p with this tag + 1: the value to CAS in when replacing this one
+		tagged_ptr next(T* p) const noexcept;
+
+		std::add_lvalue_reference_t<T> operator*() const noexcept { return *get(); } // void for tagged_ptr<void, N>
+		T* operator->() const noexcept { return get(); }
+		explicit operator bool() const noexcept { return get() != nullptr; }
+
+		// pointer and tag both, same as the CAS compares
+		friend constexpr bool operator==(tagged_ptr a, tagged_ptr b) noexcept { return a.bits == b.bits; }
+		friend constexpr bool operator!=(tagged_ptr a, tagged_ptr b) noexcept { return a.bits != b.bits; }
+	};
+
+
+	// std::atomic over the packed word: single-width CAS, always lock-free
+	template<typename T, std::size_t Alignment = alignof(T)>
+	class atomic_tagged_ptr {
+
+		using value_type = tagged_ptr<T, Alignment>;
+
+		std::atomic<std::uintptr_t> bits;
+
+	public:
+		static constexpr bool is_always_lock_free = std::atomic<std::uintptr_t>::is_always_lock_free;
+
+		constexpr atomic_tagged_ptr() noexcept : bits(0) {}
+		explicit atomic_tagged_ptr(value_type value) noexcept : bits(value.raw()) {}
+
+		atomic_tagged_ptr(const atomic_tagged_ptr&) = delete;
+		atomic_tagged_ptr& operator=(const atomic_tagged_ptr&) = delete;
+
+		value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept {
+			return value_type::from_raw(bits.load(order));
+		}
+
+		void store(value_type value, std::memory_order order = std::memory_order_seq_cst) noexcept {
+			bits.store(value.raw(), order);
+		}
+
+		value_type exchange(value_type value, std::memory_order order = std::memory_order_seq_cst) noexcept {
+			return value_type::from_raw(bits.exchange(value.raw(), order));
+		}
+
+		bool compare_exchange_weak(value_type& expected, value_type desired,
+			std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst) noexcept;
+
+		bool compare_exchange_strong(value_type& expected, value_type desired,
+			std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst) noexcept;
+	};
+
+
+
+	// Pointer + full 64-bit counter in two words, for when a wrapping tag isn't safe enough (or the pointer has no spare bits).
+	// atomic_counted_ptr swaps both words at once with a double-width CAS:
+	//  - x86-64: lock cmpxchg16b, if the CPU has it (cpuid, checked once; only the very first x86-64 CPUs lack it).
+	//    Inline asm rather than std::atomic<16 bytes>, which gcc routes through libatomic unless built with -mcx16
+	//  - elsewhere: std::atomic over the pair, lock-free wherever the target has a double-width CAS (e.g. AArch64 ldxp/stxp, casp)
+	//  - otherwise a spinlock picked by address - correct, just not lock-free; is_lock_free() tells which one you got
+	// Every operation is seq_cst (lock cmpxchg16b is a full barrier anyway), and load() is a CAS too, so it writes the cache line.
+
+	template<typename T>
+	struct counted_ptr {
+		T* ptr = nullptr;
+		std::uint64_t count = 0;
+
+		counted_ptr next(T* p) const noexcept { return counted_ptr{p, count + 1}; }
+
+		friend bool operator==(const counted_ptr& a, const counted_ptr& b) noexcept { return a.ptr == b.ptr && a.count == b.count; }
+		friend bool operator!=(const counted_ptr& a, const counted_ptr& b) noexcept { return !(a == b); }
+	};
+
+	// the two words a double-width CAS works on
+	struct alignas(16) double_word {
+		std::uint64_t lo;
+		std::uint64_t hi;
+	};
+
+	// true if the CPU can do a lock-free double-width CAS
+	bool has_double_width_cas() noexcept;
+
+	template<typename T>
+	class atomic_counted_ptr {
+
+		static_assert(sizeof(T*) == 8, "counted_ptr is meant for 64-bit targets");
+
+		using words = double_word; // lo is the pointer, hi the count
+
+#if defined(__x86_64__) || defined(_M_X64)
+		words value; // only ever touched by dwcas()
+#else
+		std::atomic<words> value;
+#endif
+
+		static words to_words(counted_ptr<T> c) noexcept { return words{reinterpret_cast<std::uint64_t>(c.ptr), c.count}; }
+		static counted_ptr<T> from_words(words w) noexcept { return counted_ptr<T>{reinterpret_cast<T*>(w.lo), w.hi}; }
+
+		// compares value with expected and, if equal, writes desired; otherwise expected gets the current value
+		bool dwcas(words& expected, words desired) noexcept;
+
+		static std::atomic_flag& fallback_lock(const void* address) noexcept;
+
+	public:
+		atomic_counted_ptr() noexcept : value{} {}
+		explicit atomic_counted_ptr(counted_ptr<T> initial) noexcept : value(to_words(initial)) {}
+
+		atomic_counted_ptr(const atomic_counted_ptr&) = delete;
+		atomic_counted_ptr& operator=(const atomic_counted_ptr&) = delete;
+
+		bool is_lock_free() const noexcept;
+
+		counted_ptr<T> load() noexcept;
+		void store(counted_ptr<T> desired) noexcept;
+		bool compare_exchange(counted_ptr<T>& expected, counted_ptr<T> desired) noexcept;
+	};
+
+
+
+	template<typename T, std::size_t Alignment>
+	std::uintptr_t tagged_ptr<T, Alignment>::pack(T* p, std::uintptr_t tag) noexcept {
+		std::uintptr_t address = reinterpret_cast<std::uintptr_t>(p) & address_mask;
+		std::uintptr_t high = high_bits ? (tag >> low_bits) << address_bits : 0;
+		return address | (tag & low_mask) | high;
+	}
+
+	template<typename T, std::size_t Alignment>
+	tagged_ptr<T, Alignment>::tagged_ptr(T* p, std::uintptr_t tag) noexcept : bits(pack(p, tag)) {
+		assert(get() == p && "the pointer is misaligned or not canonical");
+	}
+
+	template<typename T, std::size_t Alignment>
+	constexpr tagged_ptr<T, Alignment> tagged_ptr<T, Alignment>::from_raw(std::uintptr_t raw) noexcept {
+		tagged_ptr result;
+		result.bits = raw;
+		return result;
+	}
+
+	template<typename T, std::size_t Alignment>
+	T* tagged_ptr<T, Alignment>::get() const noexcept {
+		std::uintptr_t address = bits & address_mask;
+		if constexpr (high_bits != 0) {
+			// sign-extend bit 47 (arithmetic shift of a negative number is well-defined since C++20)
+			address = static_cast<std::uintptr_t>(static_cast<std::intptr_t>(address << high_bits) >> high_bits);
+		}
+		return reinterpret_cast<T*>(address);
+	}
+
+	template<typename T, std::size_t Alignment>
+	constexpr std::uintptr_t tagged_ptr<T, Alignment>::tag() const noexcept {
+		std::uintptr_t high = high_bits ? (bits >> address_bits) << low_bits : 0;
+		return (bits & low_mask) | high;
+	}
+
+	template<typename T, std::size_t Alignment>
+	tagged_ptr<T, Alignment> tagged_ptr<T, Alignment>::with_tag(std::uintptr_t tag) const noexcept {
+		return from_raw(pack(get(), tag));
+	}
+
+	template<typename T, std::size_t Alignment>
+	tagged_ptr<T, Alignment> tagged_ptr<T, Alignment>::with_ptr(T* p) const noexcept {
+		return tagged_ptr(p, tag());
+	}
+
+	template<typename T, std::size_t Alignment>
+	tagged_ptr<T, Alignment> tagged_ptr<T, Alignment>::next(T* p) const noexcept {
+		return tagged_ptr(p, tag() + 1);
+	}
+
+
+	template<typename T, std::size_t Alignment>
+	bool atomic_tagged_ptr<T, Alignment>::compare_exchange_weak(value_type& expected, value_type desired,
+		std::memory_order success, std::memory_order failure) noexcept {
+		std::uintptr_t raw = expected.raw();
+		bool done = bits.compare_exchange_weak(raw, desired.raw(), success, failure);
+		expected = value_type::from_raw(raw);
+		return done;
+	}
+
+	template<typename T, std::size_t Alignment>
+	bool atomic_tagged_ptr<T, Alignment>::compare_exchange_strong(value_type& expected, value_type desired,
+		std::memory_order success, std::memory_order failure) noexcept {
+		std::uintptr_t raw = expected.raw();
+		bool done = bits.compare_exchange_strong(raw, desired.raw(), success, failure);
+		expected = value_type::from_raw(raw);
+		return done;
+	}
+
+
+	inline bool has_double_width_cas() noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+		static const bool cached = [] {
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 13)) != 0; // ECX.CX16
+		}();
+		return cached;
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+		static const bool cached = [] {
+			unsigned eax, ebx, ecx, edx;
+			return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_CMPXCHG16B) != 0;
+		}();
+		return cached;
+#else
+		return std::atomic<double_word>::is_always_lock_free;
+#endif
+	}
+
+	template<typename T>
+	std::atomic_flag& atomic_counted_ptr<T>::fallback_lock(const void* address) noexcept {
+		static std::atomic_flag locks[64] = {};
+		return locks[(reinterpret_cast<std::uintptr_t>(address) >> 4) % 64];
+	}
+
+	template<typename T>
+	bool atomic_counted_ptr<T>::dwcas(words& expected, words desired) noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+		if (has_double_width_cas()) {
+#if defined(_MSC_VER)
+			return _InterlockedCompareExchange128(reinterpret_cast<volatile long long*>(&value),
+				static_cast<long long>(desired.hi), static_cast<long long>(desired.lo), reinterpret_cast<long long*>(&expected)) != 0;
+#else
+			bool done;
+			__asm__ __volatile__(
+				"lock cmpxchg16b %1"
+				: "=@ccz"(done), "+m"(value), "+a"(expected.lo), "+d"(expected.hi)
+				: "b"(desired.lo), "c"(desired.hi)
+				: "memory");
+			return done;
+#endif
+		}
+		std::atomic_flag& lock = fallback_lock(&value);
+		while (lock.test_and_set(std::memory_order_acquire)) {}
+		bool done = value.lo == expected.lo && value.hi == expected.hi;
+		if (done) value = desired;
+		else expected = value;
+		lock.clear(std::memory_order_release);
+		return done;
+#else
+		return value.compare_exchange_strong(expected, desired);
+#endif
+	}
+
+	template<typename T>
+	bool atomic_counted_ptr<T>::is_lock_free() const noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+		return has_double_width_cas();
+#else
+		return value.is_lock_free();
+#endif
+	}
+
+	template<typename T>
+	counted_ptr<T> atomic_counted_ptr<T>::load() noexcept {
+		words current{0, 0};
+		dwcas(current, current); // either fails and reads the value, or swaps 0 for 0
+		return from_words(current);
+	}
+
+	template<typename T>
+	void atomic_counted_ptr<T>::store(counted_ptr<T> desired) noexcept {
+		words current{0, 0};
+		while (!dwcas(current, to_words(desired))) {}
+	}
+
+	template<typename T>
+	bool atomic_counted_ptr<T>::compare_exchange(counted_ptr<T>& expected, counted_ptr<T> desired) noexcept {
+		words w = to_words(expected);
+		bool done = dwcas(w, to_words(desired));
+		expected = from_words(w);
+		return done;
+	}
+
+};
@@ -0,0 +1,408 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../../../../STL/flat_hash_map.h"
+#include "../../../../STL/smart_pointers/weak_ptr.h"
+
+namespace my {
+
+	// LRU cache of shared objects for many threads: the keys are split over shards by hash,
+	// each shard has its own mutex, hash map and intrusive LRU list, so threads only contend when they hit the same shard.
+	//
+	//  - get() moves the entry to the front of its shard's list, insert() evicts from the back once the shard is full
+	//    (capacity is divided evenly between the shards, so eviction is LRU per shard, not global)
+	//  - values are handed out as my::shared_ptr<V>: an evicted object lives on as long as somebody still uses it
+	//  - keep_evicted_in_use: the cache remembers a weak_ptr to every evicted object that is still in use, and a later
+	//    get() of that key takes it back (weak_ptr::lock()) instead of missing - nobody decodes a second copy of it
+	//  - evicted values are released after the shard is unlocked, their destructors never run under the lock
+	//  - get_or_load() runs the loader outside the lock: two threads missing the same key may both load it, the first insert wins
+
+	struct lru_cache_options {
+		std::size_t capacity = 1024;
+		std::size_t shards = 16;            // rounded up to a power of two
+		bool keep_evicted_in_use = false;
+	};
+
+	struct lru_shard_stats {
+		std::size_t hits = 0;
+		std::size_t weak_hits = 0;          // found only through the weak reference of an evicted entry
+		std::size_t misses = 0;
+		std::size_t evictions = 0;
+		std::size_t lock_acquisitions = 0;
+		std::size_t contended = 0;          // acquisitions that found the mutex taken and had to wait
+		std::size_t size = 0;
+	};
+
+	struct lru_cache_stats {
+		std::vector<lru_shard_stats> shards;
+		lru_shard_stats total;
+
+		double hit_rate() const noexcept {
+			std::size_t lookups = total.hits + total.weak_hits + total.misses;
+			return lookups ? double(total.hits + total.weak_hits) / double(lookups) : 0.0;
+		}
+
+		double contention_rate() const noexcept {
+			return total.lock_acquisitions ? double(total.contended) / double(total.lock_acquisitions) : 0.0;
+		}
+	};
+
+
+	template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+	class concurrent_lru_cache {
+
+		struct link {
+			link* prev;
+			link* next;
+		};
+
+		struct entry : link {
+			K key;
+			my::shared_ptr<V> value;
+
+			entry(const K& key, my::shared_ptr<V>&& value) : link{nullptr, nullptr}, key(key), value(std::move(value)) {}
+		};
+
+		// padded to a cache line, so that a busy shard doesn't slow down its neighbours
+		struct alignas(64) shard {
+			std::mutex m;
+			my::flat_hash_map<K, entry*, Hash, KeyEqual> index;
+			my::flat_hash_map<K, my::weak_ptr<V>, Hash, KeyEqual> evicted;
+			link list;                      // sentinel: list.next is the most recently used entry, list.prev the least
+			lru_shard_stats counters;       // guarded by m, like everything else here
+
+			shard() noexcept {
+				list.prev = list.next = &list;
+			}
+
+			~shard();
+
+			void unlink(link* e) noexcept;
+			void push_front(link* e) noexcept;
+			void forget_evicted(const K& key);
+			void prune_evicted();
+		};
+
+		std::unique_ptr<shard[]> shards;
+		std::size_t shard_mask;
+		std::size_t shard_capacity;
+		bool keep_evicted_in_use;
+		Hash hash;
+
+		shard& shard_for(const K& key) const;
+
+		// the lock, counted: try first, so that waiting can be told apart from just locking
+		std::unique_lock<std::mutex> lock(shard& s) const;
+
+		// under the lock; the evicted value (if any) goes to 'released', to be dropped after unlocking
+		my::shared_ptr<V> insert_locked(shard& s, const K& key, my::shared_ptr<V> value, my::shared_ptr<V>& released);
+
+		my::shared_ptr<V> find_locked(shard& s, const K& key, my::shared_ptr<V>& released);
+
+	public:
+		explicit concurrent_lru_cache(const lru_cache_options& options = {}, const Hash& hash = Hash());
+
+		concurrent_lru_cache(const concurrent_lru_cache&) = delete;
+		concurrent_lru_cache& operator=(const concurrent_lru_cache&) = delete;
+
+		~concurrent_lru_cache() = default;
+
+		// empty on a miss
+		my::shared_ptr<V> get(const K& key);
+
+		// inserts or replaces, returns the value now cached
+		my::shared_ptr<V> insert(const K& key, my::shared_ptr<V> value);
+
+		// loader() returns my::shared_ptr<V> or a V, it's called only on a miss and without any lock held
+		template<typename Loader>
+		my::shared_ptr<V> get_or_load(const K& key, Loader&& loader);
+
+		bool erase(const K& key);
+
+		void clear();
+
+		std::size_t size() const;
+
+		lru_cache_stats stats() const;
+	};
+
+
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	concurrent_lru_cache<K, V, Hash, KeyEqual>::shard::~shard() {
+		link* l = list.next;
+		while (l != &list) {
+			link* next = l->next;
+			delete static_cast<entry*>(l);
+			l = next;
+		}
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	void concurrent_lru_cache<K, V, Hash, KeyEqual>::shard::unlink(link* e) noexcept {
+		e->prev->next = e->next;
+		e->next->prev = e->prev;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	void concurrent_lru_cache<K, V, Hash, KeyEqual>::shard::push_front(link* e) noexcept {
+		e->prev = &list;
+		e->next = list.next;
+		list.next->prev = e;
+		list.next = e;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	void concurrent_lru_cache<K, V, Hash, KeyEqual>::shard::forget_evicted(const K& key) {
+		if (!evicted.empty()) evicted.erase(key);
+	}
+
+	// weak references to objects nobody uses anymore are dead weight, dropped once there are as many of them as live entries
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	void concurrent_lru_cache<K, V, Hash, KeyEqual>::shard::prune_evicted() {
+		for (auto it = evicted.begin(); it != evicted.end(); ) {
+			if (it->second.expired()) it = evicted.erase(it);
+			else ++it;
+		}
+	}
+
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	concurrent_lru_cache<K, V, Hash, KeyEqual>::concurrent_lru_cache(const lru_cache_options& options, const Hash& hash)
+		: shard_mask(std::bit_ceil(options.shards ? options.shards : 1) - 1),
+		keep_evicted_in_use(options.keep_evicted_in_use),
+		hash(hash)
+	{
+		std::size_t count = shard_mask + 1;
+		shards = std::make_unique<shard[]>(count);
+		shard_capacity = options.capacity / count ? options.capacity / count : 1;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	typename concurrent_lru_cache<K, V, Hash, KeyEqual>::shard& concurrent_lru_cache<K, V, Hash, KeyEqual>::shard_for(const K& key) const {
+		// the top bits of a multiplicative hash: std::hash of an integer is the integer itself,
+		// and the map inside the shard uses the low bits, so these must come from elsewhere
+		std::uint64_t h = static_cast<std::uint64_t>(hash(key)) * 0x9e3779b97f4a7c15ull;
+		return shards[static_cast<std::size_t>(h >> 32) & shard_mask];
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	std::unique_lock<std::mutex> concurrent_lru_cache<K, V, Hash, KeyEqual>::lock(shard& s) const {
+		std::unique_lock<std::mutex> guard(s.m, std::try_to_lock);
+		if (!guard.owns_lock()) {
+			guard.lock();
+			++s.counters.contended;
+		}
+		++s.counters.lock_acquisitions;
+		return guard;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	my::shared_ptr<V> concurrent_lru_cache<K, V, Hash, KeyEqual>::insert_locked(shard& s, const K& key, my::shared_ptr<V> value, my::shared_ptr<V>& released) {
+		s.forget_evicted(key);
+
+		auto it = s.index.find(key);
+		if (it != s.index.end()) {
+			entry* e = it->second;
+			released = std::move(e->value);
+			e->value = std::move(value);
+			s.unlink(e);
+			s.push_front(e);
+			return e->value;
+		}
+
+		entry* e;
+		if (s.index.size() >= shard_capacity) {
+			// reuse the least recently used entry for the new one
+			e = static_cast<entry*>(s.list.prev);
+			s.unlink(e);
+			s.index.erase(e->key);
+			++s.counters.evictions;
+			if (keep_evicted_in_use && e->value.use_count() > 1) {
+				if (s.evicted.size() >= shard_capacity) s.prune_evicted();
+				s.evicted.insert_or_assign(e->key, my::weak_ptr<V>(e->value));
+			}
+			released = std::move(e->value);
+			try {
+				e->key = key;
+			}
+			catch(...) {
+				delete e;
+				throw;
+			}
+			e->value = std::move(value);
+		}
+		else {
+			e = new entry(key, std::move(value));
+		}
+
+		try {
+			s.index.try_emplace(e->key, e);
+		}
+		catch(...) {
+			delete e;
+			throw;
+		}
+		s.push_front(e);
+		return e->value;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	my::shared_ptr<V> concurrent_lru_cache<K, V, Hash, KeyEqual>::find_locked(shard& s, const K& key, my::shared_ptr<V>& released) {
+		auto it = s.index.find(key);
+		if (it != s.index.end()) {
+			entry* e = it->second;
+			if (s.list.next != e) {
+				s.unlink(e);
+				s.push_front(e);
+			}
+			++s.counters.hits;
+			return e->value;
+		}
+
+		if (!s.evicted.empty()) {
+			auto ghost = s.evicted.find(key);
+			if (ghost != s.evicted.end()) {
+				my::shared_ptr<V> alive = ghost->second.lock();
+				s.evicted.erase(ghost);
+				if (alive) {
+					++s.counters.weak_hits;
+					return insert_locked(s, key, std::move(alive), released);
+				}
+			}
+		}
+
+		++s.counters.misses;
+		return my::shared_ptr<V>();
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	my::shared_ptr<V> concurrent_lru_cache<K, V, Hash, KeyEqual>::get(const K& key) {
+		shard& s = shard_for(key);
+		my::shared_ptr<V> released; // declared before the lock, so destroyed after it is released
+		auto guard = lock(s);
+		return find_locked(s, key, released);
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	my::shared_ptr<V> concurrent_lru_cache<K, V, Hash, KeyEqual>::insert(const K& key, my::shared_ptr<V> value) {
+		shard& s = shard_for(key);
+		my::shared_ptr<V> released;
+		auto guard = lock(s);
+		return insert_locked(s, key, std::move(value), released);
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	template<typename Loader>
+	my::shared_ptr<V> concurrent_lru_cache<K, V, Hash, KeyEqual>::get_or_load(const K& key, Loader&& loader) {
+		shard& s = shard_for(key);
+		{
+			my::shared_ptr<V> released;
+			auto guard = lock(s);
+			if (my::shared_ptr<V> found = find_locked(s, key, released)) {
+				return found;
+			}
+		}
+
+		my::shared_ptr<V> loaded;
+		if constexpr (std::is_convertible_v<std::invoke_result_t<Loader&>, my::shared_ptr<V>>) {
+			loaded = std::forward<Loader>(loader)();
+		}
+		else {
+			loaded = my::make_shared<V>(std::forward<Loader>(loader)());
+		}
+
+		my::shared_ptr<V> released;
+		auto guard = lock(s);
+		auto it = s.index.find(key);
+		if (it != s.index.end()) {
+			return it->second->value; // somebody else loaded it meanwhile, theirs is the one already handed out
+		}
+		return insert_locked(s, key, std::move(loaded), released);
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	bool concurrent_lru_cache<K, V, Hash, KeyEqual>::erase(const K& key) {
+		shard& s = shard_for(key);
+		entry* e = nullptr;
+		{
+			auto guard = lock(s);
+			s.forget_evicted(key);
+			auto it = s.index.find(key);
+			if (it == s.index.end()) return false;
+			e = it->second;
+			s.index.erase(it);
+			s.unlink(e);
+		}
+		delete e;
+		return true;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	void concurrent_lru_cache<K, V, Hash, KeyEqual>::clear() {
+		for (std::size_t i = 0; i <= shard_mask; ++i) {
+			shard& s = shards[i];
+			link* first;
+			link* last;
+			{
+				auto guard = lock(s);
+				if (s.list.next == &s.list) {
+					s.evicted.clear();
+					continue;
+				}
+				first = s.list.next;
+				last = s.list.prev;
+				s.list.prev = s.list.next = &s.list;
+				s.index.clear();
+				s.evicted.clear();
+			}
+			last->next = nullptr;
+			while (first) {
+				link* next = first->next;
+				delete static_cast<entry*>(first);
+				first = next;
+			}
+		}
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	std::size_t concurrent_lru_cache<K, V, Hash, KeyEqual>::size() const {
+		std::size_t total = 0;
+		for (std::size_t i = 0; i <= shard_mask; ++i) {
+			std::lock_guard<std::mutex> guard(shards[i].m);
+			total += shards[i].index.size();
+		}
+		return total;
+	}
+
+	template<typename K, typename V, typename Hash, typename KeyEqual>
+	lru_cache_stats concurrent_lru_cache<K, V, Hash, KeyEqual>::stats() const {
+		lru_cache_stats result;
+		result.shards.reserve(shard_mask + 1);
+		for (std::size_t i = 0; i <= shard_mask; ++i) {
+			lru_shard_stats current;
+			{
+				std::lock_guard<std::mutex> guard(shards[i].m); // not counted: stats() shouldn't show up in its own numbers
+				current = shards[i].counters;
+				current.size = shards[i].index.size();
+			}
+			result.total.hits += current.hits;
+			result.total.weak_hits += current.weak_hits;
+			result.total.misses += current.misses;
+			result.total.evictions += current.evictions;
+			result.total.lock_acquisitions += current.lock_acquisitions;
+			result.total.contended += current.contended;
+			result.total.size += current.size;
+			result.shards.push_back(current);
+		}
+		return result;
+	}
+
+};
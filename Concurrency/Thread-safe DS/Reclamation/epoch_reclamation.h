@@ -0,0 +1,441 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace my {
+
+	// Epoch-based reclamation (Fraser 2004): readers pay one fence per critical section instead of one per protected load.
+	//
+	//  - a reader pins itself for the whole traversal (epoch_domain::guard): it announces the global epoch it has seen
+	//  - retire() puts the node into the calling thread's limbo bag of the current epoch. The global epoch moves from e
+	//    to e + 1 only when every pinned thread has announced e, so once it reaches e + 2 nobody can still hold
+	//    a node retired in e, and the whole bag is freed at once
+	//  - a thread tries to advance the epoch every advance_interval retires; bags left by exited threads go to the domain
+	//
+	// A thread that stays pinned holds back every free in the domain (nothing can be freed safely under it).
+	// Retiring never waits for it, but memory grows, so the domain counts how many advances each pinned thread has blocked
+	// in a row and reports those over stall_threshold in stats().
+
+	class epoch_domain {
+
+		struct Retired {
+			void* ptr;
+			void (*reclaim)(void*);
+		};
+
+		struct Bag {
+			std::uint64_t epoch = 0;
+			std::vector<Retired> items;
+		};
+
+		struct Record {
+			std::atomic<std::uint64_t> announced{0};        // epoch << 1 | pinned
+			std::atomic<std::size_t> blocked_advances{0};   // advances failed because of us, in a row
+			std::atomic<bool> in_use{true};
+			Record* next = nullptr;                         // immutable once the record is published
+
+			// the owner thread's only
+			unsigned nesting = 0;
+			std::size_t retires_since_advance = 0;
+			Bag bags[3];                                    // by epoch % 3: the current epoch and the two that may still be read
+		};
+
+		// the records the calling thread holds in any domain, released when the thread exits
+		struct thread_records {
+			epoch_domain* last_domain = nullptr;
+			Record* last_record = nullptr;
+			std::vector<std::pair<epoch_domain*, Record*>> all;
+
+			~thread_records();
+		};
+
+		// a plain pointer, still readable while thread_locals are being destroyed (the default domain goes after them)
+		static thread_records*& this_thread_records() noexcept;
+		// set once the thread's thread_records are destroyed: retires from later thread_local destructors go to the orphans
+		static bool& this_thread_closed() noexcept;
+
+		std::atomic<std::uint64_t> global_epoch{2};         // starts at 2, so that 'epoch - 2' never wraps
+		std::atomic<Record*> records{nullptr};
+
+		std::mutex orphans_mutex;
+		std::vector<Bag> orphans;                           // bags of threads that have exited
+
+		std::atomic<std::size_t> total_retired{0};
+		std::atomic<std::size_t> total_reclaimed{0};
+		std::atomic<std::size_t> total_advances{0};
+
+		Record* acquire_record();
+		void release_record(Record* record) noexcept;
+		Record* record_of_this_thread();  // nullptr once the thread is closed
+
+		bool try_advance() noexcept;
+		void free_bag(Bag& bag) noexcept;
+		void collect(Record* record, std::uint64_t epoch) noexcept;
+		void collect_orphans(std::uint64_t epoch) noexcept;
+		void retire(Retired item);
+
+		template<typename T, typename D>
+		static void reclaim_with(void* p);
+
+		template<typename T, typename D>
+		static void reclaim_stateful(void* p);
+
+	public:
+		static constexpr std::size_t advance_interval = 64;
+		static constexpr std::size_t stall_threshold = 1024;
+
+		struct statistics {
+			std::uint64_t epoch;
+			std::size_t advances;
+			std::size_t retired;
+			std::size_t reclaimed;
+			std::size_t pending;          // retired, not freed yet
+			std::size_t stalled_threads;  // pinned threads that have blocked more than stall_threshold advances in a row
+			std::size_t longest_stall;    // the most advances a single pinned thread has blocked in a row
+		};
+
+		// pins the calling thread for its lifetime; nests, only the outermost one announces
+		class guard {
+
+			epoch_domain* domain;
+			Record* record;
+			bool borrowed = false;  // a record taken for this guard only, on a closed thread
+
+		public:
+			explicit guard(epoch_domain& domain = default_domain());
+
+			guard(const guard&) = delete;
+			guard& operator=(const guard&) = delete;
+
+			~guard();
+		};
+
+		epoch_domain() noexcept = default;
+
+		epoch_domain(const epoch_domain&) = delete;
+		epoch_domain& operator=(const epoch_domain&) = delete;
+
+		// no thread may be pinned and the threads that used it must have exited (except the default domain's), frees everything retired
+		~epoch_domain();
+
+		static epoch_domain& default_domain();
+
+		guard pin();
+
+		// p must be unlinked already, new readers can't reach it; freed with del once two epochs have passed
+		template<typename T, typename D = std::default_delete<T>>
+		void retire(T* p, D del = D());
+
+		// a node owned by a unique_ptr (my:: or std::), its deleter goes along
+		template<typename Owner>
+			requires requires(Owner& owner) { owner.release(); owner.get_deleter(); }
+		void retire(Owner&& node);
+
+		// tries to advance the epoch and frees this thread's and exited threads' bags that are safe by now
+		void try_reclaim();
+
+		// waits until everything retired so far may be freed (two advances), then frees this thread's share of it;
+		// for writers that want the old version gone before they go on. Never from inside a guard: it would wait for itself
+		void synchronize();
+
+		std::uint64_t epoch() const noexcept;
+
+		statistics stats() const noexcept;
+	};
+
+
+
+	inline epoch_domain& epoch_domain::default_domain() {
+		static epoch_domain domain;
+		return domain;
+	}
+
+	inline epoch_domain::~epoch_domain() {
+		// in rounds: the destructors run here may retire more, which registers the destroying thread again with a fresh record
+		for (;;) {
+			// the destroying thread may still be registered (the other ones have exited), another domain may get our address
+			if (thread_records* mine = this_thread_records()) {
+				std::erase_if(mine->all, [this](const auto& entry) { return entry.first == this; });
+				if (mine->last_domain == this) {
+					mine->last_domain = nullptr;
+					mine->last_record = nullptr;
+				}
+			}
+
+			Record* list = records.exchange(nullptr, std::memory_order_acquire);
+			std::vector<Bag> left;
+			left.swap(orphans);
+			if (!list && left.empty()) break;
+
+			for (Record* record = list; record; ) {
+				Record* next = record->next;
+				for (Bag& bag : record->bags) free_bag(bag);
+				delete record;
+				record = next;
+			}
+			for (Bag& bag : left) free_bag(bag);
+		}
+	}
+
+
+	inline epoch_domain::thread_records::~thread_records() {
+		for (auto& [domain, record] : all) {
+			domain->release_record(record);
+		}
+		this_thread_records() = nullptr;
+		this_thread_closed() = true;
+	}
+
+	inline epoch_domain::thread_records*& epoch_domain::this_thread_records() noexcept {
+		static thread_local thread_records* current = nullptr;
+		return current;
+	}
+
+	inline bool& epoch_domain::this_thread_closed() noexcept {
+		static thread_local bool closed = false;
+		return closed;
+	}
+
+	inline epoch_domain::Record* epoch_domain::acquire_record() {
+		for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+			bool expected = false;
+			if (!record->in_use.load(std::memory_order_relaxed)
+				&& record->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return record;
+			}
+		}
+		// records are never removed, so the list only grows at the head
+		Record* record = new Record;
+		Record* head = records.load(std::memory_order_relaxed);
+		do {
+			record->next = head;
+		} while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+		return record;
+	}
+
+	inline void epoch_domain::release_record(Record* record) noexcept {
+		{
+			std::lock_guard<std::mutex> lock(orphans_mutex);
+			for (Bag& bag : record->bags) {
+				if (!bag.items.empty()) orphans.push_back(std::move(bag));
+				bag = Bag();
+			}
+		}
+		record->nesting = 0;
+		record->retires_since_advance = 0;
+		record->announced.store(0, std::memory_order_release);
+		record->blocked_advances.store(0, std::memory_order_relaxed);
+		record->in_use.store(false, std::memory_order_release);
+	}
+
+	inline epoch_domain::Record* epoch_domain::record_of_this_thread() {
+		if (thread_records* current = this_thread_records(); current && current->last_domain == this) {
+			return current->last_record;
+		}
+		if (this_thread_closed()) return nullptr; // 'mine' is destroyed, it mustn't be brought back
+		static thread_local thread_records mine;
+		this_thread_records() = &mine;
+		Record* record = nullptr;
+		for (auto& [domain, r] : mine.all) {
+			if (domain == this) record = r;
+		}
+		if (!record) {
+			record = acquire_record();
+			mine.all.emplace_back(this, record);
+		}
+		mine.last_domain = this;
+		mine.last_record = record;
+		return record;
+	}
+
+
+	inline epoch_domain::guard::guard(epoch_domain& domain) : domain(&domain), record(domain.record_of_this_thread()) {
+		if (!record) {
+			record = domain.acquire_record();
+			borrowed = true;
+		}
+		if (record->nesting++ != 0) return;
+		std::uint64_t epoch = domain.global_epoch.load(std::memory_order_relaxed);
+		record->announced.store(epoch << 1 | 1u, std::memory_order_relaxed);
+		// the only fence of the critical section: the announcement is visible before any node is read,
+		// so an advancer either sees us pinned or we see the nodes as already unlinked
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	inline epoch_domain::guard::~guard() {
+		if (--record->nesting != 0) return;
+		record->announced.store(0, std::memory_order_release); // our reads happen before whatever the advancer frees
+		if (borrowed) domain->release_record(record);
+	}
+
+	inline epoch_domain::guard epoch_domain::pin() {
+		return guard(*this);
+	}
+
+
+	inline bool epoch_domain::try_advance() noexcept {
+		std::uint64_t epoch = global_epoch.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in guard()
+
+		bool blocked = false;
+		for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+			std::uint64_t announced = record->announced.load(std::memory_order_acquire);
+			if ((announced & 1u) && (announced >> 1) != epoch) {
+				record->blocked_advances.fetch_add(1, std::memory_order_relaxed);
+				blocked = true; // keep going, so that every thread holding us back gets counted
+			}
+			else if (record->blocked_advances.load(std::memory_order_relaxed) != 0) {
+				record->blocked_advances.store(0, std::memory_order_relaxed);
+			}
+		}
+		if (blocked) return false;
+
+		if (global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			total_advances.fetch_add(1, std::memory_order_relaxed);
+		}
+		return true; // somebody has advanced it, us or another thread
+	}
+
+	// the items are taken out of the bag first: a destructor may retire more nodes, into this very bag
+	inline void epoch_domain::free_bag(Bag& bag) noexcept {
+		std::vector<Retired> items;
+		items.swap(bag.items);
+		for (Retired& item : items) {
+			item.reclaim(item.ptr);
+		}
+		total_reclaimed.fetch_add(items.size(), std::memory_order_relaxed);
+		if (bag.items.empty()) {
+			items.clear();
+			bag.items.swap(items); // keeps the capacity, the next epoch's retires don't allocate
+		}
+	}
+
+	// frees the bags of the record that were filled two epochs ago or earlier
+	inline void epoch_domain::collect(Record* record, std::uint64_t epoch) noexcept {
+		for (Bag& bag : record->bags) {
+			if (!bag.items.empty() && bag.epoch + 2 <= epoch) {
+				free_bag(bag);
+			}
+		}
+	}
+
+	inline void epoch_domain::collect_orphans(std::uint64_t epoch) noexcept {
+		std::vector<Bag> safe;
+		{
+			std::unique_lock<std::mutex> lock(orphans_mutex, std::try_to_lock);
+			if (!lock.owns_lock() || orphans.empty()) return;
+			auto last = std::partition(orphans.begin(), orphans.end(), [epoch](const Bag& bag) { return bag.epoch + 2 > epoch; });
+			safe.assign(std::make_move_iterator(last), std::make_move_iterator(orphans.end()));
+			orphans.erase(last, orphans.end());
+		}
+		for (Bag& bag : safe) free_bag(bag); // outside the lock, destructors may retire more
+	}
+
+	inline void epoch_domain::retire(Retired item) {
+		Record* record = record_of_this_thread();
+		total_retired.fetch_add(1, std::memory_order_relaxed);
+
+		std::uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+		if (!record) {
+			// a thread_local destructor on a closed thread: a bag of its own, as if the thread had exited right after
+			Bag orphan;
+			orphan.epoch = epoch;
+			orphan.items.push_back(item);
+			std::lock_guard<std::mutex> lock(orphans_mutex);
+			orphans.push_back(std::move(orphan));
+			return;
+		}
+		Bag& bag = record->bags[epoch % 3];
+		if (bag.epoch != epoch) {
+			// the bag was last filled three or more epochs ago, so it's safe. The epoch is set first,
+			// so the retires of the destructors go into the bag as the current epoch's, instead of freeing it again
+			bag.epoch = epoch;
+			free_bag(bag);
+		}
+		bag.items.push_back(item);
+
+		if (++record->retires_since_advance >= advance_interval) {
+			record->retires_since_advance = 0;
+			try_reclaim();
+		}
+	}
+
+	inline void epoch_domain::try_reclaim() {
+		try_advance();
+		std::uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+		if (Record* record = record_of_this_thread()) collect(record, epoch);
+		collect_orphans(epoch);
+	}
+
+	inline void epoch_domain::synchronize() {
+		std::uint64_t target = global_epoch.load(std::memory_order_acquire) + 2;
+		while (global_epoch.load(std::memory_order_acquire) < target) {
+			if (!try_advance()) std::this_thread::yield();
+		}
+		std::uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+		if (Record* record = record_of_this_thread()) collect(record, epoch);
+		collect_orphans(epoch);
+	}
+
+	inline std::uint64_t epoch_domain::epoch() const noexcept {
+		return global_epoch.load(std::memory_order_acquire);
+	}
+
+	template<typename T, typename D>
+	void epoch_domain::reclaim_with(void* p) {
+		D()(static_cast<T*>(p));
+	}
+
+	template<typename T, typename D>
+	void epoch_domain::reclaim_stateful(void* p) {
+		std::unique_ptr<std::pair<T*, D>> holder(static_cast<std::pair<T*, D>*>(p));
+		holder->second(holder->first);
+	}
+
+	template<typename T, typename D>
+	void epoch_domain::retire(T* p, D del) {
+		if (!p) return;
+		if constexpr (std::is_empty_v<D> && std::is_default_constructible_v<D>) {
+			retire(Retired{const_cast<void*>(static_cast<const void*>(p)), &reclaim_with<T, D>});
+		}
+		else {
+			// a deleter with state needs a place to live until the free
+			auto* holder = new std::pair<T*, D>(p, std::move(del));
+			retire(Retired{holder, &reclaim_stateful<T, D>});
+		}
+	}
+
+	template<typename Owner>
+		requires requires(Owner& owner) { owner.release(); owner.get_deleter(); }
+	void epoch_domain::retire(Owner&& node) {
+		auto del = std::move(node.get_deleter());
+		retire(node.release(), std::move(del));
+	}
+
+
+	inline epoch_domain::statistics epoch_domain::stats() const noexcept {
+		statistics result{};
+		result.epoch = global_epoch.load(std::memory_order_relaxed);
+		result.advances = total_advances.load(std::memory_order_relaxed);
+		result.retired = total_retired.load(std::memory_order_relaxed);
+		result.reclaimed = total_reclaimed.load(std::memory_order_relaxed);
+		result.pending = result.retired - result.reclaimed;
+		for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+			std::uint64_t announced = record->announced.load(std::memory_order_relaxed);
+			if (!(announced & 1u)) continue;
+			std::size_t blocked = record->blocked_advances.load(std::memory_order_relaxed);
+			if (blocked > stall_threshold) ++result.stalled_threads;
+			result.longest_stall = std::max(result.longest_stall, blocked);
+		}
+		return result;
+	}
+
+};
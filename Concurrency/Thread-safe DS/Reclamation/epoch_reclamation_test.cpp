@@ -0,0 +1,194 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "epoch_reclamation.h"
+#include "../../../STL/smart_pointers/unique_ptr.h"
+
+// Stress test for my::epoch_domain: readers traversing while writers replace and retire nodes, stalled readers,
+// nodes whose destructors retire more nodes (as trees and lists do with their children), and retires during thread exit.
+
+static std::atomic<long> live{0};
+
+struct node {
+	int value;
+	std::atomic<int> destroyed{0};
+
+	explicit node(int value) : value(value) {
+		++live;
+	}
+
+	~node() {
+		assert(destroyed.exchange(1) == 0); // exactly once
+		--live;
+	}
+};
+
+struct counting_delete {
+	int* calls;
+
+	void operator()(node* p) const {
+		++*calls;
+		delete p;
+	}
+};
+
+static void pinned_reader_holds_back() {
+	my::epoch_domain domain;
+	{
+		my::epoch_domain::guard g = domain.pin();
+		domain.retire(new node(1));
+		for (int i = 0; i != 10; ++i) domain.try_reclaim();
+		assert(live == 1);
+		my::epoch_domain::statistics s = domain.stats();
+		assert(s.pending == 1 && s.longest_stall > 0);
+	}
+	for (int i = 0; i != 3; ++i) domain.try_reclaim();
+	assert(live == 0);
+
+	int calls = 0;
+	domain.retire(my::unique_ptr<node, counting_delete>(new node(2), counting_delete{&calls}));
+	domain.retire(std::unique_ptr<node>(new node(3)));
+	for (int i = 0; i != 3; ++i) domain.try_reclaim();
+	assert(live == 0 && calls == 1);
+}
+
+// 3 readers sum a table of 64 slots, 2 writers replace the nodes and retire the old ones
+static void readers_and_writers(int replaces) {
+	my::epoch_domain& domain = my::epoch_domain::default_domain();
+	std::atomic<node*> slots[64];
+	for (auto& slot : slots) slot.store(new node(0));
+
+	std::atomic<bool> stop{false};
+	std::vector<std::thread> readers;
+	for (int t = 0; t != 3; ++t) {
+		readers.emplace_back([&] {
+			while (!stop) {
+				my::epoch_domain::guard g;
+				for (auto& slot : slots) {
+					node* n = slot.load(std::memory_order_acquire);
+					assert(n->destroyed == 0);
+				}
+			}
+		});
+	}
+	std::vector<std::thread> writers;
+	for (int t = 0; t != 2; ++t) {
+		writers.emplace_back([&, t] {
+			for (int i = 0; i != replaces; ++i) {
+				node* old = slots[(i * 7 + t) % 64].exchange(new node(i));
+				domain.retire(old);
+			}
+		});
+	}
+	for (std::thread& w : writers) w.join();
+	stop = true;
+	for (std::thread& r : readers) r.join();
+
+	for (auto& slot : slots) domain.retire(slot.load());
+	for (int i = 0; i != 4; ++i) domain.try_reclaim(); // the writers' bags are orphans by now
+	assert(live == 0);
+}
+
+static void stalled_reader_reported() {
+	my::epoch_domain domain;
+	std::atomic<bool> release{false};
+	std::atomic<bool> pinned{false};
+	std::thread reader([&] {
+		my::epoch_domain::guard g(domain);
+		pinned = true;
+		while (!release) std::this_thread::yield();
+	});
+	while (!pinned) std::this_thread::yield();
+
+	for (int i = 0; i != 5000; ++i) domain.retire(new node(i));
+	for (int i = 0; i != 2000; ++i) domain.try_reclaim();
+	assert(domain.stats().stalled_threads == 1);
+
+	release = true;
+	reader.join();
+	for (int i = 0; i != 3; ++i) domain.try_reclaim();
+	assert(domain.stats().stalled_threads == 0 && live == 0);
+}
+
+// a chain whose nodes retire their successor when they are destroyed: the retires happen while a bag is being freed
+struct chain_node {
+	my::epoch_domain* domain;
+	chain_node* next;
+
+	chain_node(my::epoch_domain* domain, chain_node* next) : domain(domain), next(next) {
+		++live;
+	}
+
+	~chain_node() {
+		if (next) domain->retire(next);
+		--live;
+	}
+};
+
+static chain_node* make_chain(my::epoch_domain* domain, int length) {
+	chain_node* head = nullptr;
+	for (int i = 0; i != length; ++i) head = new chain_node(domain, head);
+	return head;
+}
+
+static void nested_retire() {
+	{
+		my::epoch_domain domain;
+		for (int i = 0; i != 2000; ++i) {
+			domain.retire(make_chain(&domain, 8)); // every advance_interval retires frees the safe bags
+		}
+		for (int i = 0; i != 64; ++i) domain.try_reclaim();
+		assert(live == 0);
+	}
+	{
+		my::epoch_domain domain;
+		for (int i = 0; i != 100; ++i) domain.retire(make_chain(&domain, 8));
+	} // the destructor frees them, and what they retire on the way
+	assert(live == 0);
+}
+
+// a thread_local constructed before the thread's first guard is destroyed after the thread's records:
+// what it retires from its destructor goes to the orphans, the records aren't touched again
+struct late_retirer {
+	my::epoch_domain* domain = nullptr;
+	node* owned = nullptr;
+
+	~late_retirer() {
+		if (!owned) return;
+		my::epoch_domain::guard g(*domain);
+		domain->retire(owned);
+	}
+};
+
+static void retire_after_thread_exit(int threads) {
+	my::epoch_domain domain;
+	for (int t = 0; t != threads; ++t) {
+		std::thread([&domain, t] {
+			static thread_local late_retirer retirer;
+			retirer.domain = &domain;
+			retirer.owned = new node(t);
+			my::epoch_domain::guard g(domain);
+			domain.retire(new node(t));
+		}).join();
+	}
+	for (int i = 0; i != 3; ++i) domain.try_reclaim();
+	assert(live == 0);
+	my::epoch_domain::statistics s = domain.stats();
+	assert(s.retired == 2 * std::size_t(threads) && s.pending == 0);
+}
+
+int main() {
+	pinned_reader_holds_back();
+	readers_and_writers(100000);
+	stalled_reader_reported();
+	nested_retire();
+	retire_after_thread_exit(16);
+
+	my::epoch_domain::statistics s = my::epoch_domain::default_domain().stats();
+	std::printf("epoch_reclamation_test: epoch %llu, retired %zu, reclaimed %zu\n", static_cast<unsigned long long>(s.epoch), s.retired, s.reclaimed);
+	return 0;
+}
@@ -0,0 +1,498 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace my {
+
+	// Hazard pointers (Michael 2004, the interface follows P2530): a lock-free structure unlinks a node and retires it,
+	// the node is freed only once no thread has it in one of its hazard slots.
+	//
+	//  - a reader publishes the pointer it is about to dereference in a slot it owns, then checks that the pointer
+	//    is still reachable (protect() does that in a loop), from then on the node can't be freed under it
+	//  - retire() pushes the node onto the domain's lock-free retired list; once the list is longer than
+	//    max(scan_base, 2 * number of slots), the retiring thread scans (unless another one already does): it takes
+	//    the whole list, reads all the slots and frees whatever isn't protected. Each scan frees at least half of what it looked at, so the cost per retire is amortised O(1)
+	//  - slots are records in a never-shrinking list, a thread keeps a few of them cached so that make_hazard_pointer()
+	//    usually doesn't touch shared memory at all
+	//  - every node is stamped when it's retired, the scan that frees it adds its age to a power-of-two histogram:
+	//    stats() reports the retire-to-free latency (a scanner that gets preempted delays everybody's frees)
+
+	class hazard_pointer_domain;
+	class hazard_pointer;
+
+	namespace hazard_detail {
+		struct record_cache;
+	};
+
+	hazard_pointer_domain& hazard_pointer_default_domain() noexcept;
+
+
+	// what the domain keeps in its retired list, hazard_pointer_obj_base derives from it
+	struct hazard_retired_node {
+		hazard_retired_node* next_retired = nullptr;
+		const void* protected_address = nullptr;           // the address readers publish, i.e. the T*
+		void (*reclaim)(hazard_retired_node*) = nullptr;   // runs the deleter
+		std::int64_t retired_at = 0;                       // steady_clock nanoseconds, for the latency histogram
+	};
+
+
+	class hazard_pointer_domain {
+
+		friend class hazard_pointer;
+		friend struct hazard_detail::record_cache;
+		friend hazard_pointer make_hazard_pointer(hazard_pointer_domain& domain);
+
+		struct Record {
+			std::atomic<const void*> hazard{nullptr};
+			std::atomic<bool> active{true};
+			Record* next = nullptr;                        // immutable once the record is published
+		};
+
+		std::atomic<Record*> records{nullptr};
+		std::atomic<std::size_t> num_records{0};
+
+		std::atomic<hazard_retired_node*> retired{nullptr};
+		std::atomic<std::size_t> num_retired{0};
+		std::atomic<bool> scanning{false};                 // one scan at a time, the others go on retiring
+
+		std::atomic<std::size_t> total_retired{0};
+		std::atomic<std::size_t> total_reclaimed{0};
+		std::atomic<std::size_t> total_scans{0};
+
+		// retire-to-free ages of everything scan() has freed; written by the scanner only, read by stats()
+		static constexpr std::size_t latency_buckets = 65;   // bucket b: ages in [2^(b-1), 2^b) ns, bucket 0: 0 ns
+		std::atomic<std::size_t> latency_histogram[latency_buckets] = {};
+		std::atomic<std::int64_t> total_latency_ns{0};
+		std::atomic<std::int64_t> max_latency_ns{0};
+
+		static std::int64_t now_ns() noexcept;
+		std::chrono::nanoseconds latency_percentile(double fraction, std::size_t freed) const noexcept;
+
+		Record* acquire_record();
+		void release_record(Record* record) noexcept;
+
+		void push_retired(hazard_retired_node* first, hazard_retired_node* last, std::size_t count) noexcept;
+		void scan();
+		bool try_scan();
+
+	public:
+		static constexpr std::size_t scan_base = 64;
+
+		struct statistics {
+			std::size_t retired;     // retire() calls so far
+			std::size_t reclaimed;   // objects freed so far
+			std::size_t scans;
+			std::size_t pending;     // retired, not freed yet
+			std::size_t slots;       // hazard records ever created
+
+			// retire() to free, over everything scans have freed so far; the percentiles are upper bounds, within 2x
+			std::chrono::nanoseconds mean_latency;
+			std::chrono::nanoseconds median_latency;
+			std::chrono::nanoseconds p99_latency;
+			std::chrono::nanoseconds max_latency;
+		};
+
+		hazard_pointer_domain() noexcept = default;
+
+		hazard_pointer_domain(const hazard_pointer_domain&) = delete;
+		hazard_pointer_domain& operator=(const hazard_pointer_domain&) = delete;
+
+		// no hazard_pointer of this domain may be alive, whatever is still retired gets freed
+		~hazard_pointer_domain();
+
+		void retire(hazard_retired_node* node);
+
+		// scans right away, e.g. before checking that memory went back, or at a quiet point of the program
+		void cleanup();
+
+		statistics stats() const noexcept;
+	};
+
+
+	// owns one hazard slot; move-only, an empty one (default constructed or moved from) owns nothing
+	class hazard_pointer {
+
+		friend hazard_pointer make_hazard_pointer(hazard_pointer_domain& domain);
+
+		hazard_pointer_domain* domain;
+		hazard_pointer_domain::Record* record;
+
+		hazard_pointer(hazard_pointer_domain* domain, hazard_pointer_domain::Record* record) noexcept;
+
+	public:
+		hazard_pointer() noexcept;
+
+		hazard_pointer(const hazard_pointer&) = delete;
+
+		hazard_pointer(hazard_pointer&& other) noexcept;
+
+		hazard_pointer& operator=(const hazard_pointer&) = delete;
+
+		hazard_pointer& operator=(hazard_pointer&& other) noexcept;
+
+		~hazard_pointer();
+
+		bool empty() const noexcept;
+
+		// publishes the pointer src holds and returns it once it is known to be still there, so it's safe to dereference
+		// until the protection is reset or moved to another pointer
+		template<typename T>
+		T* protect(const std::atomic<T*>& src) noexcept;
+
+		// one attempt of protect(): false (with ptr updated to the new value) if src has changed meanwhile
+		template<typename T>
+		bool try_protect(T*& ptr, const std::atomic<T*>& src) noexcept;
+
+		// publishes ptr without any check, for pointers the caller knows to be alive (e.g. reached through another protected node)
+		template<typename T>
+		void reset_protection(const T* ptr) noexcept;
+
+		void reset_protection(std::nullptr_t = nullptr) noexcept;
+
+		void swap(hazard_pointer& other) noexcept;
+	};
+
+	hazard_pointer make_hazard_pointer(hazard_pointer_domain& domain = hazard_pointer_default_domain());
+
+
+	// mixin for nodes of lock-free structures:
+	//     struct Node : my::hazard_pointer_obj_base<Node> { ... };
+	//     old_head.release()->retire();   // a node owned by a unique_ptr gives up ownership to the domain
+	template<typename T, typename D = std::default_delete<T>>
+	class hazard_pointer_obj_base : private hazard_retired_node {
+
+		friend class hazard_pointer_domain;
+
+		D deleter;
+
+		static void reclaim_this(hazard_retired_node* node) {
+			auto* self = static_cast<hazard_pointer_obj_base*>(node);
+			D del = std::move(self->deleter);
+			del(static_cast<T*>(self));
+		}
+
+	protected:
+		hazard_pointer_obj_base() = default;
+		hazard_pointer_obj_base(const hazard_pointer_obj_base&) : hazard_retired_node() {}
+		hazard_pointer_obj_base(hazard_pointer_obj_base&&) : hazard_retired_node() {}
+		hazard_pointer_obj_base& operator=(const hazard_pointer_obj_base&) { return *this; }
+		hazard_pointer_obj_base& operator=(hazard_pointer_obj_base&&) { return *this; }
+		~hazard_pointer_obj_base() = default;
+
+	public:
+		// the object must be unreachable for new readers already; it's freed with 'del' once no hazard pointer holds it
+		void retire(D del = D(), hazard_pointer_domain& domain = hazard_pointer_default_domain());
+	};
+
+	// a node held by a unique_ptr (my:: or std::), its deleter goes along
+	template<typename Owner>
+		requires requires(Owner& owner) { owner.release()->retire(std::move(owner.get_deleter())); }
+	void hazard_retire(Owner&& node, hazard_pointer_domain& domain = hazard_pointer_default_domain());
+
+
+
+	// per-thread cache of free records of the default domain, handed back to the domain when the thread exits
+	namespace hazard_detail {
+
+		struct record_cache {
+			static constexpr std::size_t capacity = 8;
+
+			hazard_pointer_domain* domain = nullptr;
+			void* records[capacity];
+			std::size_t size = 0;
+
+			~record_cache();
+		};
+
+		inline thread_local record_cache cache;
+
+		// set by ~record_cache: a hazard_pointer destroyed later (by another thread_local's destructor) must not use the cache.
+		// Trivially destructible, so still readable then
+		inline thread_local bool cache_closed = false;
+
+	};
+
+
+	inline hazard_pointer_domain& hazard_pointer_default_domain() noexcept {
+		static hazard_pointer_domain domain;
+		return domain;
+	}
+
+
+	inline hazard_pointer_domain::~hazard_pointer_domain() {
+		// in rounds: the deleters run here may retire more (a node its children), onto a fresh list
+		while (hazard_retired_node* list = retired.exchange(nullptr, std::memory_order_acquire)) {
+			while (list) {
+				hazard_retired_node* next = list->next_retired;
+				list->reclaim(list);
+				list = next;
+			}
+		}
+		Record* record = records.load(std::memory_order_acquire);
+		while (record) {
+			Record* next = record->next;
+			delete record;
+			record = next;
+		}
+	}
+
+	inline hazard_pointer_domain::Record* hazard_pointer_domain::acquire_record() {
+		for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+			bool expected = false;
+			if (!record->active.load(std::memory_order_relaxed)
+				&& record->active.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return record;
+			}
+		}
+		// all taken, publish a new one; records are never removed, so the list can only grow at the head
+		Record* record = new Record;
+		Record* head = records.load(std::memory_order_relaxed);
+		do {
+			record->next = head;
+		} while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+		num_records.fetch_add(1, std::memory_order_relaxed);
+		return record;
+	}
+
+	inline void hazard_pointer_domain::release_record(Record* record) noexcept {
+		record->hazard.store(nullptr, std::memory_order_release);
+		record->active.store(false, std::memory_order_release);
+	}
+
+	inline void hazard_pointer_domain::push_retired(hazard_retired_node* first, hazard_retired_node* last, std::size_t count) noexcept {
+		hazard_retired_node* head = retired.load(std::memory_order_relaxed);
+		do {
+			last->next_retired = head;
+		} while (!retired.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+		num_retired.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	inline std::int64_t hazard_pointer_domain::now_ns() noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	inline void hazard_pointer_domain::retire(hazard_retired_node* node) {
+		total_retired.fetch_add(1, std::memory_order_relaxed);
+		node->retired_at = now_ns();
+		push_retired(node, node, 1);
+		std::size_t threshold = std::max(scan_base, 2 * num_records.load(std::memory_order_relaxed));
+		if (num_retired.load(std::memory_order_relaxed) >= threshold) {
+			try_scan();
+		}
+	}
+
+	inline void hazard_pointer_domain::cleanup() {
+		while (!try_scan()) {
+			std::this_thread::yield();
+		}
+	}
+
+	inline bool hazard_pointer_domain::try_scan() {
+		if (scanning.exchange(true, std::memory_order_acquire)) return false;
+		struct unlock {
+			std::atomic<bool>& flag;
+			~unlock() { flag.store(false, std::memory_order_release); }
+		} guard{scanning};
+		scan();
+		return true;
+	}
+
+	inline void hazard_pointer_domain::scan() {
+		hazard_retired_node* list = retired.exchange(nullptr, std::memory_order_acquire);
+		if (!list) return;
+		total_scans.fetch_add(1, std::memory_order_relaxed);
+
+		// pairs with the fence in try_protect(): either the reader sees the node unlinked, or we see its hazard
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		std::vector<const void*> hazards;
+		hazards.reserve(num_records.load(std::memory_order_relaxed));
+		for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+			if (const void* hazard = record->hazard.load(std::memory_order_acquire)) {
+				hazards.push_back(hazard);
+			}
+		}
+		std::sort(hazards.begin(), hazards.end());
+
+		hazard_retired_node* kept_first = nullptr;
+		hazard_retired_node* kept_last = nullptr;
+		std::size_t taken = 0;
+		std::size_t kept = 0;
+		std::size_t histogram[latency_buckets] = {};
+		std::int64_t now = now_ns();
+		std::int64_t sum_age = 0;
+		std::int64_t max_age = 0;
+		while (list) {
+			hazard_retired_node* next = list->next_retired;
+			++taken;
+			if (std::binary_search(hazards.begin(), hazards.end(), list->protected_address)) {
+				list->next_retired = kept_first;
+				kept_first = list;
+				if (!kept_last) kept_last = list;
+				++kept;
+			}
+			else {
+				std::int64_t age = std::max<std::int64_t>(now - list->retired_at, 0);
+				++histogram[std::bit_width(static_cast<std::uint64_t>(age))];
+				sum_age += age;
+				max_age = std::max(max_age, age);
+				list->reclaim(list);
+			}
+			list = next;
+		}
+
+		for (std::size_t b = 0; b != latency_buckets; ++b) {
+			if (histogram[b]) latency_histogram[b].fetch_add(histogram[b], std::memory_order_relaxed);
+		}
+		total_latency_ns.fetch_add(sum_age, std::memory_order_relaxed);
+		if (max_age > max_latency_ns.load(std::memory_order_relaxed)) max_latency_ns.store(max_age, std::memory_order_relaxed);
+		num_retired.fetch_sub(taken, std::memory_order_relaxed);
+		total_reclaimed.fetch_add(taken - kept, std::memory_order_relaxed);
+		if (kept_first) {
+			push_retired(kept_first, kept_last, kept);
+		}
+	}
+
+	// the upper bound of the bucket holding the given fraction of the frees, or the maximum if that's lower
+	inline std::chrono::nanoseconds hazard_pointer_domain::latency_percentile(double fraction, std::size_t freed) const noexcept {
+		std::int64_t max_age = max_latency_ns.load(std::memory_order_relaxed);
+		std::size_t rank = static_cast<std::size_t>(fraction * static_cast<double>(freed));
+		std::size_t seen = 0;
+		for (std::size_t b = 0; b != latency_buckets; ++b) {
+			seen += latency_histogram[b].load(std::memory_order_relaxed);
+			if (seen > rank) {
+				return std::chrono::nanoseconds(b == 0 ? 0 : b >= 63 ? max_age : std::min(std::int64_t(1) << b, max_age));
+			}
+		}
+		return std::chrono::nanoseconds(max_age);
+	}
+
+	inline hazard_pointer_domain::statistics hazard_pointer_domain::stats() const noexcept {
+		statistics result{};
+		result.retired = total_retired.load(std::memory_order_relaxed);
+		result.reclaimed = total_reclaimed.load(std::memory_order_relaxed);
+		result.scans = total_scans.load(std::memory_order_relaxed);
+		result.pending = result.retired - result.reclaimed;
+		result.slots = num_records.load(std::memory_order_relaxed);
+
+		std::size_t freed = 0;
+		for (const auto& bucket : latency_histogram) freed += bucket.load(std::memory_order_relaxed);
+		if (freed != 0) {
+			result.mean_latency = std::chrono::nanoseconds(total_latency_ns.load(std::memory_order_relaxed) / static_cast<std::int64_t>(freed));
+			result.median_latency = latency_percentile(0.5, freed);
+			result.p99_latency = latency_percentile(0.99, freed);
+			result.max_latency = std::chrono::nanoseconds(max_latency_ns.load(std::memory_order_relaxed));
+		}
+		return result;
+	}
+
+
+	inline hazard_detail::record_cache::~record_cache() {
+		cache_closed = true;
+		for (std::size_t i = 0; i != size; ++i) {
+			domain->release_record(static_cast<hazard_pointer_domain::Record*>(records[i]));
+		}
+		size = 0;
+	}
+
+
+	inline hazard_pointer::hazard_pointer() noexcept : domain(nullptr), record(nullptr) {}
+
+	inline hazard_pointer::hazard_pointer(hazard_pointer_domain* domain, hazard_pointer_domain::Record* record) noexcept
+		: domain(domain), record(record) {}
+
+	inline hazard_pointer::hazard_pointer(hazard_pointer&& other) noexcept : domain(other.domain), record(other.record) {
+		other.domain = nullptr;
+		other.record = nullptr;
+	}
+
+	inline hazard_pointer& hazard_pointer::operator=(hazard_pointer&& other) noexcept {
+		hazard_pointer tmp(std::move(other));
+		swap(tmp);
+		return *this;
+	}
+
+	inline hazard_pointer::~hazard_pointer() {
+		if (!record) return;
+		if (domain == &hazard_pointer_default_domain() && !hazard_detail::cache_closed && hazard_detail::cache.size != hazard_detail::cache.capacity) {
+			auto& cache = hazard_detail::cache;
+			record->hazard.store(nullptr, std::memory_order_release);
+			cache.domain = domain;
+			cache.records[cache.size++] = record; // stays active, nobody else can take it
+		}
+		else {
+			domain->release_record(record);
+		}
+	}
+
+	inline bool hazard_pointer::empty() const noexcept {
+		return record == nullptr;
+	}
+
+	template<typename T>
+	T* hazard_pointer::protect(const std::atomic<T*>& src) noexcept {
+		T* ptr = src.load(std::memory_order_relaxed);
+		while (!try_protect(ptr, src)) {}
+		return ptr;
+	}
+
+	template<typename T>
+	bool hazard_pointer::try_protect(T*& ptr, const std::atomic<T*>& src) noexcept {
+		T* published = ptr;
+		record->hazard.store(published, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst); // the hazard is visible before we check src again
+		ptr = src.load(std::memory_order_acquire);
+		if (ptr != published) {
+			reset_protection();
+			return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	void hazard_pointer::reset_protection(const T* ptr) noexcept {
+		record->hazard.store(ptr, std::memory_order_release);
+	}
+
+	inline void hazard_pointer::reset_protection(std::nullptr_t) noexcept {
+		record->hazard.store(nullptr, std::memory_order_release);
+	}
+
+	inline void hazard_pointer::swap(hazard_pointer& other) noexcept {
+		std::swap(domain, other.domain);
+		std::swap(record, other.record);
+	}
+
+	inline hazard_pointer make_hazard_pointer(hazard_pointer_domain& domain) {
+		if (&domain == &hazard_pointer_default_domain() && !hazard_detail::cache_closed && hazard_detail::cache.size != 0) {
+			auto& cache = hazard_detail::cache;
+			return hazard_pointer(&domain, static_cast<hazard_pointer_domain::Record*>(cache.records[--cache.size]));
+		}
+		return hazard_pointer(&domain, domain.acquire_record());
+	}
+
+
+	template<typename T, typename D>
+	void hazard_pointer_obj_base<T, D>::retire(D del, hazard_pointer_domain& domain) {
+		deleter = std::move(del);
+		protected_address = static_cast<const T*>(this);
+		reclaim = &reclaim_this;
+		domain.retire(this);
+	}
+
+	template<typename Owner>
+		requires requires(Owner& owner) { owner.release()->retire(std::move(owner.get_deleter())); }
+	void hazard_retire(Owner&& node, hazard_pointer_domain& domain) {
+		auto del = std::move(node.get_deleter());
+		node.release()->retire(std::move(del), domain);
+	}
+
+};
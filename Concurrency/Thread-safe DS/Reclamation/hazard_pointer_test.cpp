@@ -0,0 +1,168 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "hazard_pointer.h"
+#include "../../../STL/smart_pointers/unique_ptr.h"
+
+// Stress test for my::hazard_pointer_domain: a Treiber stack popped by several threads at once,
+// the thread teardown paths of the default domain's record cache, and nodes retiring their children when they are freed.
+
+static std::atomic<long> live{0};
+
+struct node : my::hazard_pointer_obj_base<node> {
+	int value;
+	node* next = nullptr;
+	std::atomic<int> destroyed{0};
+
+	explicit node(int value) : value(value) {
+		++live;
+	}
+
+	~node() {
+		assert(destroyed.exchange(1) == 0); // exactly once
+		--live;
+	}
+};
+
+class treiber_stack {
+	std::atomic<node*> head{nullptr};
+
+public:
+	void push(int value) {
+		auto n = std::make_unique<node>(value);
+		n->next = head.load(std::memory_order_relaxed);
+		while (!head.compare_exchange_weak(n->next, n.get(), std::memory_order_release, std::memory_order_relaxed)) {}
+		n.release();
+	}
+
+	bool pop(int& value) {
+		my::hazard_pointer hp = my::make_hazard_pointer();
+		for (;;) {
+			node* top = hp.protect(head);
+			if (!top) return false;
+			assert(top->destroyed == 0); // never freed while protected
+			if (head.compare_exchange_strong(top, top->next, std::memory_order_acquire, std::memory_order_relaxed)) {
+				value = top->value;
+				hp.reset_protection();
+				my::hazard_retire(std::unique_ptr<node>(top));
+				return true;
+			}
+		}
+	}
+};
+
+static void protected_node_survives_scan() {
+	my::hazard_pointer_domain domain;
+	std::atomic<node*> src{new node(0)};
+	my::hazard_pointer hp = my::make_hazard_pointer(domain);
+	node* p = hp.protect(src);
+	src.store(nullptr);
+	p->retire({}, domain);
+	domain.cleanup();
+	assert(live == 1);
+	hp.reset_protection();
+	domain.cleanup();
+	assert(live == 0);
+
+	my::hazard_retire(my::unique_ptr<node>(new node(1)), domain);
+	my::hazard_retire(std::unique_ptr<node>(new node(2)), domain);
+	domain.cleanup();
+	assert(live == 0);
+
+	my::hazard_pointer_domain::statistics s = domain.stats();
+	assert(s.retired == 3 && s.reclaimed == 3 && s.pending == 0);
+	assert(s.max_latency.count() > 0 && s.mean_latency <= s.max_latency && s.median_latency <= s.p99_latency);
+}
+
+static void stack_stress(int threads, int pairs) {
+	treiber_stack stack;
+	std::atomic<long> pushed{0};
+	std::atomic<long> popped{0};
+	std::vector<std::thread> workers;
+	for (int t = 0; t != threads; ++t) {
+		workers.emplace_back([&] {
+			for (int i = 0; i != pairs; ++i) {
+				stack.push(i);
+				pushed += i;
+				int value;
+				if (stack.pop(value)) popped += value;
+			}
+		});
+	}
+	for (std::thread& t : workers) t.join();
+	int value;
+	while (stack.pop(value)) popped += value;
+	assert(pushed == popped);
+
+	my::hazard_pointer_default_domain().cleanup();
+	assert(live == 0);
+}
+
+// a hazard_pointer owned by a thread_local that outlives the thread's record cache goes back to the domain,
+// not into the destroyed cache: otherwise every such thread leaks an active record
+struct late_holder {
+	my::hazard_pointer hp;
+};
+
+static void teardown_order(int threads) {
+	for (int t = 0; t != threads; ++t) {
+		std::thread([] {
+			static thread_local late_holder holder; // constructed before the cache is first used, so destroyed after it
+			holder.hp = my::make_hazard_pointer();
+		}).join();
+	}
+	std::size_t slots = my::hazard_pointer_default_domain().stats().slots;
+	assert(slots <= 2 * 8 + 4); // the records are reused, a leak would add one per thread
+}
+
+// a tree whose nodes retire their children when they are freed: the domain's destructor frees those too
+struct tree_node : my::hazard_pointer_obj_base<tree_node> {
+	my::hazard_pointer_domain* domain;
+	tree_node* children[2] = {nullptr, nullptr};
+
+	explicit tree_node(my::hazard_pointer_domain* domain) : domain(domain) {
+		++live;
+	}
+
+	~tree_node() {
+		for (tree_node* child : children) {
+			if (child) child->retire({}, *domain);
+		}
+		--live;
+	}
+};
+
+static tree_node* make_tree(my::hazard_pointer_domain* domain, int depth) {
+	tree_node* root = new tree_node(domain);
+	if (depth > 1) {
+		root->children[0] = make_tree(domain, depth - 1);
+		root->children[1] = make_tree(domain, depth - 1);
+	}
+	return root;
+}
+
+static void nested_retire() {
+	{
+		my::hazard_pointer_domain domain;
+		for (int i = 0; i != 8; ++i) make_tree(&domain, 4)->retire({}, domain);
+	} // fewer than scan_base retires: only the destructor frees them, and what they retire on the way
+	assert(live == 0);
+}
+
+int main() {
+	protected_node_survives_scan();
+	stack_stress(4, 50000);
+	teardown_order(64);
+	nested_retire();
+
+	my::hazard_pointer_domain::statistics s = my::hazard_pointer_default_domain().stats();
+	std::printf("hazard_pointer_test: retired %zu, reclaimed %zu, scans %zu, slots %zu\n", s.retired, s.reclaimed, s.scans, s.slots);
+	std::printf("retire to free: mean %lld ns, median < %lld ns, p99 < %lld ns, max %lld ns\n",
+		static_cast<long long>(s.mean_latency.count()), static_cast<long long>(s.median_latency.count()),
+		static_cast<long long>(s.p99_latency.count()), static_cast<long long>(s.max_latency.count()));
+	return 0;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "epoch_reclamation.h"
+
+namespace my {
+
+	// Read-copy-update pointer for read-mostly data (configuration, routing tables): readers never wait and never write
+	// shared memory except their own epoch announcement, writers publish a whole new version and retire the old one.
+	//
+	//  - read() pins the epoch domain and loads the current version; the snapshot stays valid (and unchanged) until it's destroyed,
+	//    whatever the writers do meanwhile. Wait-free once the thread is registered with the domain: a fence, a TLS access
+	//    and two loads, no loops. The thread's first read() registers it (a record taken with a CAS loop, maybe allocated),
+	//    so that one may throw std::bad_alloc
+	//  - store()/update() swap the pointer under a writer mutex (writers only serialize among themselves)
+	//    and retire the old version, which is freed after a grace period: once every reader that might have seen it has unpinned
+	//  - synchronize() waits for that grace period, for writers that need the old version gone (e.g. it holds a file)
+	// Grace periods come from my::epoch_domain (epoch_reclamation.h), so a long read-side section delays frees, not writers.
+
+	template<typename T>
+	class rcu_ptr {
+
+		std::atomic<T*> current;
+		epoch_domain* domain;
+		std::mutex writer;
+
+	public:
+		class snapshot {
+
+			epoch_domain::guard guard;
+			const T* ptr;
+
+		public:
+			snapshot(epoch_domain& domain, const std::atomic<T*>& src);
+
+			snapshot(const snapshot&) = delete;
+			snapshot& operator=(const snapshot&) = delete;
+
+			const T* get() const noexcept;
+			const T& operator*() const noexcept;
+			const T* operator->() const noexcept;
+			explicit operator bool() const noexcept;
+		};
+
+		explicit rcu_ptr(epoch_domain& domain = epoch_domain::default_domain()) noexcept;
+
+		explicit rcu_ptr(std::unique_ptr<T> initial, epoch_domain& domain = epoch_domain::default_domain()) noexcept;
+
+		rcu_ptr(const rcu_ptr&) = delete;
+		rcu_ptr& operator=(const rcu_ptr&) = delete;
+
+		// snapshots of this rcu_ptr may still be alive in other threads, so the last version is retired, not deleted
+		~rcu_ptr();
+
+		snapshot read() const;
+
+		// publishes 'value' (may be empty) and retires the version it replaces
+		void store(std::unique_ptr<T> value);
+
+		// copy-modify-publish: fn gets a copy of the current version (which must not be empty);
+		// concurrent updates are serialized, so none of them is lost
+		template<typename F>
+		void update(F&& fn);
+
+		void synchronize();
+	};
+
+
+
+	template<typename T>
+	rcu_ptr<T>::snapshot::snapshot(epoch_domain& domain, const std::atomic<T*>& src)
+		: guard(domain),
+		ptr(src.load(std::memory_order_acquire)) // after the pin: whatever we load can't be freed before we unpin
+	{}
+
+	template<typename T>
+	const T* rcu_ptr<T>::snapshot::get() const noexcept {
+		return ptr;
+	}
+
+	template<typename T>
+	const T& rcu_ptr<T>::snapshot::operator*() const noexcept {
+		return *ptr;
+	}
+
+	template<typename T>
+	const T* rcu_ptr<T>::snapshot::operator->() const noexcept {
+		return ptr;
+	}
+
+	template<typename T>
+	rcu_ptr<T>::snapshot::operator bool() const noexcept {
+		return ptr != nullptr;
+	}
+
+
+	template<typename T>
+	rcu_ptr<T>::rcu_ptr(epoch_domain& domain) noexcept : current(nullptr), domain(&domain) {}
+
+	template<typename T>
+	rcu_ptr<T>::rcu_ptr(std::unique_ptr<T> initial, epoch_domain& domain) noexcept : current(initial.release()), domain(&domain) {}
+
+	template<typename T>
+	rcu_ptr<T>::~rcu_ptr() {
+		if (T* last = current.load(std::memory_order_relaxed)) {
+			domain->retire(last);
+		}
+	}
+
+	template<typename T>
+	typename rcu_ptr<T>::snapshot rcu_ptr<T>::read() const {
+		return snapshot(*domain, current);
+	}
+
+	template<typename T>
+	void rcu_ptr<T>::store(std::unique_ptr<T> value) {
+		T* old;
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			old = current.exchange(value.release(), std::memory_order_acq_rel); // release: the new version is built before readers see it
+		}
+		if (old) domain->retire(old);
+	}
+
+	template<typename T>
+	template<typename F>
+	void rcu_ptr<T>::update(F&& fn) {
+		T* old;
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			old = current.load(std::memory_order_relaxed); // only writers change it, and we are the writer
+			auto copy = std::make_unique<T>(*old);
+			std::forward<F>(fn)(*copy);
+			current.store(copy.release(), std::memory_order_release);
+		}
+		domain->retire(old);
+	}
+
+	template<typename T>
+	void rcu_ptr<T>::synchronize() {
+		domain->synchronize();
+	}
+
+};
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "rcu_ptr.h"
+#include "../../../STL/smart_pointers/shared_ptr.h"
+
+// Read throughput of my::rcu_ptr against a my::shared_ptr guarded by a std::shared_mutex, from 1 to 64 reader threads,
+// while one writer replaces the table every millisecond. Readers look up one entry per read-side section.
+// Usage: rcu_ptr_bench [milliseconds per point = 200] [max threads = 64], a Release build on a machine with that many cores
+
+struct table {
+	long entries[256];
+
+	explicit table(long version) {
+		for (long& e : entries) e = version;
+	}
+};
+
+class locked_ptr {
+	mutable std::shared_mutex m;
+	my::shared_ptr<table> current;
+
+public:
+	explicit locked_ptr(my::shared_ptr<table> initial) : current(std::move(initial)) {}
+
+	my::shared_ptr<table> read() const {
+		std::shared_lock<std::shared_mutex> lock(m);
+		return current;
+	}
+
+	void store(my::shared_ptr<table> value) {
+		my::shared_ptr<table> old;
+		{
+			std::unique_lock<std::shared_mutex> lock(m);
+			old = std::move(current);
+			current = std::move(value);
+		}
+	}
+};
+
+static volatile long sink;
+
+// reads per second, all readers together
+template<typename Read, typename Write>
+static double measure(int readers, int millis, Read read, Write write) {
+	std::atomic<bool> stop{false};
+	std::atomic<long> total{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t != readers; ++t) {
+		threads.emplace_back([&, t] {
+			long reads = 0;
+			long sum = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				sum += read((reads + t) & 255);
+				++reads;
+			}
+			sink = sum;
+			total += reads;
+		});
+	}
+	std::thread writer([&] {
+		for (long version = 1; !stop.load(std::memory_order_relaxed); ++version) {
+			write(version);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+	stop = true;
+	for (std::thread& t : threads) t.join();
+	writer.join();
+	return double(total.load()) * 1000.0 / millis;
+}
+
+int main(int argc, char** argv) {
+	int millis = argc > 1 ? std::atoi(argv[1]) : 200;
+	int max_threads = argc > 2 ? std::atoi(argv[2]) : 64;
+	std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+	std::printf("%8s %18s %18s\n", "readers", "rcu_ptr Mreads/s", "shared_mutex");
+
+	my::rcu_ptr<table> rcu(std::make_unique<table>(0));
+	locked_ptr locked(my::make_shared<table>(0));
+
+	for (int readers = 1; readers <= max_threads; readers *= 2) {
+		double r = measure(readers, millis,
+			[&](long i) { return rcu.read()->entries[i]; },
+			[&](long version) { rcu.store(std::make_unique<table>(version)); });
+		double l = measure(readers, millis,
+			[&](long i) { return locked.read()->entries[i]; },
+			[&](long version) { locked.store(my::make_shared<table>(version)); });
+		std::printf("%8d %18.1f %18.1f\n", readers, r / 1e6, l / 1e6);
+	}
+	return 0;
+}
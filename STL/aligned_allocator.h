@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace my {
+
+    // hands out memory aligned to Align bytes (at least alignof(T)): 32/64 for AVX loads, 64 to put per-thread slots on their own cache lines
+    template<typename T, std::size_t Align = alignof(T)>
+    class aligned_allocator {
+
+        static_assert((Align & (Align - 1)) == 0, "alignment must be a power of two");
+
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using is_always_equal = std::true_type;
+
+        static constexpr std::size_t alignment = Align > alignof(T) ? Align : alignof(T); // seen by my::allocator_traits::alignment
+
+        template<typename U>
+        struct rebind {
+            using other = aligned_allocator<U, Align>;
+        };
+
+        aligned_allocator() noexcept = default;
+
+        template<typename U>
+        aligned_allocator(const aligned_allocator<U, Align>&) noexcept {}
+
+        T* allocate(std::size_t num_of_elem) {
+            if (num_of_elem > max_size()) {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(::operator new(num_of_elem * sizeof(T), std::align_val_t(alignment)));
+        }
+
+        void deallocate(T* p, std::size_t num_of_elem) noexcept {
+            ::operator delete(p, num_of_elem * sizeof(T), std::align_val_t(alignment));
+        }
+
+        std::size_t max_size() const noexcept {
+            return static_cast<std::size_t>(-1) / sizeof(T);
+        }
+
+        template<typename U>
+        bool operator==(const aligned_allocator<U, Align>&) const noexcept {
+            return true;
+        }
+    };
+
+};
@@ -1,210 +1,109 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
 #include <limits>
+#include <memory>
 #include <type_traits>
+#include <utility>
+#include "my_type_traits.h"
 namespace my {
-    
+
     template<typename Alloc>
     class allocator_traits {
-    
+
+        // every member type is looked up through my::detected_or, which picks its specialization by a requires-clause:
+        // no overload sets and no helper class per trait and allocator, as it used to be with has_pointer, has_size_type etc.
         template<typename AAlloc>
-        class has_pointer;
+        using pointer_of = typename AAlloc::pointer;
 
         template<typename AAlloc>
-        class has_const_pointer;
+        using const_pointer_of = typename AAlloc::const_pointer;
 
         template<typename AAlloc>
-        class has_difference_type;
+        using difference_type_of = typename AAlloc::difference_type;
 
         template<typename AAlloc>
-        class has_size_type;
+        using size_type_of = typename AAlloc::size_type;
 
         template<typename AAlloc>
-        class has_propagate_on_container_copy_assignment;
+        using propagate_on_container_copy_assignment_of = typename AAlloc::propagate_on_container_copy_assignment;
 
         template<typename AAlloc>
-        class has_propagate_on_container_move_assignment;
-       
+        using propagate_on_container_move_assignment_of = typename AAlloc::propagate_on_container_move_assignment;
+
         template<typename AAlloc>
-        class has_propagate_on_container_swap;
+        using propagate_on_container_swap_of = typename AAlloc::propagate_on_container_swap;
 
         template<typename AAlloc>
-        class has_is_always_equal;
+        using is_always_equal_of = typename AAlloc::is_always_equal;
 
     public:
         using allocator_type = Alloc;
         using value_type = typename Alloc::value_type;
-        using pointer = typename has_pointer<Alloc>::type;
-        using const_pointer = typename has_const_pointer<Alloc>::type;
-        using difference_type = typename has_difference_type<Alloc>::type;
-        using size_type = typename has_size_type<Alloc>::type;
-        using propagate_on_container_copy_assignment = typename has_propagate_on_container_copy_assignment<Alloc>::type;
-        using propagate_on_container_move_assignment = typename has_propagate_on_container_move_assignment<Alloc>::type;
-        using propagate_on_container_swap = typename has_propagate_on_container_swap<Alloc>::type;
-        using is_always_equal = typename has_is_always_equal<Alloc>::type;
-
-    private: 
-        
-        template<typename AAlloc>
-        class has_pointer {
-            template<typename AAAlloc>
-            static typename AAAlloc::pointer f(int);
-
-            template<typename...>
-            static value_type* f(...);
-        public:
-            using type = decltype(f<AAlloc>(0));
-        };
-        
-    
-        template<typename AAlloc>
-        class has_const_pointer {
-            template<typename AAAlloc>
-            static typename AAAlloc::const_pointer f(int);
-
-            template<typename...>
-            static typename std::pointer_traits<pointer>::rebind<const value_type> f(...);
-        public:
-            using type = decltype(f<AAlloc>(0));
-        };
-
-
-        template<typename AAlloc>
-        class has_difference_type {
-            template<typename AAAlloc>
-            static typename AAAlloc::difference_type f(int);
-            
-            template<typename...>
-            static typename std::pointer_traits<pointer>::difference_type f(...); // long long
-        public:
-            using type = decltype(f<AAlloc>(0));
-        };
-
-    
-        template<typename AAlloc>
-        class has_size_type {
-            template<typename AAAlloc>
-            static typename AAAlloc::size_type f(int);
-
-            template<typename AAAlloc>
-            static typename std::make_unsigned<difference_type>::type f(...); //std::size_t 
-        public:
-            using type = decltype(f<AAlloc>(0));
-        };
-
-    
-        template<typename AAlloc>
-        class has_propagate_on_container_copy_assignment {
-            template<typename AAAlloc>
-            static typename AAAlloc::propagate_on_container_copy_assignment f(int);
-
-            template<typename...>
-            static std::false_type f(...);
+        using pointer = my::detected_or_t<value_type*, pointer_of, Alloc>;
+        using const_pointer = my::detected_or_t<typename std::pointer_traits<pointer>::template rebind<const value_type>, const_pointer_of, Alloc>;
+        using difference_type = my::detected_or_t<typename std::pointer_traits<pointer>::difference_type, difference_type_of, Alloc>; // long long
+        using size_type = my::detected_or_t<std::make_unsigned_t<difference_type>, size_type_of, Alloc>; //std::size_t
+        using propagate_on_container_copy_assignment = my::detected_or_t<std::false_type, propagate_on_container_copy_assignment_of, Alloc>;
+        using propagate_on_container_move_assignment = my::detected_or_t<std::false_type, propagate_on_container_move_assignment_of, Alloc>;
+        using propagate_on_container_swap = my::detected_or_t<std::false_type, propagate_on_container_swap_of, Alloc>;
+        using is_always_equal = my::detected_or_t<typename std::is_empty<Alloc>::type, is_always_equal_of, Alloc>;
+
+    private:
+
+        // SomeAlloc<U, Rest...> -> SomeAlloc<T, Rest...>, used when Alloc has no rebind member
+        template<typename AAlloc, typename T>
+        struct replace_first_arg {};
 
-        public:
-            using type = decltype(f<AAlloc>(0));
+        template<template<typename, typename...> typename Template, typename U, typename... Rest, typename T>
+        struct replace_first_arg<Template<U, Rest...>, T> {
+            using type = Template<T, Rest...>;
         };
 
-    
-        template<typename AAlloc>
-        class has_propagate_on_container_move_assignment {
-            template<typename AAAlloc>
-            static typename AAAlloc::propagate_on_container_move_assignment f(int);
-
-            template<typename...>
-            static std::false_type f(...);
+        template<typename T>
+        struct rebind_impl : replace_first_arg<Alloc, T> {};
 
-        public:
-            using type = decltype(f<AAlloc>(0));
+        template<typename T>
+            requires requires { typename Alloc::template rebind<T>::other; }
+        struct rebind_impl<T> {
+            using type = typename Alloc::template rebind<T>::other;
         };
 
-    
-        template<typename AAlloc>
-        class has_propagate_on_container_swap {
-            template<typename AAAlloc>
-            static typename AAAlloc::propagate_on_container_swap f(int);
-
-            template<typename...>
-            static std::false_type f(...);
-        public:
-            using type = decltype(f<AAlloc>(0));
+        static constexpr bool has_select_on_container_copy_construction = requires(const Alloc& alloc) {
+            alloc.select_on_container_copy_construction();
         };
-        
-    
-        template<typename AAlloc>
-        class has_is_always_equal {
-            template<typename AAAlloc>
-            static typename AAAlloc::is_always_equal f(int);
 
-            template<typename...>
-            static std::false_type f(...);
-
-        public:
-            using type = decltype(f<AAlloc>(0));
+        static constexpr bool has_max_size = requires(const Alloc& alloc) {
+            alloc.max_size();
         };
 
-        
-        template<typename AAlloc, typename T, typename... Args>
-        class has_construct {
-            template<typename AAAlloc, typename TT, typename... AArgs, typename = decltype(std::declval<AAAlloc>().construct(std::declval<TT*>(), std::declval<AArgs>()...))>
-            static std::true_type f(int);
-
-            template<typename...>
-            static std::false_type f(...);
-        
-        public:
-            static constexpr bool value = decltype(f<AAlloc, T, Args...>(0))::value;
-        };
-        
-        template<typename AAlloc, typename T>
-        class has_destroy {
-            template<typename AAAlloc, typename TT, typename = decltype(std::declval<AAAlloc>().destroy(std::declval<TT*>()))>
-            static std::true_type f(int);
+        static constexpr std::size_t alignment_impl() noexcept {
+            if constexpr (requires { { Alloc::alignment } -> std::convertible_to<std::size_t>; }) {
+                return Alloc::alignment > alignof(value_type) ? Alloc::alignment : alignof(value_type);
+            }
+            else {
+                return alignof(value_type);
+            }
+        }
 
-            template<typename...>
-            static std::false_type f(...);
+    public:
 
-        public:
-            static constexpr bool value = decltype(f<AAlloc, T>(0))::value;
-        };
+        // the alignment every pointer returned by allocate() is known to have, so that vectorised code may std::assume_aligned on it;
+        // allocators that give more than alignof(value_type) announce it with a static 'alignment' member (see aligned_allocator.h)
+        static constexpr std::size_t alignment = alignment_impl();
 
-        
-        template<typename AAlloc>
-        class has_select_on_container_copy_construction {
-            template<typename AAAlloc, typename = decltype(std::declval<AAAlloc>().select_on_container_copy_construction())>
-            static std::true_type f(int);
-
-            template<typename...>
-            static std::false_type f(...);
-        public:
-            static constexpr bool value = decltype(f<AAlloc>(0))::value;
+        // true if construct/destroy would go to the allocator and not just to placement new/destructor,
+        // bulk algorithms (see uninitialized.h) may replace element-wise loops with memcpy/memset only otherwise
+        template<typename T, typename... Args>
+        static constexpr bool has_custom_construct = requires(Alloc& alloc, T* p, Args&&... args) {
+            alloc.construct(p, std::forward<Args>(args)...);
         };
 
-        
-        template<typename AAlloc>
-        class has_max_size {
-            template<typename AAAlloc, typename = decltype(std::declval<AAAlloc>().max_size())>
-            static std::true_type f(int);
-
-            template<typename...>
-            static std::false_type f(...);
-
-        public:
-            static constexpr bool value = decltype(f<AAlloc>(0))::value;
+        template<typename T>
+        static constexpr bool has_custom_destroy = requires(Alloc& alloc, T* p) {
+            alloc.destroy(p);
         };
 
-
-        template<typename AAlloc, typename T>
-        class has_rebind {
-            template<typename AAAlloc, typename TT>
-            static typename AAAlloc::template rebind<TT>::other f(int);
-
-            template<typename...>
-            static std::allocator<T> f(...);
-
-        public:
-            using type = decltype(f<AAlloc, T>(0));
-        };
-    public:
-        
         static constexpr pointer allocate(Alloc& alloc, std::size_t num_of_elem) {
             return alloc.allocate(num_of_elem);
         }
@@ -215,17 +114,18 @@ namespace my {
 
         template<typename T, typename... Args>
         static constexpr T* construct(Alloc& alloc, T* p, Args&&... args) {
-            if constexpr (has_construct<Alloc, T, Args...>::value) {
-                return alloc.construct(p, std::forward<Args>(args)...);
+            if constexpr (has_custom_construct<T, Args...>) {
+                alloc.construct(p, std::forward<Args>(args)...); // Alloc::construct usually returns void
+                return p;
             }
             else {
                 return std::construct_at(p, std::forward<Args>(args)...);
             }
         }
-        
+
         template<typename T>
         static constexpr void destroy(Alloc& alloc, T* p) noexcept {
-            if constexpr (has_destroy<Alloc,T>::value) {
+            if constexpr (has_custom_destroy<T>) {
                 alloc.destroy(p);
             }
             else {
@@ -233,9 +133,9 @@ namespace my {
                 std::destroy_at(p); // actually same with p->~T() for not arrays
             }
         }
-        
+
         static constexpr Alloc select_on_container_copy_construction(const Alloc& alloc) {
-            if constexpr (has_select_on_container_copy_construction<Alloc>::value) {
+            if constexpr (has_select_on_container_copy_construction) {
                 return alloc.select_on_container_copy_construction();
             }
             else {
@@ -244,16 +144,16 @@ namespace my {
         }
 
         static constexpr size_type max_size(const Alloc& alloc) noexcept {
-            if constexpr (has_max_size<Alloc>::value) {
+            if constexpr (has_max_size) {
                 return alloc.max_size();
             }
             else {
                 return std::numeric_limits<size_type>::max() / sizeof(value_type);
             }
         }
-        
+
         template<typename T>
-        using rebind_alloc = typename has_rebind<Alloc, T>::type;
+        using rebind_alloc = typename rebind_impl<T>::type;
 
         template<typename T>
         using rebind_traits = allocator_traits<rebind_alloc<T>>;
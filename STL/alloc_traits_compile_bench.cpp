@@ -0,0 +1,95 @@
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "alloc_traits.h"
+#include "my_type_traits.h"
+
+// Compile-time benchmark for the detection in my::allocator_traits and my_type_traits.h: MY_COMPILE_BENCH_N distinct
+// allocator types, each asked for every member type, construct, destroy, max_size and the copy-construction hook,
+// plus the type-trait detectors on its value type. Only the compile time matters, the program does nothing.
+// The alloc_traits_compile_bench target times it with -fsyntax-only (see CMakeLists.txt).
+
+#ifndef MY_COMPILE_BENCH_N
+#define MY_COMPILE_BENCH_N 2000
+#endif
+
+template<std::size_t I>
+struct bench_value {
+    int value = static_cast<int>(I);
+};
+
+// half of them declare the optional members, half leave them to the defaults
+template<typename T>
+struct bench_alloc {
+    using value_type = T;
+
+    bench_alloc() = default;
+
+    template<typename U>
+    bench_alloc(const bench_alloc<U>&) noexcept {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T))); }
+    void deallocate(T* p, std::size_t) noexcept { ::operator delete(p); }
+};
+
+template<typename T>
+struct bench_full_alloc : bench_alloc<T> {
+    using pointer = T*;
+    using const_pointer = const T*;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    template<typename U>
+    struct rebind {
+        using other = bench_full_alloc<U>;
+    };
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template<typename U>
+    void destroy(U* p) noexcept { p->~U(); }
+
+    std::size_t max_size() const noexcept { return 1u << 20; }
+
+    bench_full_alloc select_on_container_copy_construction() const { return *this; }
+};
+
+template<std::size_t I>
+using alloc_for = std::conditional_t<I % 2 == 0, bench_alloc<bench_value<I>>, bench_full_alloc<bench_value<I>>>;
+
+template<std::size_t I>
+std::size_t use_traits() {
+    using A = alloc_for<I>;
+    using traits = my::allocator_traits<A>;
+    using T = typename traits::value_type;
+
+    // values, not static_asserts: the answers don't matter (and the old detectors got some of them wrong), asking does
+    std::size_t types = sizeof(typename traits::pointer) + sizeof(typename traits::const_pointer)
+        + sizeof(typename traits::size_type) + sizeof(typename traits::difference_type)
+        + sizeof(typename traits::template rebind_alloc<int>);
+    std::size_t flags = traits::propagate_on_container_copy_assignment::value + traits::propagate_on_container_move_assignment::value
+        + traits::propagate_on_container_swap::value + traits::is_always_equal::value
+        + my::is_nothrow_constructible_v<T> + my::is_copy_constructible_v<T> + my::is_move_assignable_v<T>;
+
+    A alloc;
+    A copy = traits::select_on_container_copy_construction(alloc);
+    T* p = traits::allocate(copy, 1);
+    traits::construct(copy, p);
+    traits::destroy(copy, p);
+    traits::deallocate(copy, p, 1);
+    return traits::max_size(alloc) + types + flags;
+}
+
+template<std::size_t... I>
+std::size_t use_all(std::index_sequence<I...>) {
+    return (use_traits<I>() + ...);
+}
+
+int main() {
+    return use_all(std::make_index_sequence<MY_COMPILE_BENCH_N>()) == 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+
+namespace my {
+
+    // A pair that takes no room for an empty member (std::default_delete, std::allocator and other stateless
+    // deleters/allocators): such a member becomes a base class, and the empty base optimization folds it away.
+    // [[no_unique_address]] would do the same, but MSVC ignores it, while EBO works everywhere.
+    // Final classes can't be derived from, so they are stored as ordinary members.
+
+    template<typename T, int Index, bool = std::is_empty_v<T> && !std::is_final_v<T>>
+    class compressed_pair_elem {
+
+        T value{};
+
+    public:
+        constexpr compressed_pair_elem() = default;
+
+        template<typename U>
+        constexpr explicit compressed_pair_elem(U&& u) : value(std::forward<U>(u)) {}
+
+        constexpr T& get() noexcept { return value; }
+        constexpr const T& get() const noexcept { return value; }
+    };
+
+    template<typename T, int Index>
+    class compressed_pair_elem<T, Index, true> : private T {
+
+    public:
+        constexpr compressed_pair_elem() = default;
+
+        template<typename U>
+        constexpr explicit compressed_pair_elem(U&& u) : T(std::forward<U>(u)) {}
+
+        constexpr T& get() noexcept { return *this; }
+        constexpr const T& get() const noexcept { return *this; }
+    };
+
+
+    // the Index keeps the two bases distinct when First and Second are the same empty type
+    template<typename First, typename Second>
+    class compressed_pair : private compressed_pair_elem<First, 0>, private compressed_pair_elem<Second, 1> {
+
+        using first_base = compressed_pair_elem<First, 0>;
+        using second_base = compressed_pair_elem<Second, 1>;
+
+    public:
+        constexpr compressed_pair() = default;
+
+        template<typename F, typename S>
+        constexpr compressed_pair(F&& f, S&& s) : first_base(std::forward<F>(f)), second_base(std::forward<S>(s)) {}
+
+        // the first one default-constructed, e.g. unique_ptr(p) with a stateless deleter
+        template<typename S>
+        constexpr explicit compressed_pair(std::in_place_t, S&& s) : first_base(), second_base(std::forward<S>(s)) {}
+
+        // the second one default-constructed, e.g. storage that gets its object later
+        template<typename F>
+        constexpr compressed_pair(F&& f, std::in_place_t) : first_base(std::forward<F>(f)), second_base() {}
+
+        constexpr First& first() noexcept { return first_base::get(); }
+        constexpr const First& first() const noexcept { return first_base::get(); }
+
+        constexpr Second& second() noexcept { return second_base::get(); }
+        constexpr const Second& second() const noexcept { return second_base::get(); }
+
+        void swap(compressed_pair& other) noexcept(std::is_nothrow_swappable_v<First> && std::is_nothrow_swappable_v<Second>) {
+            using std::swap;
+            swap(first(), other.first());
+            swap(second(), other.second());
+        }
+    };
+
+};
@@ -0,0 +1,353 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include "current_vector.h"
+#include "smart_pointers/shared_ptr.h"
+
+namespace my {
+
+    // my::vector behind a my::shared_ptr: copying is a reference count bump, and the elements are cloned
+    // only when somebody writes to a buffer that another cow_vector still shares.
+    //
+    //  - a copy is a snapshot: later writes made through the original's member functions clone first and never reach it,
+    //    whatever thread it lives in. The snapshot has to be taken on the writer's thread (or under whatever guards
+    //    the original), after that it may go anywhere - cow_vector never writes to a buffer while it's shared
+    //  - every non-const member (including non-const operator[], begin(), data()) makes the buffer unique first,
+    //    so call the const ones (or cbegin()/cend()) on the read side to avoid cloning by accident
+    //  - shared_ptr::unique() is an acquire load (the counter policy's unique(), not use_count()), so a buffer
+    //    the last reader has just let go of is reused in place only after everything that reader read from it
+    //  - the clone is vector's copy constructor: one allocation of the old capacity, memcpy for trivially copyable T
+    //  - taking a copy invalidates the references, pointers and iterators that non-const calls (and edit()) have handed out:
+    //    they point into the buffer the copy now shares, so writing through one would change the snapshot and race with
+    //    its readers. After 'int& r = v[0]; auto s = v;' call v[0] again, that clones. Otherwise they stay valid
+    //    for as long as they would in a my::vector
+
+    template<typename T, typename Alloc = std::allocator<T>>
+    class cow_vector {
+    public:
+        using vector_type = my::vector<T, Alloc>;
+        using value_type = T;
+        using iterator = typename vector_type::iterator;
+        using const_iterator = typename vector_type::const_iterator;
+
+    private:
+        my::shared_ptr<vector_type> buf; // null until the first write, an empty cow_vector allocates nothing
+
+        static const vector_type& empty_vector() noexcept;
+
+        const vector_type& view() const noexcept { return buf ? *buf : empty_vector(); }
+
+    public:
+        cow_vector() noexcept = default;
+
+        explicit cow_vector(std::size_t num_of_elem);
+
+        cow_vector(std::size_t num_of_elem, const T& value);
+
+        cow_vector(std::initializer_list<T> init_l);
+
+        explicit cow_vector(vector_type v);
+
+        cow_vector(const cow_vector& other) noexcept = default;
+        cow_vector(cow_vector&& other) noexcept = default;
+        cow_vector& operator=(const cow_vector& other) noexcept = default;
+        cow_vector& operator=(cow_vector&& other) noexcept = default;
+
+        // the same thing as a copy, spelled out for the read side
+        cow_vector snapshot() const noexcept;
+
+        // the buffer, unique: for a batch of writes with one check instead of one per call. Don't keep the reference past the next copy
+        vector_type& edit();
+
+        //reads, never clone
+        std::size_t size() const noexcept;
+        std::size_t capacity() const noexcept;
+        bool empty() const noexcept;
+
+        const T& operator[](std::size_t index) const;
+        const T& at(std::size_t index) const;
+        const T& front() const;
+        const T& back() const;
+        const T* data() const noexcept;
+
+        const_iterator begin() const noexcept;
+        const_iterator end() const noexcept;
+        const_iterator cbegin() const noexcept;
+        const_iterator cend() const noexcept;
+
+        bool operator==(const cow_vector& other) const noexcept;
+
+        std::size_t use_count() const noexcept;
+        bool shares_buffer_with(const cow_vector& other) const noexcept;
+
+        //writes, clone a shared buffer first
+        T& operator[](std::size_t index);
+        T& at(std::size_t index);
+        T& front();
+        T& back();
+        T* data();
+
+        iterator begin();
+        iterator end();
+
+        template<typename... Args>
+        void emplace_back(Args&&... args);
+        void push_back(const T& value);
+        void push_back(T&& value);
+        void pop_back();
+
+        // pos may come from before the clone: it is turned into an index first
+        iterator insert(const_iterator pos, const T& value);
+        iterator insert(const_iterator pos, T&& value);
+        iterator erase(const_iterator pos);
+
+        void reserve(std::size_t new_cap);
+        void resize(std::size_t new_sz);
+        void resize(std::size_t new_sz, const T& value);
+
+        // drops the reference, the snapshots keep their elements
+        void clear() noexcept;
+
+        void swap(cow_vector& other) noexcept;
+    };
+
+
+
+    template<typename T, typename Alloc>
+    const typename cow_vector<T, Alloc>::vector_type& cow_vector<T, Alloc>::empty_vector() noexcept {
+        static const vector_type empty;
+        return empty;
+    }
+
+    template<typename T, typename Alloc>
+    cow_vector<T, Alloc>::cow_vector(std::size_t num_of_elem) : buf(my::make_shared<vector_type>(num_of_elem)) {}
+
+    template<typename T, typename Alloc>
+    cow_vector<T, Alloc>::cow_vector(std::size_t num_of_elem, const T& value) : buf(my::make_shared<vector_type>(num_of_elem, value)) {}
+
+    template<typename T, typename Alloc>
+    cow_vector<T, Alloc>::cow_vector(std::initializer_list<T> init_l) : buf(my::make_shared<vector_type>(init_l)) {}
+
+    template<typename T, typename Alloc>
+    cow_vector<T, Alloc>::cow_vector(vector_type v) : buf(my::make_shared<vector_type>(std::move(v))) {}
+
+    template<typename T, typename Alloc>
+    cow_vector<T, Alloc> cow_vector<T, Alloc>::snapshot() const noexcept {
+        return *this;
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::vector_type& cow_vector<T, Alloc>::edit() {
+        if (!buf) {
+            buf = my::make_shared<vector_type>();
+        }
+        else if (!buf.unique()) {
+            buf = my::make_shared<vector_type>(std::as_const(*buf));
+        }
+        return *buf;
+    }
+
+
+    //reads
+
+    template<typename T, typename Alloc>
+    std::size_t cow_vector<T, Alloc>::size() const noexcept {
+        return view().size();
+    }
+
+    template<typename T, typename Alloc>
+    std::size_t cow_vector<T, Alloc>::capacity() const noexcept {
+        return view().capacity();
+    }
+
+    template<typename T, typename Alloc>
+    bool cow_vector<T, Alloc>::empty() const noexcept {
+        return view().empty();
+    }
+
+    template<typename T, typename Alloc>
+    const T& cow_vector<T, Alloc>::operator[](std::size_t index) const {
+        return view()[index];
+    }
+
+    template<typename T, typename Alloc>
+    const T& cow_vector<T, Alloc>::at(std::size_t index) const {
+        return view().at(index);
+    }
+
+    template<typename T, typename Alloc>
+    const T& cow_vector<T, Alloc>::front() const {
+        return view().front();
+    }
+
+    template<typename T, typename Alloc>
+    const T& cow_vector<T, Alloc>::back() const {
+        return view().back();
+    }
+
+    template<typename T, typename Alloc>
+    const T* cow_vector<T, Alloc>::data() const noexcept {
+        return view().data();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::const_iterator cow_vector<T, Alloc>::begin() const noexcept {
+        return view().cbegin();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::const_iterator cow_vector<T, Alloc>::end() const noexcept {
+        return view().cend();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::const_iterator cow_vector<T, Alloc>::cbegin() const noexcept {
+        return view().cbegin();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::const_iterator cow_vector<T, Alloc>::cend() const noexcept {
+        return view().cend();
+    }
+
+    template<typename T, typename Alloc>
+    bool cow_vector<T, Alloc>::operator==(const cow_vector& other) const noexcept {
+        return buf.get() == other.buf.get() || view() == other.view();
+    }
+
+    template<typename T, typename Alloc>
+    std::size_t cow_vector<T, Alloc>::use_count() const noexcept {
+        return buf.use_count();
+    }
+
+    template<typename T, typename Alloc>
+    bool cow_vector<T, Alloc>::shares_buffer_with(const cow_vector& other) const noexcept {
+        return buf && buf.get() == other.buf.get();
+    }
+
+
+    //writes
+
+    template<typename T, typename Alloc>
+    T& cow_vector<T, Alloc>::operator[](std::size_t index) {
+        return edit()[index];
+    }
+
+    template<typename T, typename Alloc>
+    T& cow_vector<T, Alloc>::at(std::size_t index) {
+        if (index >= size()) {
+            throw std::out_of_range("cow_vector::at: index out of range!"); // before the clone, which would be wasted
+        }
+        return edit()[index];
+    }
+
+    template<typename T, typename Alloc>
+    T& cow_vector<T, Alloc>::front() {
+        return edit().front();
+    }
+
+    template<typename T, typename Alloc>
+    T& cow_vector<T, Alloc>::back() {
+        return edit().back();
+    }
+
+    template<typename T, typename Alloc>
+    T* cow_vector<T, Alloc>::data() {
+        return edit().data();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::iterator cow_vector<T, Alloc>::begin() {
+        return edit().begin();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::iterator cow_vector<T, Alloc>::end() {
+        return edit().end();
+    }
+
+    template<typename T, typename Alloc>
+    template<typename... Args>
+    void cow_vector<T, Alloc>::emplace_back(Args&&... args) {
+        edit().emplace_back(std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::push_back(const T& value) {
+        edit().push_back(value);
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::push_back(T&& value) {
+        edit().push_back(std::move(value));
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::pop_back() {
+        edit().pop_back();
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::iterator cow_vector<T, Alloc>::insert(const_iterator pos, const T& value) {
+        std::size_t index = static_cast<std::size_t>(pos - cbegin());
+        vector_type& v = edit();
+        return v.insert(v.cbegin() + static_cast<int>(index), value);
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::iterator cow_vector<T, Alloc>::insert(const_iterator pos, T&& value) {
+        std::size_t index = static_cast<std::size_t>(pos - cbegin());
+        vector_type& v = edit();
+        return v.insert(v.cbegin() + static_cast<int>(index), std::move(value));
+    }
+
+    template<typename T, typename Alloc>
+    typename cow_vector<T, Alloc>::iterator cow_vector<T, Alloc>::erase(const_iterator pos) {
+        std::size_t index = static_cast<std::size_t>(pos - cbegin());
+        vector_type& v = edit();
+        return v.erase(v.cbegin() + static_cast<int>(index));
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::reserve(std::size_t new_cap) {
+        if (new_cap <= capacity()) return; // a no-op either way, don't clone for it
+        edit().reserve(new_cap);
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::resize(std::size_t new_sz) {
+        if (new_sz == 0) {
+            clear();
+            return;
+        }
+        edit().resize(new_sz);
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::resize(std::size_t new_sz, const T& value) {
+        if (new_sz == 0) {
+            clear();
+            return;
+        }
+        edit().resize(new_sz, value);
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::clear() noexcept {
+        if (buf && buf.unique()) {
+            buf->clear(); // keeps the capacity, as vector::clear does
+        }
+        else {
+            buf.reset();
+        }
+    }
+
+    template<typename T, typename Alloc>
+    void cow_vector<T, Alloc>::swap(cow_vector& other) noexcept {
+        buf.swap(other.buf);
+    }
+
+};
@@ -1,18 +1,29 @@
+#pragma once
 #include <cassert>
 #include <exception>
 #include <initializer_list>
 #include <memory>
 #include <stdexcept>
 #include <type_traits>
+#include "alloc_traits.h"
+#include "compressed_pair.h"
+#include "uninitialized.h"
 
 namespace my {
     template<typename T, typename Alloc = std::allocator<T>>
     class vector {
-        Alloc alloc;
+        using alloc_traits = my::allocator_traits<Alloc>;
+
+        my::compressed_pair<Alloc, std::size_t> alloc_and_cap; // a stateless allocator takes no room: sizeof(vector) == 3 pointers
         T* arr;
-        std::size_t cap;
         std::size_t sz;
 
+        Alloc& alloc() noexcept { return alloc_and_cap.first(); }
+        const Alloc& alloc() const noexcept { return alloc_and_cap.first(); }
+
+        std::size_t& cap() noexcept { return alloc_and_cap.second(); }
+        std::size_t cap() const noexcept { return alloc_and_cap.second(); }
+
         template<bool isConst>
         class common_iterator {
             std::conditional_t<isConst, const T*, T*> p;
@@ -123,13 +134,16 @@ namespace my {
         //copy and move assignment operators
         vector& operator=(const vector& other); // could not to return, but return reference for things like vector<some_type, some_allocator> v3 = v2 = v1;
         vector& operator=(vector&& other) 
-            noexcept((!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value || std::allocator_traits<Alloc>::is_always_equal::value) || std::is_nothrow_move_assignable_v<Alloc>);
+            noexcept((!alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) || std::is_nothrow_move_assignable_v<Alloc>);
         ~vector();
 
         void reserve(std::size_t new_cap);
         void resize(std::size_t new_sz);
         void resize(std::size_t new_sz, const T& value);
         void shrink_to_fit(); 
+    private:
+        void reallocate(std::size_t new_cap);
+    public:
         std::size_t capacity() const noexcept; 
         std::size_t size() const noexcept;
         bool empty() const noexcept; 
@@ -170,413 +184,260 @@ namespace my {
         void clear() noexcept;
         
         void swap(vector& other) 
-            noexcept(std::allocator_traits<Alloc>::is_always_equal::value || (std::allocator_traits<Alloc>::propagate_on_container_swap::value && std::is_nothrow_swappable_v<Alloc>));  //just reference, because there's no sense to accept constants or rvalues
+            noexcept(alloc_traits::is_always_equal::value || (alloc_traits::propagate_on_container_swap::value && std::is_nothrow_swappable_v<Alloc>));  //just reference, because there's no sense to accept constants or rvalues
 
     };
 
 
 
     template<typename T, typename Alloc>
-    my::vector<T, Alloc>::vector(const Alloc& alloc) : alloc(alloc), arr(nullptr), sz(0), cap(0) {}
+    my::vector<T, Alloc>::vector(const Alloc& alloc) : alloc_and_cap(alloc, 0), arr(nullptr), sz(0) {}
 
     template<typename T, typename Alloc>
     vector<T, Alloc>::vector(std::size_t num_of_elem, const Alloc& alloc) 
-        : alloc(alloc),
-        arr(std::allocator_traits<Alloc>::allocate(this->alloc, num_of_elem)),
-        cap(num_of_elem),
+        : alloc_and_cap(alloc, num_of_elem),
+        arr(alloc_traits::allocate(this->alloc(), num_of_elem)),
         sz(num_of_elem)
     {
-        for(std::size_t i = 0; i != num_of_elem; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(this->alloc, arr+i, T());
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(this->alloc, arr+j);
-                }
-                std::allocator_traits<Alloc>::deallocate(this->alloc, arr, num_of_elem);
-                throw;
-            }
+        try {
+            my::uninitialized_value_construct(this->alloc(), arr, num_of_elem);
+        }
+        catch(...) {
+            alloc_traits::deallocate(this->alloc(), arr, num_of_elem);
+            throw;
         }
     }
 
     template<typename T, typename Alloc>
     vector<T,Alloc>::vector(std::size_t num_of_elem, const T& value, const Alloc& alloc)
-       : alloc(alloc),
-       arr(std::allocator_traits<Alloc>::allocate(this->alloc, num_of_elem)),
-       cap(num_of_elem),
+       : alloc_and_cap(alloc, num_of_elem),
+       arr(alloc_traits::allocate(this->alloc(), num_of_elem)),
        sz(num_of_elem) 
     {
-        for(std::size_t i = 0; i != num_of_elem; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(this->alloc, arr+i, value);
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(this->alloc, arr+j);
-                }
-                std::allocator_traits<Alloc>::deallocate(this->alloc, arr, num_of_elem);
-                throw;
-            }
+        try {
+            my::uninitialized_fill(this->alloc(), arr, num_of_elem, value);
+        }
+        catch(...) {
+            alloc_traits::deallocate(this->alloc(), arr, num_of_elem);
+            throw;
         }
-
     }
 
     template<typename T, typename Alloc>
     vector<T, Alloc>::vector(std::initializer_list<T> init_l, const Alloc& alloc) 
-        : alloc(alloc),
-        arr(std::allocator_traits<Alloc>::allocate(this->alloc, init_l.size())),
-        cap(init_l.size()),
+        : alloc_and_cap(alloc, init_l.size()),
+        arr(alloc_traits::allocate(this->alloc(), init_l.size())),
         sz(init_l.size())
     {
-        for(std::size_t i = 0; i != init_l.size(); ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(this->alloc, arr + i, *(init_l.begin() + i)); // initializer_lists' elements cannot be moved as they're constant
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(this->alloc, arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(this->alloc, arr, init_l.size());
-                throw;
-            }
+        try {
+            my::uninitialized_copy(this->alloc(), init_l.begin(), init_l.end(), arr); // initializer_lists' elements cannot be moved as they're constant
+        }
+        catch(...) {
+            alloc_traits::deallocate(this->alloc(), arr, init_l.size());
+            throw;
         }
     }
 
     template<typename T, typename Alloc>
     vector<T, Alloc>::vector(const vector& other) 
-        : alloc(std::allocator_traits<Alloc>::select_on_container_copy_construction(alloc)),
-        arr(std::allocator_traits<Alloc>::allocate(this->alloc, other.cap)),
-        cap(other.cap),
+        : alloc_and_cap(alloc_traits::select_on_container_copy_construction(other.alloc()), other.cap()),
+        arr(alloc_traits::allocate(alloc(), other.cap())),
         sz(other.sz)
     {
-        for(std::size_t i = 0; i != other.sz; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(this->alloc, arr + i, *(other.arr + i));
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(this->alloc, arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(this->alloc, arr, other.cap);
-                throw;
-            }
+        try {
+            my::uninitialized_copy(alloc(), other.arr, other.arr + other.sz, arr);
+        }
+        catch(...) {
+            alloc_traits::deallocate(alloc(), arr, other.cap());
+            throw;
         }
     }
 
     template<typename T, typename Alloc>
     vector<T, Alloc>::vector(vector&& other) noexcept(std::is_nothrow_move_constructible_v<Alloc>)
-        : alloc(std::move(other.alloc)), // others' arr points to nullptr after all, so it's not binded with its' allocator anymore, that's why we move it
+        : alloc_and_cap(std::move(other.alloc()), other.cap()), // others' arr points to nullptr after all, so it's not binded with its' allocator anymore, that's why we move it
         arr(other.arr),
-        cap(other.cap),
         sz(other.sz)
     {
         other.arr = nullptr;
-        other.cap = 0;
+        other.cap() = 0;
         other.sz = 0;
     }
 
     template<typename T, typename Alloc>
     vector<T, Alloc>& vector<T, Alloc>::operator=(const vector& other) {
-        Alloc new_alloc = alloc;
-        if (std::allocator_traits<Alloc>::propagate_on_container_copy_assignment::value) {
-            new_alloc = other.alloc;
+        Alloc new_alloc = alloc();
+        if (alloc_traits::propagate_on_container_copy_assignment::value) {
+            new_alloc = other.alloc();
         }
-        T* new_arr = std::allocator_traits<Alloc>::allocate(new_alloc, other.cap);
-        for (std::size_t i = 0; i != other.sz; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(new_alloc, new_arr + i, *(other.arr + i));
-            }
-            catch(...) {
-                for (std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(new_alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(new_alloc, new_arr, other.cap);
-                throw;
-            }
+        T* new_arr = alloc_traits::allocate(new_alloc, other.cap());
+        try {
+            my::uninitialized_copy(new_alloc, other.arr, other.arr + other.sz, new_arr);
         }
-        for(std::size_t i = 0; i != sz; ++i) {
-            std::allocator_traits<Alloc>::destroy(alloc, arr + i);
+        catch(...) {
+            alloc_traits::deallocate(new_alloc, new_arr, other.cap());
+            throw;
         }
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-        if (alloc != new_alloc) {
-            alloc = new_alloc;
+        my::destroy_n(alloc(), arr, sz);
+        alloc_traits::deallocate(alloc(), arr, cap());
+        if (alloc() != new_alloc) {
+            alloc() = new_alloc;
         }
         arr = new_arr;
-        cap = other.cap;
+        cap() = other.cap();
         sz = other.sz;
         return *this;
     }
     
-    //this one should be redone
     template<typename T, typename Alloc>
     vector<T, Alloc>& vector<T, Alloc>::operator=(vector&& other) 
-        noexcept((!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value || std::allocator_traits<Alloc>::is_always_equal::value) || std::is_nothrow_move_assignable_v<Alloc>)
+        noexcept((!alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) || std::is_nothrow_move_assignable_v<Alloc>)
     {
-        if (alloc != alloc.other) {        
-            
-            if (std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value) {
-                
-                assert(std::is_nothrow_move_assignable_v<Alloc>); //exception safety cannot be guaranteed otherwise
-
-                for(std::size_t i = 0; i != sz; ++i) {
-                    std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-                
-                alloc = std::move(other.alloc);
-                arr = other.arr;
-                cap = other.cap;
-                sz = other.sz;
-                other.arr = nullptr;
-                other.cap = 0;
-                other.sz = 0;
-                 
+        if (alloc_traits::propagate_on_container_move_assignment::value || alloc() == other.alloc()) {
+            my::destroy_n(alloc(), arr, sz);
+            alloc_traits::deallocate(alloc(), arr, cap());
+            if (alloc_traits::propagate_on_container_move_assignment::value) {
+                alloc() = std::move(other.alloc());
             }
-            else {
-                T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, other.cap);
-                for(std::size_t i = 0; i != other.sz; ++i) {
-                    try {
-                        std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(other.arr + i)));
-                    }
-                    catch(...) {
-                        for(std::size_t j = 0; j != i; ++j) {
-                            std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                        }
-                        std::allocator_traits<Alloc>::deallocate(alloc, new_arr, other.cap);
-                        throw;
-                    }
-                }
-                
-                if (!std::is_nothrow_move_constructible_v<Alloc> && std::is_copy_constructible_v<Alloc>) {
-                    for(std::size_t i = 0; i != other.sz; ++i) {
-                        std::allocator_traits<Alloc>::destroy(other.alloc, other.arr + i);
-                    }
-                }
-                std::allocator_traits<Alloc>::deallocate(other.alloc, other.arr, other.cap);
-
-                for(std::size_t i = 0; i != sz; ++i) {
-                    std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-                
-                arr = new_arr;
-                cap = other.cap;
-                sz = other.sz;
-
-                other.arr = nullptr;
-                other.cap = 0;
-                other.sz = 0;
-            }
-        }
-        else {
-            for(std::size_t i = 0; i != sz; ++i) {
-                std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-            }
-            std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
             arr = other.arr;
-            cap = other.cap;
+            cap() = other.cap();
             sz = other.sz;
-            other.arr = nullptr;
-            other.cap = 0;
-            other.sz = 0;
         }
-        return *this;
-    }
-    
-    //it's ok(actually, we can modify this, but later), even if move-constructor of T is not noexcept and it hasn't a copy-constructor (or has a deleted one)
-    template<typename T, typename Alloc>
-    void vector<T, Alloc>::reserve(std::size_t new_cap) {
-        if (new_cap <= cap) return;
-        T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, new_cap);
-        for(std::size_t i = 0; i != sz; ++i) {
+        else if constexpr (!alloc_traits::propagate_on_container_move_assignment::value) {
+            // other's buffer cannot be adopted, as our allocator cannot free it, so the elements are moved one by one
+            T* new_arr = alloc_traits::allocate(alloc(), other.sz);
             try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(arr + i)));
+                my::uninitialized_move(alloc(), other.arr, other.arr + other.sz, new_arr);
             }
             catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_cap);
-                throw; 
+                alloc_traits::deallocate(alloc(), new_arr, other.sz);
+                throw;
             }
+            my::destroy_n(alloc(), arr, sz);
+            alloc_traits::deallocate(alloc(), arr, cap());
+            my::destroy_n(other.alloc(), other.arr, other.sz);
+            alloc_traits::deallocate(other.alloc(), other.arr, other.cap());
+            arr = new_arr;
+            cap() = other.sz;
+            sz = other.sz;
         }
-        if (!std::is_nothrow_move_constructible_v<T> && std::is_copy_constructible_v<Alloc>) {
-            for(std::size_t i = 0; i != sz; ++i) {
-                std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-            }
+        other.arr = nullptr;
+        other.cap() = 0;
+        other.sz = 0;
+        return *this;
+    }
+
+    //strong exception guarantee: T's move constructor is used only if it's noexcept or T cannot be copied (see uninitialized_relocate)
+    template<typename T, typename Alloc>
+    void vector<T, Alloc>::reallocate(std::size_t new_cap) {
+        T* new_arr = alloc_traits::allocate(alloc(), new_cap);
+        try {
+            my::uninitialized_relocate(alloc(), arr, arr + sz, new_arr);
+        }
+        catch(...) {
+            alloc_traits::deallocate(alloc(), new_arr, new_cap);
+            throw;
         }
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
+        alloc_traits::deallocate(alloc(), arr, cap());
         arr = new_arr;
-        cap = new_cap;
+        cap() = new_cap;
+    }
+    
+    template<typename T, typename Alloc>
+    void vector<T, Alloc>::reserve(std::size_t new_cap) {
+        if (new_cap <= cap()) return;
+        reallocate(new_cap);
     }
 
     template<typename T, typename Alloc>
     void vector<T,Alloc>::resize(std::size_t new_sz) {
-        if (new_sz > cap) {
-        T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, new_sz);
-        
-        for(std::size_t i = sz; i != new_sz; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + i, T());
-            }
-            catch(...) {
-                for(std::size_t j = sz; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_sz);
-                throw;
-            }
+        if (new_sz <= sz) {
+            my::destroy_n(alloc(), arr + new_sz, sz - new_sz);
+            sz = new_sz;
+            return;
         }
-
-        for(std::size_t i = 0; i != sz; ++i) {
+        if (new_sz > cap()) {
+            //the new elements are built first, so a throwing constructor leaves the vector as it was
+            T* new_arr = alloc_traits::allocate(alloc(), new_sz);
             try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(arr + i)));
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                for(std::size_t j = sz; j != new_sz; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_sz);
-                throw; 
-            }
-        }
-
-        if (!std::is_nothrow_move_constructible_v<T> && std::is_copy_constructible_v<Alloc>) {
-            for(std::size_t i = 0; i != sz; ++i) {
-                std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-            }
-        }
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-        arr = new_arr;
-        cap = new_sz;
-        sz = new_sz;
-        }
-        else {
-            for(std::size_t i = sz; i != new_sz; ++i) {
+                my::uninitialized_value_construct(alloc(), new_arr + sz, new_sz - sz);
                 try {
-                    std::allocator_traits<Alloc>::construct(alloc, arr + i, T());
+                    my::uninitialized_relocate(alloc(), arr, arr + sz, new_arr);
                 }
                 catch(...) {
-                    for(std::size_t j = sz; j != i; ++j) {
-                        std::allocator_traits<Alloc>::destroy(alloc, arr + j);
-                    }
+                    my::destroy_n(alloc(), new_arr + sz, new_sz - sz);
                     throw;
                 }
             }
-            sz = new_sz;
-        }
-    }
-    
-    template<typename T, typename Alloc>
-    void vector<T, Alloc>::resize(std::size_t new_sz, const T& value) {
-        if (new_sz > cap) {
-        T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, new_sz);
-        
-        for(std::size_t i = sz; i != new_sz; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + i, value);
-            }
             catch(...) {
-                for(std::size_t j = sz; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_sz);
+                alloc_traits::deallocate(alloc(), new_arr, new_sz);
                 throw;
             }
+            alloc_traits::deallocate(alloc(), arr, cap());
+            arr = new_arr;
+            cap() = new_sz;
         }
-
-        for(std::size_t i = 0; i != sz; ++i) {
-            try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(arr + i)));
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                for(std::size_t j = sz; j != new_sz; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_sz);
-                throw; 
-            }
-        }
-
-        if (!std::is_nothrow_move_constructible_v<T> && std::is_copy_constructible_v<Alloc>) {
-            for(std::size_t i = 0; i != sz; ++i) {
-                std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-            }
+        else {
+            my::uninitialized_value_construct(alloc(), arr + sz, new_sz - sz);
         }
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-        arr = new_arr;
-        cap = new_sz;
         sz = new_sz;
+    }
+    
+    template<typename T, typename Alloc>
+    void vector<T, Alloc>::resize(std::size_t new_sz, const T& value) {
+        if (new_sz <= sz) {
+            my::destroy_n(alloc(), arr + new_sz, sz - new_sz);
+            sz = new_sz;
+            return;
         }
-        else {
-            for(std::size_t i = sz; i != new_sz; ++i) {
+        if (new_sz > cap()) {
+            //value may refer to an element of this vector, so the copies are made before the old elements are moved out
+            T* new_arr = alloc_traits::allocate(alloc(), new_sz);
+            try {
+                my::uninitialized_fill(alloc(), new_arr + sz, new_sz - sz, value);
                 try {
-                    std::allocator_traits<Alloc>::construct(alloc, arr + i, value);
+                    my::uninitialized_relocate(alloc(), arr, arr + sz, new_arr);
                 }
                 catch(...) {
-                    for(std::size_t j = sz; j != i; ++j) {
-                        std::allocator_traits<Alloc>::destroy(alloc, arr + j);
-                    }
+                    my::destroy_n(alloc(), new_arr + sz, new_sz - sz);
                     throw;
                 }
             }
-            sz = new_sz;
+            catch(...) {
+                alloc_traits::deallocate(alloc(), new_arr, new_sz);
+                throw;
+            }
+            alloc_traits::deallocate(alloc(), arr, cap());
+            arr = new_arr;
+            cap() = new_sz;
         }
-
+        else {
+            my::uninitialized_fill(alloc(), arr + sz, new_sz - sz, value);
+        }
+        sz = new_sz;
     }
 
     template<typename T, typename Alloc>
     void vector<T, Alloc>::clear() noexcept {
-        for(std::size_t i = 0; i != sz; ++i) {
-            std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-        }
+        my::destroy_n(alloc(), arr, sz);
         sz = 0;
     }
 
     template<typename T, typename Alloc>
     vector<T, Alloc>::~vector() {
         clear();
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
+        alloc_traits::deallocate(alloc(), arr, cap());
     }
 
     template<typename T, typename Alloc>
     void vector<T, Alloc>::shrink_to_fit() {
-        if (sz == cap) return;
-        T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, sz);
-        for(std::size_t i = 0; i != sz; ++i) {
-            try {
-            std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(arr + i)));
-            }
-            catch(...) {
-                for(std::size_t j = 0; j != i; ++j) {
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                }
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, sz);
-                throw;
-            }
-        }
-        
-        if (!std::is_nothrow_move_constructible_v<Alloc> && std::is_copy_constructible_v<Alloc>) {
-           for(std::size_t i = 0; i != sz; ++i) {
-               std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-           }
-        }
-        std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
-
-        arr = new_arr;
-        cap = sz;
+        if (sz == cap()) return;
+        reallocate(sz);
     }
 
     template<typename T, typename Alloc>
     std::size_t vector<T, Alloc>::capacity() const noexcept {
-        return cap;
+        return cap();
     }
 
     template<typename T, typename Alloc>
@@ -637,12 +498,12 @@ namespace my {
 
     template<typename T, typename Alloc>
     T* vector<T, Alloc>::data() noexcept {
-        return arr;
+        return std::assume_aligned<alloc_traits::alignment>(arr); // lets vectorised loops over data() use aligned loads with aligned_allocator
     }
 
     template<typename T, typename Alloc>
     const T* vector<T, Alloc>::data() const noexcept {
-        return arr;
+        return std::assume_aligned<alloc_traits::alignment>(arr);
     }
 
     template<typename T, typename Alloc>    
@@ -699,46 +560,32 @@ namespace my {
     template<typename T, typename Alloc>
     template<typename... Args>
     void vector<T, Alloc>::emplace_back(Args&&... args) {
-        if (sz == cap) {
-            std::size_t new_cap = cap == 0 ? 1 : cap * 2;
-            std::size_t new_sz = sz + 1;
-            T* new_arr = std::allocator_traits<Alloc>::allocate(alloc, new_cap);
+        if (sz == cap()) {
+            std::size_t new_cap = cap() == 0 ? 1 : cap() * 2;
+            T* new_arr = alloc_traits::allocate(alloc(), new_cap);
             try {
-                std::allocator_traits<Alloc>::construct(alloc, new_arr + sz, std::forward<Args>(args)...);
-            }
-            catch(...) {
-                std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_cap);
-                throw;
-            }
-            for(std::size_t i = 0; i != sz; ++i) {
+                alloc_traits::construct(alloc(), new_arr + sz, std::forward<Args>(args)...); // first, because args may refer to our own elements
                 try {
-                    std::allocator_traits<Alloc>::construct(alloc, new_arr + i, std::move_if_noexcept(*(arr + i)));
+                    my::uninitialized_relocate(alloc(), arr, arr + sz, new_arr);
                 }
                 catch(...) {
-                    for(std::size_t j = 0; j != i; ++j) {
-                        std::allocator_traits<Alloc>::destroy(alloc, new_arr + j);
-                    }
-                    std::allocator_traits<Alloc>::destroy(alloc, new_arr + sz);
-                    std::allocator_traits<Alloc>::deallocate(alloc, new_arr, new_cap);
+                    alloc_traits::destroy(alloc(), new_arr + sz);
                     throw;
                 }
             }
-            
-            if (!std::is_nothrow_move_constructible_v<T> && std::is_copy_constructible_v<T>) {
-                for(std::size_t i = 0; i != sz; ++i) {
-                    std::allocator_traits<Alloc>::destroy(alloc, arr + i);
-                }
+            catch(...) {
+                alloc_traits::deallocate(alloc(), new_arr, new_cap);
+                throw;
             }
-            std::allocator_traits<Alloc>::deallocate(alloc, arr, cap);
+            alloc_traits::deallocate(alloc(), arr, cap());
             
             arr = new_arr;
-            cap = new_cap;
-            sz = new_sz;
+            cap() = new_cap;
         }
         else {
-            std::allocator_traits<Alloc>::construct(alloc, arr + sz, std::forward<Args>(args)...);
-            ++sz;
+            alloc_traits::construct(alloc(), arr + sz, std::forward<Args>(args)...);
         }
+        ++sz;
     }
     
     template<typename T, typename Alloc>
@@ -775,8 +622,8 @@ namespace my {
 
     template<typename T, typename Alloc>
     void vector<T, Alloc>::pop_back() {
-        std::allocator_traits<Alloc>::destroy(alloc, arr + sz);
         --sz;
+        alloc_traits::destroy(alloc(), arr + sz);
     }
 
     template<typename T, typename Alloc>
@@ -794,32 +641,15 @@ namespace my {
     //modify this later
     template<typename T, typename Alloc>
     void vector<T, Alloc>::swap(vector& other) 
-        noexcept(std::allocator_traits<Alloc>::is_always_equal::value || (std::allocator_traits<Alloc>::propagate_on_container_swap::value && std::is_nothrow_swappable_v<Alloc>))     {
-        if (std::allocator_traits<Alloc>::propagate_on_container_swap::value && (alloc != other.alloc)) {
-            std::swap(alloc, other.alloc);
+        noexcept(alloc_traits::is_always_equal::value || (alloc_traits::propagate_on_container_swap::value && std::is_nothrow_swappable_v<Alloc>))     {
+        if (alloc_traits::propagate_on_container_swap::value && (alloc() != other.alloc())) {
+            std::swap(alloc(), other.alloc());
         }
         std::swap(arr, other.arr);
         std::swap(sz, other.sz);
-        std::swap(cap, other.cap);
+        std::swap(cap(), other.cap());
     }
-};
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
 
+    static_assert(sizeof(vector<int>) == 3 * sizeof(void*), "vector with a stateless allocator must be three words");
 
+};
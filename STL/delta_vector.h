@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include "current_vector.h"
+#include "packed_int_vector.h"
+
+namespace my {
+
+    // Unsigned 64-bit integers stored as differences between neighbours, for sorted or clustered columns (ids, offsets, timestamps):
+    //
+    //  - every 256 values are sealed into a block: the differences to the previous value, bit-packed (the packed_int_vector layout)
+    //    with the width of the block's largest one. Deltas of a non-decreasing block are packed as they are, otherwise zigzag-encoded
+    //    (0, -1, 1, -2 -> 0, 1, 2, 3), so a block that goes down costs one more bit per value rather than 64
+    //  - the skip index has an entry per block: its first value, where its words start and its width.
+    //    operator[] jumps to the block and walks from its nearer end: at most 128 deltas, unpacked a row of 4 at a time.
+    //    decode() unpacks whole blocks with SSE2 and runs a prefix sum
+    //  - the last, unfinished block is kept as plain values, so push_back is amortised O(1) and no re-encoding ever happens.
+    //    There is no set(): changing a value would change the next delta too, decode, change and rebuild instead
+
+    class delta_vector {
+        struct block_info {
+            std::uint64_t base;   // the block's first value
+            std::size_t offset;   // into 'words'
+            std::uint8_t width;
+            bool zigzag;
+        };
+
+        my::vector<std::uint64_t> words; // sealed blocks, then packed_int_detail::padding zero words
+        my::vector<block_info> skip;     // one per sealed block
+        my::vector<std::uint64_t> tail;  // the open block, fewer than 256 values
+        std::uint64_t last_sealed = 0;   // the last value of the last sealed block
+        std::size_t sz = 0;
+
+        static std::uint64_t zigzag(std::uint64_t delta) noexcept {
+            return (delta << 1) ^ (0 - (delta >> 63));
+        }
+
+        static std::uint64_t unzigzag(std::uint64_t z) noexcept {
+            return (z >> 1) ^ (0 - (z & 1));
+        }
+
+        void seal();
+
+        // out[0..256) holds the block's packed deltas, turns them into values
+        static void prefix_sum(const block_info& info, std::uint64_t* out) noexcept;
+
+        // the last value of sealed block b
+        std::uint64_t block_back(std::size_t b) const noexcept;
+
+    public:
+        delta_vector() = default;
+
+        explicit delta_vector(const my::vector<std::uint64_t>& values);
+        delta_vector(std::initializer_list<std::uint64_t> init_l);
+
+        std::size_t size() const noexcept;
+        bool empty() const noexcept;
+
+        std::uint64_t operator[](std::size_t index) const noexcept;
+        std::uint64_t at(std::size_t index) const;
+        std::uint64_t front() const noexcept;
+        std::uint64_t back() const noexcept;
+
+        void push_back(std::uint64_t value);
+        void reserve(std::size_t new_cap);
+        void clear() noexcept;
+
+        // values [first, first + count) to out
+        void decode(std::size_t first, std::size_t count, std::uint64_t* out) const;
+        // all of them, out is resized to size()
+        void decode(my::vector<std::uint64_t>& out) const;
+        my::vector<std::uint64_t> to_vector() const;
+
+        // heap bytes in use (blocks, skip index, open block; sizes, not capacities), and how many times less that is than a my::vector<std::uint64_t>
+        std::size_t memory_bytes() const noexcept;
+        double compression_ratio() const noexcept;
+    };
+
+
+
+    inline delta_vector::delta_vector(const my::vector<std::uint64_t>& values) {
+        reserve(values.size());
+        for (std::size_t i = 0; i != values.size(); ++i) push_back(values[i]);
+    }
+
+    inline delta_vector::delta_vector(std::initializer_list<std::uint64_t> init_l) {
+        reserve(init_l.size());
+        for (std::uint64_t v : init_l) push_back(v);
+    }
+
+    inline void delta_vector::seal() {
+        using namespace packed_int_detail;
+        // delta 0 is the step from the previous block: the base already says where the block starts,
+        // but with it the end of the previous block can be found from this one's start
+        std::uint64_t deltas[block_size];
+        deltas[0] = skip.empty() ? 0 : tail[0] - last_sealed;
+        bool sorted = skip.empty() || tail[0] >= last_sealed;
+        for (std::size_t r = 1; r != block_size; ++r) {
+            deltas[r] = tail[r] - tail[r - 1];
+            sorted &= tail[r] >= tail[r - 1];
+        }
+        std::uint64_t all = 0;
+        for (std::size_t r = 0; r != block_size; ++r) {
+            if (!sorted) deltas[r] = zigzag(deltas[r]);
+            all |= deltas[r];
+        }
+        unsigned w = bit_width(all);
+
+        std::size_t offset = words.empty() ? 0 : words.size() - padding;
+        skip.push_back(block_info{tail[0], offset, static_cast<std::uint8_t>(w), !sorted});
+        try {
+            grow(words, offset + block_words(w) + padding); // the old padding becomes the new block's beginning, still zero
+        }
+        catch (...) {
+            skip.pop_back();
+            throw;
+        }
+        pack_block(deltas, block_size, w, words.data() + offset);
+        last_sealed = tail[block_size - 1];
+        tail.clear();
+    }
+
+    inline void delta_vector::prefix_sum(const block_info& info, std::uint64_t* out) noexcept {
+        using namespace packed_int_detail;
+        out[0] = info.base;
+        if (info.zigzag) {
+            for (std::size_t r = 1; r != block_size; ++r) out[r] = out[r - 1] + unzigzag(out[r]);
+        }
+        else {
+            for (std::size_t r = 1; r != block_size; ++r) out[r] += out[r - 1];
+        }
+    }
+
+    inline std::uint64_t delta_vector::block_back(std::size_t b) const noexcept {
+        if (b + 1 == skip.size()) return last_sealed;
+        const block_info& next = skip[b + 1];
+        std::uint64_t step = packed_int_detail::read(words.data() + next.offset, next.width, 0);
+        return next.base - (next.zigzag ? unzigzag(step) : step);
+    }
+
+    inline std::size_t delta_vector::size() const noexcept {
+        return sz;
+    }
+
+    inline bool delta_vector::empty() const noexcept {
+        return sz == 0;
+    }
+
+    inline std::uint64_t delta_vector::operator[](std::size_t index) const noexcept {
+        using namespace packed_int_detail;
+        std::size_t b = index / block_size, r = index % block_size;
+        if (b == skip.size()) return tail[r];
+
+        // only the rows between the value and the nearer end of the block are unpacked (a read() per delta would redo
+        // the bit arithmetic every time): the block's first value plus the deltas up to r, or its last value minus those after r
+        const block_info& info = skip[b];
+        const std::uint64_t* block = words.data() + info.offset;
+        std::uint64_t deltas[block_size];
+        std::uint64_t value;
+        if (r < block_size / 2) {
+            unpack_rows(block, info.width, 0, r / lanes + 1, deltas);
+            value = info.base;
+            if (info.zigzag) {
+                for (std::size_t j = 1; j <= r; ++j) value += unzigzag(deltas[j]);
+            }
+            else {
+                for (std::size_t j = 1; j <= r; ++j) value += deltas[j];
+            }
+        }
+        else {
+            std::size_t first = (r + 1) / lanes * lanes;
+            unpack_rows(block, info.width, first / lanes, block_size / lanes, deltas);
+            value = block_back(b);
+            if (info.zigzag) {
+                for (std::size_t j = r + 1; j != block_size; ++j) value -= unzigzag(deltas[j - first]);
+            }
+            else {
+                for (std::size_t j = r + 1; j != block_size; ++j) value -= deltas[j - first];
+            }
+        }
+        return value;
+    }
+
+    inline std::uint64_t delta_vector::at(std::size_t index) const {
+        if (index >= sz) {
+            throw std::out_of_range("delta_vector::at: index out of range!");
+        }
+        return (*this)[index];
+    }
+
+    inline std::uint64_t delta_vector::front() const noexcept {
+        return skip.empty() ? tail.front() : skip.front().base;
+    }
+
+    inline std::uint64_t delta_vector::back() const noexcept {
+        return tail.empty() ? last_sealed : tail.back();
+    }
+
+    inline void delta_vector::push_back(std::uint64_t value) {
+        tail.push_back(value);
+        if (tail.size() == packed_int_detail::block_size) {
+            try {
+                seal(); // leaves everything as it was if it throws
+            }
+            catch (...) {
+                tail.pop_back(); // so does push_back, the next one will try to seal again
+                throw;
+            }
+        }
+        ++sz;
+    }
+
+    inline void delta_vector::reserve(std::size_t new_cap) {
+        skip.reserve(new_cap / packed_int_detail::block_size);
+        tail.reserve(packed_int_detail::block_size);
+    }
+
+    inline void delta_vector::clear() noexcept {
+        words.clear();
+        skip.clear();
+        tail.clear();
+        last_sealed = 0;
+        sz = 0;
+    }
+
+    inline void delta_vector::decode(std::size_t first, std::size_t count, std::uint64_t* out) const {
+        using namespace packed_int_detail;
+        if (first + count > sz) {
+            throw std::out_of_range("delta_vector::decode: range out of range!");
+        }
+        std::uint64_t buffer[block_size];
+        std::size_t i = first, last = first + count;
+        while (i != last) {
+            std::size_t b = i / block_size, r = i % block_size;
+            std::size_t n = std::min(block_size - r, last - i);
+            if (b == skip.size()) {
+                for (std::size_t j = 0; j != n; ++j) out[j] = tail[r + j];
+            }
+            else if (n == block_size) {
+                unpack_block(words.data() + skip[b].offset, skip[b].width, out); // straight into place
+                prefix_sum(skip[b], out);
+            }
+            else {
+                unpack_block(words.data() + skip[b].offset, skip[b].width, buffer);
+                prefix_sum(skip[b], buffer);
+                for (std::size_t j = 0; j != n; ++j) out[j] = buffer[r + j];
+            }
+            i += n;
+            out += n;
+        }
+    }
+
+    inline void delta_vector::decode(my::vector<std::uint64_t>& out) const {
+        out.resize(sz);
+        decode(0, sz, out.data());
+    }
+
+    inline my::vector<std::uint64_t> delta_vector::to_vector() const {
+        my::vector<std::uint64_t> out;
+        decode(out);
+        return out;
+    }
+
+    inline std::size_t delta_vector::memory_bytes() const noexcept {
+        return words.size() * sizeof(std::uint64_t) + skip.size() * sizeof(block_info) + tail.size() * sizeof(std::uint64_t);
+    }
+
+    inline double delta_vector::compression_ratio() const noexcept {
+        std::size_t bytes = memory_bytes();
+        return bytes == 0 ? 1.0 : double(sz * sizeof(std::uint64_t)) / double(bytes);
+    }
+
+};
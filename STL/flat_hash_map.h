@@ -0,0 +1,828 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MY_FLAT_HASH_SSE2 1
+#endif
+#include "alloc_traits.h"
+
+namespace my {
+
+    // Swiss-table style open addressing: one control byte per slot kept in a separate array and probed 16 at a time.
+    // A control byte is either empty, deleted (tombstone), the end-of-table sentinel or, for a full slot,
+    // the low 7 bits of the key's hash (H2). The rest of the hash (H1) chooses where the probe sequence starts.
+    //
+    // The capacity is always 2^k - 1 and the control array has capacity + 1 + 15 bytes: the sentinel follows the last slot
+    // and the first 15 bytes are cloned after it, so a 16-byte group can be loaded at any slot without wrapping around.
+
+    // not std::conditional_t: the alias has to resolve to K2 itself, so that K2 stays deducible in find(const key_arg<K2>&)
+    template<bool isTransparent>
+    struct hash_key_arg {
+        template<typename K2, typename Key>
+        using type = Key;
+    };
+
+    template<>
+    struct hash_key_arg<true> {
+        template<typename K2, typename Key>
+        using type = K2;
+    };
+
+
+    template<typename Policy, typename Hash, typename KeyEqual, typename Alloc>
+    class raw_hash_table {
+
+        using ctrl_t = std::int8_t;
+
+        static constexpr ctrl_t ctrl_empty = -128;   // 0b10000000
+        static constexpr ctrl_t ctrl_deleted = -2;   // 0b11111110
+        static constexpr ctrl_t ctrl_sentinel = -1;  // 0b11111111
+        static constexpr std::size_t group_width = 16;
+
+        // what a group of 16 control bytes is asked about, every answer is a 16-bit mask with bit i for byte i
+        class group {
+
+#ifdef MY_FLAT_HASH_SSE2
+            __m128i ctrl;
+
+        public:
+            explicit group(const ctrl_t* p) noexcept : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+            std::uint32_t match(ctrl_t h2) const noexcept {
+                return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+            }
+
+            std::uint32_t match_empty() const noexcept {
+                return match(ctrl_empty);
+            }
+
+            std::uint32_t match_empty_or_deleted() const noexcept {
+                return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(ctrl_sentinel), ctrl))); // the only two values below the sentinel
+            }
+#else
+            ctrl_t ctrl[group_width];
+
+        public:
+            explicit group(const ctrl_t* p) noexcept {
+                std::memcpy(ctrl, p, group_width);
+            }
+
+            std::uint32_t match(ctrl_t h2) const noexcept {
+                std::uint32_t mask = 0;
+                for(std::size_t i = 0; i != group_width; ++i) {
+                    mask |= static_cast<std::uint32_t>(ctrl[i] == h2) << i;
+                }
+                return mask;
+            }
+
+            std::uint32_t match_empty() const noexcept {
+                return match(ctrl_empty);
+            }
+
+            std::uint32_t match_empty_or_deleted() const noexcept {
+                std::uint32_t mask = 0;
+                for(std::size_t i = 0; i != group_width; ++i) {
+                    mask |= static_cast<std::uint32_t>(ctrl[i] < ctrl_sentinel) << i;
+                }
+                return mask;
+            }
+#endif
+
+            std::size_t count_leading_empty_or_deleted() const noexcept {
+                return static_cast<std::size_t>(std::countr_zero(match_empty_or_deleted() + 1)); // the +1 turns the trailing ones into zeros
+            }
+        };
+
+        // the table every empty container points to, so that lookups and iteration need no special case for 'no memory'
+        static ctrl_t* empty_group() noexcept {
+            alignas(16) static constexpr ctrl_t group[group_width] = {ctrl_sentinel, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty,
+                                                                      ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty};
+            return const_cast<ctrl_t*>(group); // never written to: capacity 0 means no growth left, so the first insert reallocates
+        }
+
+    public:
+        using key_type = typename Policy::key_type;
+        using value_type = typename Policy::value_type;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using hasher = Hash;
+        using key_equal = KeyEqual;
+        using allocator_type = Alloc;
+
+    private:
+        using slot_type = typename Policy::slot_type;
+        using slot_alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<slot_type>;
+        using slot_traits = my::allocator_traits<slot_alloc_type>;
+        using ctrl_alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<ctrl_t>;
+        using ctrl_traits = my::allocator_traits<ctrl_alloc_type>;
+
+    protected:
+        static constexpr bool is_transparent = requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; };
+
+        // with transparent Hash and KeyEqual lookups take any K2 and don't build a key_type, otherwise K2 is not deducible and key_type is used
+        template<typename K2>
+        using key_arg = typename hash_key_arg<is_transparent>::template type<K2, key_type>;
+
+    private:
+
+        template<bool isConst>
+        class common_iterator {
+
+            friend class raw_hash_table;
+
+            template<bool>
+            friend class common_iterator;
+
+            ctrl_t* ctrl;
+            slot_type* slot;
+
+            common_iterator(ctrl_t* ctrl, slot_type* slot) noexcept : ctrl(ctrl), slot(slot) {}
+
+            void skip_empty_or_deleted() noexcept {
+                while (*ctrl < ctrl_sentinel) {
+                    std::size_t shift = group(ctrl).count_leading_empty_or_deleted();
+                    ctrl += shift;
+                    slot += shift;
+                }
+            }
+
+        public:
+            using difference_type = std::ptrdiff_t;
+            using value_type = typename Policy::value_type;
+            using pointer = std::conditional_t<isConst || Policy::constant_iterators, const value_type*, value_type*>;
+            using reference = std::conditional_t<isConst || Policy::constant_iterators, const value_type&, value_type&>;
+            using iterator_category = std::forward_iterator_tag;
+
+            common_iterator() noexcept : ctrl(nullptr), slot(nullptr) {}
+
+            operator common_iterator<true>() const noexcept {
+                return common_iterator<true>(ctrl, slot);
+            }
+
+            reference operator*() const noexcept {
+                return Policy::element(*slot);
+            }
+
+            pointer operator->() const noexcept {
+                return &Policy::element(*slot);
+            }
+
+            common_iterator& operator++() noexcept {
+                ++ctrl;
+                ++slot;
+                skip_empty_or_deleted();
+                return *this;
+            }
+
+            common_iterator operator++(int) noexcept {
+                common_iterator cp = *this;
+                ++*this;
+                return cp;
+            }
+
+            bool operator==(const common_iterator& other) const noexcept {
+                return ctrl == other.ctrl;
+            }
+
+            bool operator!=(const common_iterator& other) const noexcept {
+                return ctrl != other.ctrl;
+            }
+        };
+
+    public:
+        using iterator = common_iterator<false>;
+        using const_iterator = common_iterator<true>;
+
+    private:
+
+        ctrl_t* ctrl;
+        slot_type* slots;
+        std::size_t cap;
+        std::size_t sz;
+        std::size_t growth_left; // inserts into empty slots still allowed before the next rehash, tombstones eat it too
+        Hash hash;
+        KeyEqual eq;
+        slot_alloc_type alloc;
+
+        static std::size_t mix(std::size_t h) noexcept {
+            // std::hash of an integer is the integer itself, so the bits are spread before being split into H1 and H2
+            if constexpr (sizeof(std::size_t) == 8) {
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdull;
+                h ^= h >> 33;
+            }
+            else {
+                h ^= h >> 16;
+                h *= 0x85ebca6bu;
+                h ^= h >> 13;
+            }
+            return h;
+        }
+
+        static std::size_t h1(std::size_t h) noexcept {
+            return h >> 7;
+        }
+
+        static ctrl_t h2(std::size_t h) noexcept {
+            return static_cast<ctrl_t>(h & 0x7f);
+        }
+
+        static std::size_t max_load(std::size_t capacity) noexcept {
+            return capacity - capacity / 8; // 7/8
+        }
+
+        static std::size_t capacity_for(std::size_t num_of_elem) noexcept {
+            std::size_t capacity = group_width - 1;
+            while (max_load(capacity) < num_of_elem) {
+                capacity = capacity * 2 + 1;
+            }
+            return capacity;
+        }
+
+        template<typename K2>
+        std::size_t hash_of(const K2& key) const {
+            return mix(hash(key));
+        }
+
+        void set_ctrl(std::size_t i, ctrl_t h) noexcept {
+            ctrl[i] = h;
+            ctrl[((i - (group_width - 1)) & cap) + (group_width - 1)] = h; // the clone for the first 15 slots, the same byte otherwise
+        }
+
+        // quadratic probing over groups: offset, offset + 16, offset + 48, ... (mod capacity + 1) visits every group
+        template<typename Visitor>
+        std::size_t probe(std::size_t h, Visitor visit) const {
+            std::size_t offset = h1(h) & cap;
+            for(std::size_t step = group_width; ; step += group_width) {
+                group g(ctrl + offset);
+                std::size_t result = visit(g, offset);
+                if (result != npos) {
+                    return result;
+                }
+                offset = (offset + step) & cap;
+            }
+        }
+
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+        static constexpr std::size_t not_found = npos - 1;
+
+        template<typename K2>
+        std::size_t find_index(const K2& key, std::size_t h) const {
+            std::size_t index = probe(h, [&](const group& g, std::size_t offset) {
+                for(std::uint32_t mask = g.match(h2(h)); mask != 0; mask &= mask - 1) {
+                    std::size_t i = (offset + std::countr_zero(mask)) & cap;
+                    if (eq(Policy::key(slots[i]), key)) {
+                        return i;
+                    }
+                }
+                return g.match_empty() != 0 ? not_found : npos; // an empty byte ends every probe sequence that could have gone past it
+            });
+            return index == not_found ? npos : index;
+        }
+
+        std::size_t find_first_non_full(std::size_t h) const noexcept {
+            return probe(h, [&](const group& g, std::size_t offset) {
+                std::uint32_t mask = g.match_empty_or_deleted();
+                return mask != 0 ? ((offset + std::countr_zero(mask)) & cap) : npos;
+            });
+        }
+
+        void allocate_table(std::size_t capacity) {
+            ctrl_alloc_type ctrl_alloc(alloc);
+            ctrl_t* new_ctrl = ctrl_traits::allocate(ctrl_alloc, capacity + group_width);
+            slot_type* new_slots;
+            try {
+                new_slots = slot_traits::allocate(alloc, capacity);
+            }
+            catch(...) {
+                ctrl_traits::deallocate(ctrl_alloc, new_ctrl, capacity + group_width);
+                throw;
+            }
+            std::memset(new_ctrl, static_cast<unsigned char>(ctrl_empty), capacity + group_width);
+            new_ctrl[capacity] = ctrl_sentinel;
+            ctrl = new_ctrl;
+            slots = new_slots;
+            cap = capacity;
+            growth_left = max_load(capacity);
+        }
+
+        void deallocate_table() noexcept {
+            if (cap == 0) return;
+            ctrl_alloc_type ctrl_alloc(alloc);
+            ctrl_traits::deallocate(ctrl_alloc, ctrl, cap + group_width);
+            slot_traits::deallocate(alloc, slots, cap);
+        }
+
+        void destroy_slots() noexcept {
+            if constexpr (!std::is_trivially_destructible_v<slot_type> || slot_traits::template has_custom_destroy<slot_type>) {
+                for(std::size_t i = 0; i != cap; ++i) {
+                    if (ctrl[i] >= 0) {
+                        slot_traits::destroy(alloc, slots + i);
+                    }
+                }
+            }
+        }
+
+        void reset_to_empty() noexcept {
+            ctrl = empty_group();
+            slots = nullptr;
+            cap = 0;
+            sz = 0;
+            growth_left = 0;
+        }
+
+        // strong guarantee: every element is moved (or copied, if its move may throw) into the new table before anything in the old one is destroyed
+        void resize(std::size_t new_cap) {
+            ctrl_t* old_ctrl = ctrl;
+            slot_type* old_slots = slots;
+            std::size_t old_cap = cap;
+            std::size_t old_growth_left = growth_left;
+
+            allocate_table(new_cap);
+            std::size_t moved = 0;
+            try {
+                for(std::size_t i = 0; i != old_cap; ++i) {
+                    if (old_ctrl[i] >= 0) {
+                        std::size_t h = hash_of(Policy::key(old_slots[i]));
+                        std::size_t target = find_first_non_full(h);
+                        slot_traits::construct(alloc, slots + target, std::move_if_noexcept(old_slots[i]));
+                        set_ctrl(target, h2(h));
+                        ++moved;
+                    }
+                }
+            }
+            catch(...) {
+                destroy_slots();
+                deallocate_table();
+                ctrl = old_ctrl;
+                slots = old_slots;
+                cap = old_cap;
+                growth_left = old_growth_left;
+                throw;
+            }
+            growth_left -= moved;
+
+            if (old_cap != 0) {
+                for(std::size_t i = 0; i != old_cap; ++i) {
+                    if (old_ctrl[i] >= 0) {
+                        slot_traits::destroy(alloc, old_slots + i);
+                    }
+                }
+                ctrl_alloc_type ctrl_alloc(alloc);
+                ctrl_traits::deallocate(ctrl_alloc, old_ctrl, old_cap + group_width);
+                slot_traits::deallocate(alloc, old_slots, old_cap);
+            }
+        }
+
+        // returns the slot for a new element with hash h, growing (or just dropping tombstones) when there's no room left
+        std::size_t prepare_insert(std::size_t h) {
+            std::size_t target = find_first_non_full(h);
+            if (growth_left == 0 && ctrl[target] != ctrl_deleted) {
+                if (cap > group_width && sz * 32 <= cap * 25) {
+                    resize(cap); // mostly tombstones: a rehash in place of the same size is enough
+                }
+                else {
+                    resize(cap == 0 ? group_width - 1 : cap * 2 + 1);
+                }
+                target = find_first_non_full(h);
+            }
+            return target;
+        }
+
+        void commit_insert(std::size_t i, std::size_t h) noexcept {
+            growth_left -= (ctrl[i] == ctrl_empty);
+            set_ctrl(i, h2(h));
+            ++sz;
+        }
+
+        void erase_at(std::size_t i) noexcept {
+            slot_traits::destroy(alloc, slots + i);
+            --sz;
+            // the slot may become empty again (no tombstone) if no probe sequence could ever have passed a full group here:
+            // that is, if there's an empty byte within 16 bytes on both sides and the gap between them is shorter than a group
+            std::size_t index_before = (i - group_width) & cap;
+            std::uint32_t empty_after = group(ctrl + i).match_empty();
+            std::uint32_t empty_before = group(ctrl + index_before).match_empty();
+            bool was_never_full = empty_before && empty_after &&
+                                  static_cast<std::size_t>(std::countr_zero(empty_after) + std::countl_zero(static_cast<std::uint16_t>(empty_before))) < group_width;
+            set_ctrl(i, was_never_full ? ctrl_empty : ctrl_deleted);
+            growth_left += was_never_full;
+        }
+
+        template<typename K2, typename... Args>
+        std::pair<iterator, bool> emplace_key(const K2& key, Args&&... args) {
+            std::size_t h = hash_of(key);
+            std::size_t i = find_index(key, h);
+            if (i != npos) {
+                return {iterator_at(i), false};
+            }
+            i = prepare_insert(h);
+            slot_traits::construct(alloc, slots + i, std::forward<Args>(args)...);
+            commit_insert(i, h);
+            return {iterator_at(i), true};
+        }
+
+        iterator iterator_at(std::size_t i) noexcept {
+            return iterator(ctrl + i, slots + i);
+        }
+
+        const_iterator iterator_at(std::size_t i) const noexcept {
+            return const_iterator(ctrl + i, slots + i);
+        }
+
+        void copy_from(const raw_hash_table& other) {
+            if (other.sz == 0) return;
+            allocate_table(other.cap);
+            std::size_t i = 0;
+            try {
+                for(; i != other.cap; ++i) {
+                    if (other.ctrl[i] >= 0) {
+                        slot_traits::construct(alloc, slots + i, other.slots[i]);
+                    }
+                }
+            }
+            catch(...) {
+                for(std::size_t j = 0; j != i; ++j) {
+                    if (other.ctrl[j] >= 0) {
+                        slot_traits::destroy(alloc, slots + j);
+                    }
+                }
+                deallocate_table();
+                reset_to_empty();
+                throw;
+            }
+            std::memcpy(ctrl, other.ctrl, cap + group_width);
+            sz = other.sz;
+            growth_left = other.growth_left;
+        }
+
+    public:
+
+        explicit raw_hash_table(std::size_t bucket_count = 0, const Hash& hash = Hash(), const KeyEqual& eq = KeyEqual(), const Alloc& alloc = Alloc())
+            : hash(hash),
+            eq(eq),
+            alloc(alloc)
+        {
+            reset_to_empty();
+            if (bucket_count != 0) {
+                allocate_table(capacity_for(bucket_count));
+            }
+        }
+
+        raw_hash_table(const raw_hash_table& other)
+            : hash(other.hash),
+            eq(other.eq),
+            alloc(slot_traits::select_on_container_copy_construction(other.alloc))
+        {
+            reset_to_empty();
+            copy_from(other);
+        }
+
+        raw_hash_table(raw_hash_table&& other) noexcept
+            : ctrl(other.ctrl),
+            slots(other.slots),
+            cap(other.cap),
+            sz(other.sz),
+            growth_left(other.growth_left),
+            hash(std::move(other.hash)),
+            eq(std::move(other.eq)),
+            alloc(std::move(other.alloc))
+        {
+            other.reset_to_empty();
+        }
+
+        raw_hash_table& operator=(const raw_hash_table& other) {
+            raw_hash_table copy(other);
+            swap(copy);
+            return *this;
+        }
+
+        raw_hash_table& operator=(raw_hash_table&& other) noexcept {
+            raw_hash_table moved(std::move(other));
+            swap(moved);
+            return *this;
+        }
+
+        ~raw_hash_table() {
+            destroy_slots();
+            deallocate_table();
+        }
+
+        //iterators
+
+        iterator begin() noexcept {
+            iterator it = iterator_at(0);
+            it.skip_empty_or_deleted();
+            return it;
+        }
+
+        iterator end() noexcept {
+            return iterator_at(cap);
+        }
+
+        const_iterator begin() const noexcept {
+            const_iterator it = iterator_at(0);
+            it.skip_empty_or_deleted();
+            return it;
+        }
+
+        const_iterator end() const noexcept {
+            return iterator_at(cap);
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+        //capacity
+
+        std::size_t size() const noexcept {
+            return sz;
+        }
+
+        bool empty() const noexcept {
+            return sz == 0;
+        }
+
+        std::size_t capacity() const noexcept {
+            return cap;
+        }
+
+        float load_factor() const noexcept {
+            return cap == 0 ? 0.0f : static_cast<float>(sz) / static_cast<float>(cap);
+        }
+
+        void reserve(std::size_t num_of_elem) {
+            if (num_of_elem > sz + growth_left) {
+                resize(capacity_for(num_of_elem));
+            }
+        }
+
+        void rehash(std::size_t num_of_elem) {
+            std::size_t new_cap = capacity_for(num_of_elem > sz ? num_of_elem : sz);
+            if (sz == 0 && num_of_elem == 0) {
+                clear();
+                deallocate_table();
+                reset_to_empty();
+            }
+            else {
+                resize(new_cap);
+            }
+        }
+
+        //modifiers
+
+        void clear() noexcept {
+            if (cap == 0) return;
+            destroy_slots();
+            std::memset(ctrl, static_cast<unsigned char>(ctrl_empty), cap + group_width);
+            ctrl[cap] = ctrl_sentinel;
+            sz = 0;
+            growth_left = max_load(cap);
+        }
+
+        std::pair<iterator, bool> insert(const value_type& value) {
+            return emplace_key(Policy::key(value), value);
+        }
+
+        std::pair<iterator, bool> insert(value_type&& value) {
+            return emplace_key(Policy::key(value), std::move(value));
+        }
+
+        template<typename InputIt>
+        void insert(InputIt first, InputIt last) {
+            for(; first != last; ++first) {
+                insert(*first);
+            }
+        }
+
+        void insert(std::initializer_list<value_type> init_l) {
+            insert(init_l.begin(), init_l.end());
+        }
+
+        // the element is built first, because the key can be known only after that; the map's try_emplace avoids it
+        template<typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args) {
+            slot_type tmp(std::forward<Args>(args)...);
+            return emplace_key(Policy::key(tmp), std::move(tmp));
+        }
+
+        iterator erase(const_iterator pos) noexcept {
+            std::size_t i = static_cast<std::size_t>(pos.ctrl - ctrl);
+            erase_at(i);
+            iterator next = iterator_at(i);
+            next.skip_empty_or_deleted();
+            return next;
+        }
+
+        iterator erase(iterator pos) noexcept {
+            return erase(const_iterator(pos));
+        }
+
+        template<typename K2 = key_type>
+        std::size_t erase(const key_arg<K2>& key) {
+            std::size_t i = find_index(key, hash_of(key));
+            if (i == npos) {
+                return 0;
+            }
+            erase_at(i);
+            return 1;
+        }
+
+        void swap(raw_hash_table& other) noexcept {
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+            std::swap(cap, other.cap);
+            std::swap(sz, other.sz);
+            std::swap(growth_left, other.growth_left);
+            std::swap(hash, other.hash);
+            std::swap(eq, other.eq);
+            std::swap(alloc, other.alloc);
+        }
+
+        //lookup
+
+        template<typename K2 = key_type>
+        iterator find(const key_arg<K2>& key) {
+            std::size_t i = find_index(key, hash_of(key));
+            return i == npos ? end() : iterator_at(i);
+        }
+
+        template<typename K2 = key_type>
+        const_iterator find(const key_arg<K2>& key) const {
+            std::size_t i = find_index(key, hash_of(key));
+            return i == npos ? end() : iterator_at(i);
+        }
+
+        template<typename K2 = key_type>
+        bool contains(const key_arg<K2>& key) const {
+            return find_index(key, hash_of(key)) != npos;
+        }
+
+        template<typename K2 = key_type>
+        std::size_t count(const key_arg<K2>& key) const {
+            return contains<K2>(key) ? 1 : 0;
+        }
+
+        //observers
+
+        hasher hash_function() const {
+            return hash;
+        }
+
+        key_equal key_eq() const {
+            return eq;
+        }
+
+        allocator_type get_allocator() const {
+            return allocator_type(alloc);
+        }
+
+    protected:
+
+        template<typename K2, typename... Args>
+        std::pair<iterator, bool> try_emplace_impl(K2&& key, Args&&... args) {
+            return emplace_key(key, std::piecewise_construct, std::forward_as_tuple(std::forward<K2>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+    };
+
+
+    template<typename K, typename V>
+    struct flat_hash_map_policy {
+
+        using key_type = K;
+        using value_type = std::pair<const K, V>;
+        using slot_type = std::pair<K, V>; // mutable key, so that a rehash can move it; the user only ever sees value_type
+        static constexpr bool constant_iterators = false;
+
+        template<typename Pair>
+        static const K& key(const Pair& p) noexcept {
+            return p.first;
+        }
+
+        static value_type& element(slot_type& slot) noexcept {
+            return *std::launder(reinterpret_cast<value_type*>(&slot)); // layout-compatible, the same trick node-free hash maps generally use
+        }
+    };
+
+
+    template<typename K>
+    struct flat_hash_set_policy {
+
+        using key_type = K;
+        using value_type = K;
+        using slot_type = K;
+        static constexpr bool constant_iterators = true;
+
+        static const K& key(const K& k) noexcept {
+            return k;
+        }
+
+        static K& element(K& slot) noexcept {
+            return slot;
+        }
+    };
+
+
+    template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>, typename Alloc = std::allocator<std::pair<const K, V>>>
+    class flat_hash_map : public raw_hash_table<flat_hash_map_policy<K, V>, Hash, KeyEqual, Alloc> {
+
+        using base = raw_hash_table<flat_hash_map_policy<K, V>, Hash, KeyEqual, Alloc>;
+
+        template<typename K2>
+        using key_arg = typename base::template key_arg<K2>;
+
+    public:
+        using mapped_type = V;
+        using typename base::iterator;
+        using typename base::const_iterator;
+        using typename base::value_type;
+
+        using base::base;
+
+        flat_hash_map(std::initializer_list<value_type> init_l, std::size_t bucket_count = 0, const Hash& hash = Hash(), const KeyEqual& eq = KeyEqual(), const Alloc& alloc = Alloc())
+            : base(bucket_count ? bucket_count : init_l.size(), hash, eq, alloc)
+        {
+            base::insert(init_l);
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+            return base::try_emplace_impl(key, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+            return base::try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+        }
+
+        template<typename M>
+        std::pair<iterator, bool> insert_or_assign(const K& key, M&& value) {
+            auto result = try_emplace(key, std::forward<M>(value));
+            if (!result.second) {
+                result.first->second = std::forward<M>(value);
+            }
+            return result;
+        }
+
+        V& operator[](const K& key) {
+            return try_emplace(key).first->second;
+        }
+
+        V& operator[](K&& key) {
+            return try_emplace(std::move(key)).first->second;
+        }
+
+        template<typename K2 = K>
+        V& at(const key_arg<K2>& key) {
+            auto it = base::template find<K2>(key);
+            if (it == base::end()) {
+                throw std::out_of_range("flat_hash_map::at: no such key!");
+            }
+            return it->second;
+        }
+
+        template<typename K2 = K>
+        const V& at(const key_arg<K2>& key) const {
+            auto it = base::template find<K2>(key);
+            if (it == base::end()) {
+                throw std::out_of_range("flat_hash_map::at: no such key!");
+            }
+            return it->second;
+        }
+    };
+
+
+    template<typename K, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>, typename Alloc = std::allocator<K>>
+    class flat_hash_set : public raw_hash_table<flat_hash_set_policy<K>, Hash, KeyEqual, Alloc> {
+
+        using base = raw_hash_table<flat_hash_set_policy<K>, Hash, KeyEqual, Alloc>;
+
+    public:
+        using typename base::value_type;
+
+        using base::base;
+
+        flat_hash_set(std::initializer_list<value_type> init_l, std::size_t bucket_count = 0, const Hash& hash = Hash(), const KeyEqual& eq = KeyEqual(), const Alloc& alloc = Alloc())
+            : base(bucket_count ? bucket_count : init_l.size(), hash, eq, alloc)
+        {
+            base::insert(init_l);
+        }
+    };
+
+};
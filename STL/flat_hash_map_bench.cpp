@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "flat_hash_map.h"
+
+// my::flat_hash_map against std::unordered_map<std::uint64_t, std::uint64_t>, ns per operation, at a few sizes:
+// inserting n random keys into an empty map (rehashes included), looking up keys that are there (hit) and keys that
+// aren't (miss), and iterating over everything. The lookups go in random order, so the bigger sizes miss the cache.
+// Usage: flat_hash_map_bench [lookups per point = 4000000], a Release build
+
+static volatile std::uint64_t sink; // keeps the lookups from being optimised away
+
+template<typename F>
+static double ns_per_op(long ops, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(ops);
+}
+
+template<typename Map>
+static void run(const char* name, const std::vector<std::uint64_t>& keys, const std::vector<std::uint64_t>& absent, long lookups) {
+    const long n = static_cast<long>(keys.size());
+    Map map;
+    double insert = ns_per_op(n, [&] {
+        for (std::uint64_t k : keys) map.emplace(k, k);
+    });
+
+    std::uint64_t sum = 0;
+    double hit = ns_per_op(lookups, [&] {
+        for (long i = 0; i != lookups; ++i) {
+            auto it = map.find(keys[static_cast<std::size_t>(i % n)]);
+            sum += it->second;
+        }
+    });
+
+    double miss = ns_per_op(lookups, [&] {
+        for (long i = 0; i != lookups; ++i) {
+            sum += map.find(absent[static_cast<std::size_t>(i % n)]) == map.end();
+        }
+    });
+
+    const long rounds = lookups / n + 1;
+    double iterate = ns_per_op(rounds * n, [&] {
+        for (long r = 0; r != rounds; ++r) {
+            for (const auto& [k, v] : map) sum += v;
+        }
+    });
+
+    sink = sum;
+    std::printf("%-20s %9ld   insert %7.2f ns   hit %7.2f ns   miss %7.2f ns   iterate %6.2f ns\n", name, n, insert, hit, miss, iterate);
+}
+
+int main(int argc, char** argv) {
+    long lookups = argc > 1 ? std::atol(argv[1]) : 4'000'000;
+    std::mt19937_64 rng(2024);
+
+    for (std::size_t n : {1'000u, 100'000u, 4'000'000u}) {
+        // odd keys are in the map, even ones are the misses; both lists shuffled
+        std::vector<std::uint64_t> keys(n), absent(n);
+        for (std::size_t i = 0; i != n; ++i) {
+            std::uint64_t k = rng() & ~std::uint64_t(1);
+            keys[i] = k | 1;
+            absent[i] = k;
+        }
+        run<my::flat_hash_map<std::uint64_t, std::uint64_t>>("my::flat_hash_map", keys, absent, lookups);
+        run<std::unordered_map<std::uint64_t, std::uint64_t>>("std::unordered_map", keys, absent, lookups);
+    }
+    return 0;
+}
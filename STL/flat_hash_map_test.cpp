@@ -0,0 +1,244 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include "flat_hash_map.h"
+
+// Tests for my::flat_hash_map and my::flat_hash_set: random inserts and erases checked against std::unordered_map
+// (so tombstones, reuse of empty slots and rehashes all get exercised), heterogeneous lookup, copies and moves,
+// a hash that puts everything into one probe sequence, and a value type that throws halfway through a copy.
+
+static long live = 0;
+static long allocated = 0;
+
+struct counted {
+    long value;
+
+    explicit counted(long value) : value(value) { ++live; }
+    counted(const counted& other) : value(other.value) { ++live; }
+    counted(counted&& other) noexcept : value(other.value) { ++live; }
+    counted& operator=(const counted&) = default;
+    ~counted() { --live; }
+};
+
+// counts what the table holds, so a leak of either array shows up
+template<typename T>
+struct counting_alloc {
+    using value_type = T;
+
+    counting_alloc() = default;
+
+    template<typename U>
+    counting_alloc(const counting_alloc<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        allocated += static_cast<long>(n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        allocated -= static_cast<long>(n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const counting_alloc<U>&) const noexcept { return true; }
+};
+
+using map_type = my::flat_hash_map<long, counted, std::hash<long>, std::equal_to<long>, counting_alloc<std::pair<const long, counted>>>;
+
+template<typename Map>
+static void check_equal(const Map& map, const std::unordered_map<long, long>& expected) {
+    assert(map.size() == expected.size());
+    assert(map.empty() == expected.empty());
+    std::size_t visited = 0;
+    for (const auto& [key, value] : map) {
+        auto it = expected.find(key);
+        assert(it != expected.end() && it->second == value.value);
+        ++visited;
+    }
+    assert(visited == expected.size());
+    for (const auto& [key, value] : expected) {
+        auto it = map.find(key);
+        assert(it != map.end() && it->second.value == value);
+    }
+}
+
+static void random_against_std(std::size_t ops, long key_range) {
+    std::mt19937_64 rng(12345);
+    std::uniform_int_distribution<long> keys(0, key_range - 1);
+    {
+        map_type map;
+        std::unordered_map<long, long> expected;
+        for (std::size_t i = 0; i != ops; ++i) {
+            long key = keys(rng);
+            switch (rng() % 4) {
+            case 0:
+            case 1: {
+                auto [it, inserted] = map.try_emplace(key, key * 3);
+                assert(inserted == expected.emplace(key, key * 3).second);
+                assert(it->first == key);
+                break;
+            }
+            case 2:
+                assert(map.erase(key) == expected.erase(key));
+                break;
+            default:
+                assert(map.contains(key) == expected.contains(key));
+                assert(map.count(key) == expected.count(key));
+                break;
+            }
+            assert(map.size() == expected.size());
+            assert(map.size() <= map.capacity());
+            if (i % 1000 == 0) check_equal(map, expected);
+        }
+        check_equal(map, expected);
+
+        // erase while iterating: every other element
+        bool drop = false;
+        for (auto it = map.begin(); it != map.end();) {
+            if (drop) {
+                expected.erase(it->first);
+                it = map.erase(it);
+            }
+            else {
+                ++it;
+            }
+            drop = !drop;
+        }
+        check_equal(map, expected);
+
+        map_type copy = map;
+        check_equal(copy, expected);
+        map_type moved = std::move(copy);
+        check_equal(moved, expected);
+        assert(copy.empty() && copy.begin() == copy.end());
+
+        map.clear();
+        assert(map.empty() && map.begin() == map.end() && !map.contains(0));
+        map = moved;
+        check_equal(map, expected);
+    }
+    assert(live == 0);
+    assert(allocated == 0);
+}
+
+// every key hashes the same: one probe sequence, so erase has to leave tombstones and lookups have to step past them
+struct constant_hash {
+    std::size_t operator()(long) const noexcept { return 42; }
+};
+
+static void single_probe_sequence() {
+    my::flat_hash_map<long, long, constant_hash> map;
+    for (long i = 0; i != 200; ++i) {
+        assert(map.insert({i, i}).second);
+    }
+    for (long i = 0; i < 200; i += 2) {
+        assert(map.erase(i) == 1);
+    }
+    for (long i = 0; i != 200; ++i) {
+        assert(map.contains(i) == (i % 2 == 1));
+    }
+    for (long i = 0; i < 200; i += 2) {
+        assert(map.insert({i, -i}).second); // the tombstones are reused
+    }
+    assert(map.size() == 200);
+    for (long i = 0; i != 200; ++i) {
+        assert(map.at(i) == (i % 2 ? i : -i));
+    }
+}
+
+struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>()(s); }
+};
+
+struct string_eq {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const noexcept { return a == b; }
+};
+
+static void heterogeneous_lookup() {
+    my::flat_hash_map<std::string, int, string_hash, string_eq> map;
+    map["one"] = 1;
+    map["two"] = 2;
+    map.insert_or_assign("two", 22);
+    std::string_view key = "two";
+    assert(map.find(key) != map.end() && map.find(key)->second == 22);
+    assert(map.contains("one"));
+    assert(!map.contains(std::string_view("three")));
+    assert(map.erase(std::string_view("one")) == 1);
+    assert(map.size() == 1);
+
+    bool thrown = false;
+    try {
+        (void)map.at(std::string_view("one"));
+    }
+    catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+static void set() {
+    my::flat_hash_set<int> s = {3, 1, 4, 1, 5, 9, 2, 6};
+    std::unordered_set<int> expected = {3, 1, 4, 1, 5, 9, 2, 6};
+    assert(s.size() == expected.size());
+    for (int v : s) assert(expected.contains(v));
+    s.erase(4);
+    assert(!s.contains(4) && s.size() == expected.size() - 1);
+    s.reserve(1000);
+    assert(s.capacity() >= 1000 && s.size() == expected.size() - 1);
+}
+
+struct throws_on_copy {
+    static inline int copies_left = 0;
+    long value;
+
+    explicit throws_on_copy(long value) : value(value) { ++live; }
+    throws_on_copy(const throws_on_copy& other) : value(other.value) {
+        if (copies_left-- == 0) throw std::runtime_error("copy");
+        ++live;
+    }
+    throws_on_copy(throws_on_copy&& other) noexcept : value(other.value) { ++live; }
+    ~throws_on_copy() { --live; }
+};
+
+static void copy_throws() {
+    {
+        my::flat_hash_map<long, throws_on_copy, std::hash<long>, std::equal_to<long>, counting_alloc<std::pair<const long, throws_on_copy>>> map;
+        for (long i = 0; i != 100; ++i) map.try_emplace(i, i);
+        throws_on_copy::copies_left = 50;
+        bool thrown = false;
+        try {
+            auto copy = map;
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(live == 100); // the half-built copy destroyed what it had made
+        assert(map.size() == 100 && map.at(99).value == 99);
+    }
+    assert(live == 0);
+    assert(allocated == 0);
+}
+
+int main() {
+    random_against_std(200000, 5000);
+    random_against_std(200000, 50);
+    single_probe_sequence();
+    heterogeneous_lookup();
+    set();
+    copy_throws();
+    std::printf("flat_hash_map_test: all checks passed\n");
+    return 0;
+}
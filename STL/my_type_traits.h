@@ -1,62 +1,47 @@
-#include <iostream>
+#pragma once
+#include <type_traits>
+#include <utility>
 
 namespace my {
 
+    // All the detectors are requires-expressions: the compiler checks the expression in place instead of
+    // instantiating a helper class with a pair of overloads for every T, which is noticeably cheaper
+    // in translation units with lots of container instantiations.
+
     template<typename T, typename... Args>
     class is_constructible {
-        template<typename TT, typename... AArgs, typename = decltype(TT(std::declval<AArgs>()...))>
-        static std::true_type f(int);
-        
-        template<typename...>
-        static std::false_type f(...);
     public:
-        static const int value = decltype(f<T,Args...>(0))::value;
+        static constexpr bool value = requires { T(std::declval<Args>()...); };
     };
 
     template<typename T, typename... Args>
     constexpr bool is_constructible_v = is_constructible<T,Args...>::value;
-    
+
 
     template<typename T>
     class is_default_constructible {
-        template<typename TT, typename = decltype(TT())>
-        static std::true_type f(int);
-
-        template<typename...>
-        static std::false_type f(...);
     public:
-        static constexpr bool value = decltype(f<T>(0))::value;
+        static constexpr bool value = requires { T(); };
     };
 
     template<typename T>
     constexpr bool is_default_constructible_v = is_default_constructible<T>::value;
 
-    
+
     template<typename T>
     class is_copy_constructible {
-        template<typename TT, typename = decltype(TT(std::declval<TT&>()))>
-        static std::true_type f(int);
-
-        template<typename...>
-        static std::false_type f(...);
-
     public:
-        static constexpr bool value = decltype(f<T>(0))::value;
+        static constexpr bool value = requires { T(std::declval<T&>()); };
     };
-    
+
     template<typename T>
     constexpr bool is_copy_constructible_v = is_copy_constructible<T>::value;
-    
+
 
     template<typename T>
     class is_move_constructible {
-        template<typename TT, typename = decltype(TT(std::declval<std::remove_reference_t<TT>>()))>
-        static std::true_type f(int);
-
-        template<typename...>
-        static std::false_type f(...);
     public:
-        static constexpr bool value = decltype(f<T>(0))::value; // there're no class examples in compile-time, hence there's no f() function (if it's non-static)
+        static constexpr bool value = requires { T(std::declval<std::remove_reference_t<T>>()); };
     };
 
     template<typename T>
@@ -65,14 +50,8 @@ namespace my {
 
     template<typename T>
     class is_copy_assignable {
-        template<typename TT, typename = decltype(std::declval<TT&>() = std::declval<TT&>())> // lhs has type TT& and not TT as the second option can be treated as rvalue(TEST!)Example: int() is rvalue and has type int
-        static std::true_type f(int); // static for 2 reasons - the sense, we use it in the expression by which we initialize a static constexpr class field
-
-        template<typename...>
-        static std::false_type f(...);
-
     public:
-        static constexpr bool value = decltype(f<T>(0))::value; // static at least for 3 reasons - the sense, must be initialized in compile-time, convinient 
+        static constexpr bool value = requires { std::declval<T&>() = std::declval<T&>(); }; // lhs has type T& and not T as the second option can be treated as rvalue. Example: int() is rvalue and has type int
     };
 
     template<typename T>
@@ -81,14 +60,8 @@ namespace my {
 
     template<typename T>
     class is_move_assignable {
-        template<typename TT, typename = decltype(std::declval<TT&>() = std::declval<std::remove_reference_t<TT>&&>)>
-        static std::true_type f(int);
-        
-        template<typename...>
-        static std::false_type f(...);
-
     public:
-        static constexpr bool value = decltype(f<T>(0))::value;
+        static constexpr bool value = requires { std::declval<T&>() = std::declval<std::remove_reference_t<T>&&>(); };
     };
 
     template<typename T>
@@ -97,31 +70,27 @@ namespace my {
 
     template<typename T, typename... Args>
     class is_nothrow_constructible {
-        template<typename TT, typename... AArgs, typename = std::enable_if<noexcept(TT(std::declval<AArgs>()...))>>
-        static std::true_type f(int);
-
-        template<typename...>
-        static std::false_type f(...);
-
     public:
-        static constexpr bool value = decltype(f<T, Args...>(0))::value;
+        static constexpr bool value = requires { { T(std::declval<Args>()...) } noexcept; }; // false both for throwing and for ill-formed constructions
     };
 
-    template<typename T>
-    constexpr bool is_nothrow_constructible_v = is_nothrow_constructible<T>::value;
-    
-};
-
-
-
-
-
-
-
-
-
+    template<typename T, typename... Args>
+    constexpr bool is_nothrow_constructible_v = is_nothrow_constructible<T, Args...>::value;
 
 
+    // Op<Args...> if it's well-formed, Default otherwise
+    template<typename Default, template<typename...> typename Op, typename... Args>
+    struct detected_or {
+        using type = Default;
+    };
 
+    template<typename Default, template<typename...> typename Op, typename... Args>
+        requires requires { typename Op<Args...>; }
+    struct detected_or<Default, Op, Args...> {
+        using type = Op<Args...>;
+    };
 
+    template<typename Default, template<typename...> typename Op, typename... Args>
+    using detected_or_t = typename detected_or<Default, Op, Args...>::type;
 
+};
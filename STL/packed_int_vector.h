@@ -0,0 +1,340 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MY_PACKED_INT_SSE2 1
+#endif
+#include "current_vector.h"
+
+namespace my {
+
+    // Unsigned 64-bit integers stored in 'width' bits each, for columns whose values are much smaller than their type.
+    //
+    // The bits are laid out in blocks of 256 values split over 4 lanes: value r of a block is field r / 4 of lane r % 4,
+    // and the lanes' words are interleaved (word k of lane j is block[4k + j]). So 4 neighbouring values sit at the same bit offset
+    // in 4 neighbouring words, and unpacking is the same shift for all of them: one SSE2 shift handles 2 values,
+    // and they come out already in order. A block is always 4 * width words, value i is found with a multiply and a shift.
+    // After the last block come a few zero words, so a read can always load the word following the value's one without a branch.
+
+    namespace packed_int_detail {
+
+        inline constexpr std::size_t lanes = 4;
+        inline constexpr std::size_t block_size = 256; // 64 fields per lane: exactly 'width' words per lane
+        inline constexpr std::size_t padding = 2 * lanes;
+
+        constexpr std::uint64_t low_mask(unsigned w) noexcept {
+            return w == 0 ? 0 : ~std::uint64_t(0) >> (64 - w);
+        }
+
+        constexpr std::size_t block_words(unsigned w) noexcept {
+            return lanes * w;
+        }
+
+        inline unsigned bit_width(std::uint64_t v) noexcept {
+            return static_cast<unsigned>(std::bit_width(v));
+        }
+
+        // value r of the block at 'block'
+        inline std::uint64_t read(const std::uint64_t* block, unsigned w, std::size_t r) noexcept {
+            std::size_t bit = (r / lanes) * w;
+            const std::uint64_t* p = block + (bit / 64) * lanes + r % lanes;
+            unsigned off = static_cast<unsigned>(bit % 64);
+            return ((p[0] >> off) | ((p[lanes] << 1) << (63 - off))) & low_mask(w);
+        }
+
+        // v has to fit in w bits
+        inline void write(std::uint64_t* block, unsigned w, std::size_t r, std::uint64_t v) noexcept {
+            std::size_t bit = (r / lanes) * w;
+            std::uint64_t* p = block + (bit / 64) * lanes + r % lanes;
+            unsigned off = static_cast<unsigned>(bit % 64);
+            std::uint64_t m = low_mask(w);
+            p[0] = (p[0] & ~(m << off)) | (v << off);
+            if (off + w > 64) {
+                p[lanes] = (p[lanes] & ~(m >> (64 - off))) | (v >> (64 - off));
+            }
+        }
+
+        // rows [first_row, last_row) of a block (values [4 * first_row, 4 * last_row)) to out
+        inline void unpack_rows(const std::uint64_t* block, unsigned w, std::size_t first_row, std::size_t last_row, std::uint64_t* out) noexcept {
+            std::uint64_t m = low_mask(w);
+#ifdef MY_PACKED_INT_SSE2
+            __m128i mask = _mm_set1_epi64x(static_cast<long long>(m));
+            for (std::size_t k = first_row; k != last_row; ++k) {
+                std::size_t bit = k * w;
+                const std::uint64_t* p = block + (bit / 64) * lanes;
+                __m128i lo_shift = _mm_cvtsi32_si128(static_cast<int>(bit % 64));
+                __m128i hi_shift = _mm_cvtsi32_si128(static_cast<int>(64 - bit % 64)); // a shift by 64 gives 0 in SSE2
+                for (std::size_t j = 0; j != lanes; j += 2) {
+                    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + j));
+                    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + lanes + j));
+                    __m128i v = _mm_or_si128(_mm_srl_epi64(lo, lo_shift), _mm_sll_epi64(hi, hi_shift));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + (k - first_row) * lanes + j), _mm_and_si128(v, mask));
+                }
+            }
+#else
+            for (std::size_t k = first_row; k != last_row; ++k) {
+                std::size_t bit = k * w;
+                const std::uint64_t* p = block + (bit / 64) * lanes;
+                unsigned off = static_cast<unsigned>(bit % 64);
+                for (std::size_t j = 0; j != lanes; ++j) {
+                    out[(k - first_row) * lanes + j] = ((p[j] >> off) | ((p[lanes + j] << 1) << (63 - off))) & m;
+                }
+            }
+#endif
+        }
+
+        // all 256 values of a block to out[0..256)
+        inline void unpack_block(const std::uint64_t* block, unsigned w, std::uint64_t* out) noexcept {
+            unpack_rows(block, w, 0, block_size / lanes, out);
+        }
+
+        // vector::resize allocates exactly what it's asked for, appending a block at a time has to grow geometrically itself
+        inline void grow(my::vector<std::uint64_t>& words, std::size_t new_sz) {
+            if (new_sz > words.capacity()) {
+                words.reserve(std::max(new_sz, 2 * words.capacity()));
+            }
+            words.resize(new_sz);
+        }
+
+        // values[0..n) into a zeroed block, n <= block_size
+        inline void pack_block(const std::uint64_t* values, std::size_t n, unsigned w, std::uint64_t* block) noexcept {
+            for (std::size_t r = 0; r != n; ++r) {
+                write(block, w, r, values[r]);
+            }
+        }
+
+    }
+
+
+    inline constexpr unsigned dynamic_bit_width = std::numeric_limits<unsigned>::max();
+
+    // Bits fixed at compile time (values that don't fit are an error), or dynamic_bit_width: chosen at run time,
+    // and widened (the whole vector repacked) when a value that doesn't fit is stored
+    template<unsigned Bits = dynamic_bit_width>
+    class packed_int_vector {
+        static_assert(Bits == dynamic_bit_width || Bits <= 64, "packed_int_vector: at most 64 bits per value");
+
+        static constexpr bool is_dynamic = Bits == dynamic_bit_width;
+
+        my::vector<std::uint64_t> words; // the blocks, then the padding; empty until the first value
+        std::size_t sz = 0;
+        unsigned w = is_dynamic ? 0 : Bits;
+
+        // a constant for a fixed width, so that the shifts in read/write/unpack_block are folded
+        unsigned width() const noexcept {
+            if constexpr (is_dynamic) return w;
+            else return Bits;
+        }
+
+        const std::uint64_t* block(std::size_t b) const noexcept { return words.data() + b * packed_int_detail::block_words(width()); }
+        std::uint64_t* block(std::size_t b) noexcept { return words.data() + b * packed_int_detail::block_words(width()); }
+
+        // makes sure v fits, widening or throwing
+        void fit(std::uint64_t v);
+        void repack(unsigned new_w);
+
+    public:
+        packed_int_vector() noexcept = default;
+
+        explicit packed_int_vector(unsigned bits) requires (is_dynamic);
+
+        // dynamic: the width of the largest value
+        explicit packed_int_vector(const my::vector<std::uint64_t>& values);
+        packed_int_vector(std::initializer_list<std::uint64_t> init_l);
+
+        std::size_t size() const noexcept;
+        bool empty() const noexcept;
+        unsigned bit_width() const noexcept;
+
+        // values, not references: use set() to change one
+        std::uint64_t operator[](std::size_t index) const noexcept;
+        std::uint64_t at(std::size_t index) const;
+
+        void set(std::size_t index, std::uint64_t value);
+        void push_back(std::uint64_t value);
+        void pop_back() noexcept;
+
+        void reserve(std::size_t new_cap);
+        void clear() noexcept;
+
+        // values [first, first + count) to out, whole blocks with unpack_block
+        void decode(std::size_t first, std::size_t count, std::uint64_t* out) const;
+        // all of them, out is resized to size()
+        void decode(my::vector<std::uint64_t>& out) const;
+        my::vector<std::uint64_t> to_vector() const;
+
+        // heap bytes holding the values, and how many times less that is than a my::vector<std::uint64_t> of them
+        std::size_t memory_bytes() const noexcept;
+        double compression_ratio() const noexcept;
+    };
+
+
+
+    template<unsigned Bits>
+    packed_int_vector<Bits>::packed_int_vector(unsigned bits) requires (is_dynamic) : w(bits) {
+        if (bits > 64) {
+            throw std::invalid_argument("packed_int_vector: at most 64 bits per value!");
+        }
+    }
+
+    template<unsigned Bits>
+    packed_int_vector<Bits>::packed_int_vector(const my::vector<std::uint64_t>& values) {
+        std::uint64_t all = 0;
+        for (std::size_t i = 0; i != values.size(); ++i) all |= values[i];
+        fit(all); // the same width as the largest value
+        reserve(values.size());
+        for (std::size_t i = 0; i != values.size(); ++i) push_back(values[i]);
+    }
+
+    template<unsigned Bits>
+    packed_int_vector<Bits>::packed_int_vector(std::initializer_list<std::uint64_t> init_l) {
+        std::uint64_t all = 0;
+        for (std::uint64_t v : init_l) all |= v;
+        fit(all);
+        reserve(init_l.size());
+        for (std::uint64_t v : init_l) push_back(v);
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::fit(std::uint64_t v) {
+        unsigned needed = packed_int_detail::bit_width(v);
+        if (needed <= width()) return;
+        if constexpr (is_dynamic) {
+            repack(needed);
+        }
+        else {
+            throw std::out_of_range("packed_int_vector: value wider than the fixed bit width!");
+        }
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::repack(unsigned new_w) {
+        using namespace packed_int_detail;
+        std::size_t blocks = (sz + block_size - 1) / block_size;
+        my::vector<std::uint64_t> new_words;
+        if (sz != 0) {
+            new_words.resize(blocks * block_words(new_w) + padding);
+        }
+        std::uint64_t buffer[block_size];
+        for (std::size_t b = 0; b != blocks; ++b) {
+            unpack_block(block(b), width(), buffer);
+            pack_block(buffer, block_size, new_w, new_words.data() + b * block_words(new_w));
+        }
+        words.swap(new_words);
+        w = new_w;
+    }
+
+    template<unsigned Bits>
+    std::size_t packed_int_vector<Bits>::size() const noexcept {
+        return sz;
+    }
+
+    template<unsigned Bits>
+    bool packed_int_vector<Bits>::empty() const noexcept {
+        return sz == 0;
+    }
+
+    template<unsigned Bits>
+    unsigned packed_int_vector<Bits>::bit_width() const noexcept {
+        return width();
+    }
+
+    template<unsigned Bits>
+    std::uint64_t packed_int_vector<Bits>::operator[](std::size_t index) const noexcept {
+        using namespace packed_int_detail;
+        return read(block(index / block_size), width(), index % block_size);
+    }
+
+    template<unsigned Bits>
+    std::uint64_t packed_int_vector<Bits>::at(std::size_t index) const {
+        if (index >= sz) {
+            throw std::out_of_range("packed_int_vector::at: index out of range!");
+        }
+        return (*this)[index];
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::set(std::size_t index, std::uint64_t value) {
+        using namespace packed_int_detail;
+        fit(value);
+        write(block(index / block_size), width(), index % block_size, value);
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::push_back(std::uint64_t value) {
+        using namespace packed_int_detail;
+        fit(value);
+        std::size_t needed = (sz / block_size + 1) * block_words(width()) + padding;
+        if (words.size() < needed) {
+            grow(words, needed); // a new zeroed block, the old padding becomes its beginning
+        }
+        write(block(sz / block_size), width(), sz % block_size, value);
+        ++sz;
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::pop_back() noexcept {
+        using namespace packed_int_detail;
+        --sz; // the block stays allocated, push_back overwrites the field
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::reserve(std::size_t new_cap) {
+        using namespace packed_int_detail;
+        words.reserve((new_cap + block_size - 1) / block_size * block_words(width()) + padding);
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::clear() noexcept {
+        words.clear();
+        sz = 0;
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::decode(std::size_t first, std::size_t count, std::uint64_t* out) const {
+        using namespace packed_int_detail;
+        if (first + count > sz) {
+            throw std::out_of_range("packed_int_vector::decode: range out of range!");
+        }
+        std::size_t i = first, last = first + count;
+        for (; i != last && i % block_size != 0; ++i) {
+            *out++ = (*this)[i];
+        }
+        for (; last - i >= block_size; i += block_size, out += block_size) {
+            unpack_block(block(i / block_size), width(), out);
+        }
+        for (; i != last; ++i) {
+            *out++ = (*this)[i];
+        }
+    }
+
+    template<unsigned Bits>
+    void packed_int_vector<Bits>::decode(my::vector<std::uint64_t>& out) const {
+        out.resize(sz);
+        decode(0, sz, out.data());
+    }
+
+    template<unsigned Bits>
+    my::vector<std::uint64_t> packed_int_vector<Bits>::to_vector() const {
+        my::vector<std::uint64_t> out;
+        decode(out);
+        return out;
+    }
+
+    template<unsigned Bits>
+    std::size_t packed_int_vector<Bits>::memory_bytes() const noexcept {
+        return words.size() * sizeof(std::uint64_t);
+    }
+
+    template<unsigned Bits>
+    double packed_int_vector<Bits>::compression_ratio() const noexcept {
+        return words.empty() ? 1.0 : double(sz * sizeof(std::uint64_t)) / double(memory_bytes());
+    }
+
+};
@@ -0,0 +1,567 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "uninitialized.h"
+#include "smart_pointers/intrusive_ptr.h"
+
+namespace my {
+
+    // Immutable vector with structural sharing (the Clojure/Scala design, Bagwell & Rompf's radix-balanced tree without the relaxed nodes):
+    // the elements sit in leaves of 32, under a tree of 32-way inner nodes, so a tree of 4 levels holds a million elements.
+    //
+    //  - push_back/set/pop_back return a new version and leave this one alone: they copy the path from the root
+    //    down to the leaf they change (log32(n) nodes of 32 slots) and share every other node with the old version
+    //  - the last leaf is kept aside as the tail, so push_back only copies the tail (<= 32 elements) and touches the tree once per 32 pushes
+    //  - nodes are my::ref_counted (an atomic count inside the node, no control block), versions may be read by any number of threads
+    //  - a transient_vector is a mutable draft: nodes it has copied once are marked as its own and changed in place from then on,
+    //    so building a vector element by element costs amortised O(1) instead of a path copy per push. persistent() freezes it
+    //  - iteration goes leaf by leaf: one tree walk per 32 elements, then a plain array; for_each_chunk() hands out the arrays themselves
+
+    template<typename T>
+    class persistent_vector;
+
+    template<typename T>
+    class transient_vector;
+
+    namespace persistent_vector_detail {
+
+        inline constexpr unsigned bits = 5;
+        inline constexpr std::size_t width = std::size_t(1) << bits;
+        inline constexpr std::size_t mask = width - 1;
+
+        // 0 is "nobody": nodes of persistent versions, never changed in place
+        inline std::uint64_t new_owner() noexcept {
+            static std::atomic<std::uint64_t> next{1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template<typename T>
+        struct node;
+
+        template<typename T>
+        struct node_delete {
+            void operator()(node<T>* n) const noexcept;
+        };
+
+        template<typename T>
+        struct node : my::ref_counted<node<T>, my::atomic_policy, node_delete<T>> {
+            std::uint64_t owner;
+            bool is_leaf;
+
+            node(std::uint64_t owner, bool is_leaf) noexcept : owner(owner), is_leaf(is_leaf) {}
+        };
+
+        template<typename T>
+        struct inner : node<T> {
+            my::intrusive_ptr<node<T>> child[width];
+
+            explicit inner(std::uint64_t owner) noexcept : node<T>(owner, false) {}
+
+            inner(const inner& other, std::uint64_t owner) noexcept : node<T>(owner, false) {
+                for (std::size_t i = 0; i != width; ++i) child[i] = other.child[i];
+            }
+        };
+
+        template<typename T>
+        struct leaf : node<T> {
+            std::size_t count = 0;
+            alignas(T) unsigned char storage[width * sizeof(T)];
+
+            explicit leaf(std::uint64_t owner) noexcept : node<T>(owner, true) {}
+
+            // one bulk copy: memcpy for trivially copyable T
+            leaf(const leaf& other, std::uint64_t owner) : node<T>(owner, true) {
+                std::allocator<T> alloc;
+                my::uninitialized_copy(alloc, other.data(), other.data() + other.count, data());
+                count = other.count;
+            }
+
+            ~leaf() {
+                std::allocator<T> alloc;
+                my::destroy_n(alloc, data(), count);
+            }
+
+            T* data() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+            const T* data() const noexcept { return std::launder(reinterpret_cast<const T*>(storage)); }
+
+            template<typename... Args>
+            void emplace(Args&&... args) {
+                ::new(static_cast<void*>(data() + count)) T(std::forward<Args>(args)...);
+                ++count;
+            }
+
+            void pop() noexcept {
+                --count;
+                std::destroy_at(data() + count);
+            }
+        };
+
+        template<typename T>
+        void node_delete<T>::operator()(node<T>* n) const noexcept {
+            if (n->is_leaf) delete static_cast<leaf<T>*>(n);
+            else delete static_cast<inner<T>*>(n);
+        }
+
+
+        // the state both persistent_vector and transient_vector wrap; 'owner' is 0 for persistent updates
+        template<typename T>
+        struct trie {
+            using node_ptr = my::intrusive_ptr<node<T>>;
+
+            std::size_t cnt = 0;
+            unsigned shift = bits;  // level of the root's children: leaves are at level 0
+            node_ptr root;          // an inner node, null while everything fits in the tail
+            node_ptr tail;          // a leaf with elements [tail_offset(), cnt)
+
+            std::size_t tail_offset() const noexcept {
+                return cnt < width ? 0 : ((cnt - 1) >> bits) << bits;
+            }
+
+            static const inner<T>* as_inner(const node_ptr& n) noexcept { return static_cast<const inner<T>*>(n.get()); }
+            static inner<T>* as_inner(node_ptr& n) noexcept { return static_cast<inner<T>*>(n.get()); }
+            static const leaf<T>* as_leaf(const node_ptr& n) noexcept { return static_cast<const leaf<T>*>(n.get()); }
+            static leaf<T>* as_leaf(node_ptr& n) noexcept { return static_cast<leaf<T>*>(n.get()); }
+
+            // the leaf holding element i (i < cnt)
+            const leaf<T>* leaf_for(std::size_t i) const noexcept {
+                if (i >= tail_offset()) return as_leaf(tail);
+                const node<T>* n = root.get();
+                for (unsigned level = shift; level > 0; level -= bits) {
+                    n = static_cast<const inner<T>*>(n)->child[(i >> level) & mask].get();
+                }
+                return static_cast<const leaf<T>*>(n);
+            }
+
+            // n itself if 'owner' may change it in place, a copy stamped with 'owner' otherwise
+            static node_ptr editable_inner(const node_ptr& n, std::uint64_t owner) {
+                if (!n) return node_ptr(new inner<T>(owner));
+                if (owner != 0 && n->owner == owner) return n;
+                return node_ptr(new inner<T>(*as_inner(n), owner));
+            }
+
+            static node_ptr editable_leaf(const node_ptr& n, std::uint64_t owner) {
+                if (!n) return node_ptr(new leaf<T>(owner));
+                if (owner != 0 && n->owner == owner) return n;
+                return node_ptr(new leaf<T>(*as_leaf(n), owner));
+            }
+
+            // the same, but in place: no reference count traffic when the node is already ours
+            static leaf<T>* make_editable_leaf(node_ptr& slot, std::uint64_t owner) {
+                if (!slot || owner == 0 || slot->owner != owner) slot = editable_leaf(slot, owner);
+                return as_leaf(slot);
+            }
+
+            static node_ptr new_path(unsigned level, node_ptr n, std::uint64_t owner) {
+                if (level == 0) return n;
+                node_ptr result(new inner<T>(owner));
+                as_inner(result)->child[0] = new_path(level - bits, std::move(n), owner);
+                return result;
+            }
+
+            // hangs the full tail under the tree, as the leaf for elements [cnt - width, cnt)
+            node_ptr push_tail(unsigned level, const node_ptr& parent, node_ptr tail_node, std::uint64_t owner) {
+                std::size_t subidx = ((cnt - 1) >> level) & mask;
+                node_ptr result = editable_inner(parent, owner);
+                node_ptr& slot = as_inner(result)->child[subidx];
+                if (level == bits) {
+                    slot = std::move(tail_node);
+                }
+                else if (slot) {
+                    slot = push_tail(level - bits, slot, std::move(tail_node), owner);
+                }
+                else {
+                    slot = new_path(level - bits, std::move(tail_node), owner);
+                }
+                return result;
+            }
+
+            // drops the leaf of elements [cnt - 1 - width, cnt - 1) from the tree, null if the subtree became empty
+            node_ptr pop_tail(unsigned level, const node_ptr& n, std::uint64_t owner) {
+                std::size_t subidx = ((cnt - 2) >> level) & mask;
+                if (level > bits) {
+                    node_ptr new_child = pop_tail(level - bits, as_inner(n)->child[subidx], owner);
+                    if (!new_child && subidx == 0) return node_ptr();
+                    node_ptr result = editable_inner(n, owner);
+                    as_inner(result)->child[subidx] = std::move(new_child);
+                    return result;
+                }
+                if (subidx == 0) return node_ptr();
+                node_ptr result = editable_inner(n, owner);
+                as_inner(result)->child[subidx].reset();
+                return result;
+            }
+
+            node_ptr do_set(unsigned level, const node_ptr& n, std::size_t i, T&& value, std::uint64_t owner) {
+                if (level == 0) {
+                    node_ptr result = editable_leaf(n, owner);
+                    as_leaf(result)->data()[i & mask] = std::move(value);
+                    return result;
+                }
+                node_ptr result = editable_inner(n, owner);
+                node_ptr& slot = as_inner(result)->child[(i >> level) & mask];
+                slot = do_set(level - bits, slot, i, std::move(value), owner);
+                return result;
+            }
+
+            template<typename... Args>
+            void emplace_back(std::uint64_t owner, Args&&... args) {
+                if (cnt - tail_offset() < width) {
+                    if (owner != 0) {
+                        make_editable_leaf(tail, owner)->emplace(std::forward<Args>(args)...);
+                    }
+                    else {
+                        node_ptr new_tail = editable_leaf(tail, owner); // a persistent push has to leave 'tail' intact if emplace throws
+                        as_leaf(new_tail)->emplace(std::forward<Args>(args)...);
+                        tail = std::move(new_tail);
+                    }
+                    ++cnt;
+                    return;
+                }
+
+                // the tail is full: it goes into the tree and a new one is started
+                node_ptr new_tail(new leaf<T>(owner));
+                as_leaf(new_tail)->emplace(std::forward<Args>(args)...);
+
+                node_ptr new_root;
+                unsigned new_shift = shift;
+                if ((cnt >> bits) > (std::size_t(1) << shift)) {
+                    // the tree is full too: one level more
+                    new_root = node_ptr(new inner<T>(owner));
+                    as_inner(new_root)->child[0] = root;
+                    as_inner(new_root)->child[1] = new_path(shift, tail, owner);
+                    new_shift += bits;
+                }
+                else {
+                    new_root = push_tail(shift, root, tail, owner);
+                }
+
+                root = std::move(new_root);
+                shift = new_shift;
+                tail = std::move(new_tail);
+                ++cnt;
+            }
+
+            void set(std::size_t i, T&& value, std::uint64_t owner) {
+                if (i >= tail_offset()) {
+                    make_editable_leaf(tail, owner)->data()[i & mask] = std::move(value);
+                }
+                else {
+                    root = do_set(shift, root, i, std::move(value), owner);
+                }
+            }
+
+            void pop_back(std::uint64_t owner) {
+                if (cnt == 1) {
+                    *this = trie();
+                    return;
+                }
+                if (cnt - tail_offset() > 1) {
+                    make_editable_leaf(tail, owner)->pop();
+                    --cnt;
+                    return;
+                }
+
+                // the tail had one element: the last leaf of the tree becomes the tail
+                node_ptr new_tail(const_cast<leaf<T>*>(leaf_for(cnt - 2)));
+                node_ptr new_root = pop_tail(shift, root, owner);
+                unsigned new_shift = shift;
+                if (new_root && shift > bits && !as_inner(new_root)->child[1]) {
+                    node_ptr only_child = as_inner(new_root)->child[0];
+                    new_root = std::move(only_child);
+                    new_shift -= bits;
+                }
+                if (!new_root) new_shift = bits;
+
+                root = std::move(new_root);
+                shift = new_shift;
+                tail = std::move(new_tail);
+                --cnt;
+            }
+        };
+
+    };
+
+
+    template<typename T>
+    class persistent_vector {
+
+        friend class transient_vector<T>;
+
+        using trie = persistent_vector_detail::trie<T>;
+        using leaf = persistent_vector_detail::leaf<T>;
+
+        trie t;
+
+        explicit persistent_vector(trie&& t) noexcept : t(std::move(t)) {}
+
+    public:
+        using value_type = T;
+
+        // walks leaf by leaf: a tree lookup at every 32nd element, array indexing in between
+        class const_iterator {
+            const trie* t = nullptr;
+            const T* chunk = nullptr;
+            std::size_t i = 0;
+
+            friend class persistent_vector<T>;
+
+            const_iterator(const trie* t, std::size_t i) noexcept
+                : t(t), chunk(i < t->cnt ? t->leaf_for(i)->data() : nullptr), i(i) {}
+
+        public:
+            using difference_type = std::ptrdiff_t;
+            using value_type = T;
+            using pointer = const T*;
+            using reference = const T&;
+            using iterator_category = std::forward_iterator_tag;
+
+            const_iterator() noexcept = default;
+
+            const T& operator*() const noexcept { return chunk[i & persistent_vector_detail::mask]; }
+            const T* operator->() const noexcept { return chunk + (i & persistent_vector_detail::mask); }
+
+            const_iterator& operator++() noexcept {
+                ++i;
+                if ((i & persistent_vector_detail::mask) == 0 && i < t->cnt) {
+                    chunk = t->leaf_for(i)->data();
+                }
+                return *this;
+            }
+
+            const_iterator operator++(int) noexcept {
+                const_iterator cp = *this;
+                ++*this;
+                return cp;
+            }
+
+            bool operator==(const const_iterator& other) const noexcept { return i == other.i; }
+            bool operator!=(const const_iterator& other) const noexcept { return i != other.i; }
+        };
+
+        using iterator = const_iterator;
+
+        persistent_vector() noexcept = default;
+
+        persistent_vector(std::initializer_list<T> init_l);
+
+        // versions are values: copies share everything
+        persistent_vector(const persistent_vector&) noexcept = default;
+        persistent_vector(persistent_vector&&) noexcept = default;
+        persistent_vector& operator=(const persistent_vector&) noexcept = default;
+        persistent_vector& operator=(persistent_vector&&) noexcept = default;
+
+        std::size_t size() const noexcept;
+        bool empty() const noexcept;
+
+        const T& operator[](std::size_t index) const noexcept;
+        const T& at(std::size_t index) const;
+        const T& front() const noexcept;
+        const T& back() const noexcept;
+
+        // new versions, this one stays as it was
+        [[nodiscard]] persistent_vector push_back(T value) const;
+        [[nodiscard]] persistent_vector set(std::size_t index, T value) const;
+        [[nodiscard]] persistent_vector pop_back() const;
+
+        template<typename F>
+        [[nodiscard]] persistent_vector update(std::size_t index, F&& fn) const;
+
+        [[nodiscard]] transient_vector<T> transient() const;
+
+        const_iterator begin() const noexcept;
+        const_iterator end() const noexcept;
+
+        // fn(const T* data, std::size_t count) once per leaf, in order
+        template<typename F>
+        void for_each_chunk(F&& fn) const;
+    };
+
+
+    // a draft of a persistent_vector: changes nodes in place once it owns them. Not thread-safe, like any other mutable container;
+    // the versions it was made from and the ones it has produced are never changed
+    template<typename T>
+    class transient_vector {
+
+        friend class persistent_vector<T>;
+
+        using trie = persistent_vector_detail::trie<T>;
+
+        trie t;
+        std::uint64_t owner;
+
+        explicit transient_vector(const trie& t) : t(t), owner(persistent_vector_detail::new_owner()) {}
+
+    public:
+        transient_vector() : owner(persistent_vector_detail::new_owner()) {}
+
+        transient_vector(const transient_vector&) = delete;
+        transient_vector& operator=(const transient_vector&) = delete;
+        transient_vector(transient_vector&&) noexcept = default;
+        transient_vector& operator=(transient_vector&&) noexcept = default;
+
+        std::size_t size() const noexcept;
+        const T& operator[](std::size_t index) const noexcept;
+
+        template<typename... Args>
+        void emplace_back(Args&&... args);
+        void push_back(T value);
+        void set(std::size_t index, T value);
+        void pop_back();
+
+        // the current contents as a version; the draft may go on, its next changes copy what they touch first
+        persistent_vector<T> persistent();
+    };
+
+
+
+    template<typename T>
+    persistent_vector<T>::persistent_vector(std::initializer_list<T> init_l) {
+        transient_vector<T> draft;
+        for (const T& value : init_l) draft.push_back(value);
+        *this = draft.persistent();
+    }
+
+    template<typename T>
+    std::size_t persistent_vector<T>::size() const noexcept {
+        return t.cnt;
+    }
+
+    template<typename T>
+    bool persistent_vector<T>::empty() const noexcept {
+        return t.cnt == 0;
+    }
+
+    template<typename T>
+    const T& persistent_vector<T>::operator[](std::size_t index) const noexcept {
+        return t.leaf_for(index)->data()[index & persistent_vector_detail::mask];
+    }
+
+    template<typename T>
+    const T& persistent_vector<T>::at(std::size_t index) const {
+        if (index >= t.cnt) {
+            throw std::out_of_range("persistent_vector::at: index out of range!");
+        }
+        return (*this)[index];
+    }
+
+    template<typename T>
+    const T& persistent_vector<T>::front() const noexcept {
+        return (*this)[0];
+    }
+
+    template<typename T>
+    const T& persistent_vector<T>::back() const noexcept {
+        return (*this)[t.cnt - 1];
+    }
+
+    template<typename T>
+    persistent_vector<T> persistent_vector<T>::push_back(T value) const {
+        trie result = t;
+        result.emplace_back(0, std::move(value));
+        return persistent_vector(std::move(result));
+    }
+
+    template<typename T>
+    persistent_vector<T> persistent_vector<T>::set(std::size_t index, T value) const {
+        if (index >= t.cnt) {
+            throw std::out_of_range("persistent_vector::set: index out of range!");
+        }
+        trie result = t;
+        result.set(index, std::move(value), 0);
+        return persistent_vector(std::move(result));
+    }
+
+    template<typename T>
+    persistent_vector<T> persistent_vector<T>::pop_back() const {
+        if (t.cnt == 0) {
+            throw std::out_of_range("persistent_vector::pop_back: the vector is empty!");
+        }
+        trie result = t;
+        result.pop_back(0);
+        return persistent_vector(std::move(result));
+    }
+
+    template<typename T>
+    template<typename F>
+    persistent_vector<T> persistent_vector<T>::update(std::size_t index, F&& fn) const {
+        T value = at(index);
+        std::forward<F>(fn)(value);
+        return set(index, std::move(value));
+    }
+
+    template<typename T>
+    transient_vector<T> persistent_vector<T>::transient() const {
+        return transient_vector<T>(t);
+    }
+
+    template<typename T>
+    typename persistent_vector<T>::const_iterator persistent_vector<T>::begin() const noexcept {
+        return const_iterator(&t, 0);
+    }
+
+    template<typename T>
+    typename persistent_vector<T>::const_iterator persistent_vector<T>::end() const noexcept {
+        return const_iterator(&t, t.cnt);
+    }
+
+    template<typename T>
+    template<typename F>
+    void persistent_vector<T>::for_each_chunk(F&& fn) const {
+        for (std::size_t i = 0; i < t.cnt; i += persistent_vector_detail::width) {
+            const leaf* l = t.leaf_for(i);
+            fn(l->data(), l->count);
+        }
+    }
+
+
+    template<typename T>
+    std::size_t transient_vector<T>::size() const noexcept {
+        return t.cnt;
+    }
+
+    template<typename T>
+    const T& transient_vector<T>::operator[](std::size_t index) const noexcept {
+        return t.leaf_for(index)->data()[index & persistent_vector_detail::mask];
+    }
+
+    template<typename T>
+    template<typename... Args>
+    void transient_vector<T>::emplace_back(Args&&... args) {
+        t.emplace_back(owner, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void transient_vector<T>::push_back(T value) {
+        t.emplace_back(owner, std::move(value));
+    }
+
+    template<typename T>
+    void transient_vector<T>::set(std::size_t index, T value) {
+        if (index >= t.cnt) {
+            throw std::out_of_range("transient_vector::set: index out of range!");
+        }
+        t.set(index, std::move(value), owner);
+    }
+
+    template<typename T>
+    void transient_vector<T>::pop_back() {
+        if (t.cnt == 0) {
+            throw std::out_of_range("transient_vector::pop_back: the vector is empty!");
+        }
+        t.pop_back(owner);
+    }
+
+    template<typename T>
+    persistent_vector<T> transient_vector<T>::persistent() {
+        owner = persistent_vector_detail::new_owner(); // the nodes we've owned so far belong to the version now
+        return persistent_vector<T>(trie(t));
+    }
+
+};
@@ -0,0 +1,290 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include "alloc_traits.h"
+#include "current_vector.h"
+
+namespace my {
+
+    // Values packed densely in a my::vector, reached through stable handles:
+    //
+    //  - a key is (slot, generation). The slot array maps it to the value's current position in the dense array,
+    //    erase moves the last value into the hole and repoints its slot, so insert/erase/find are O(1) and iteration is a plain array walk
+    //  - a slot's generation is bumped on insert and on erase, odd while the slot is in use: a key whose generation doesn't match
+    //    (the value was erased, maybe replaced by another one in the same slot) is stale, find() returns nullptr for it
+    //  - free slots form a LIFO list threaded through the slots themselves. A slot whose generation would wrap around is retired
+    //    instead of reused, so a stale key can never come back to life
+    //  - erase changes the order of the values: the last one takes the erased one's place. Pointers into the values
+    //    are invalidated by insert (the vector may grow) and erase (the move), keys are not
+
+    struct slot_map_key {
+        std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+        std::uint32_t generation = 0; // even: never handed out, a default-constructed key finds nothing
+
+        bool operator==(const slot_map_key& other) const noexcept = default;
+    };
+
+
+    template<typename T, typename Alloc = std::allocator<T>>
+    class slot_map {
+    public:
+        using key_type = slot_map_key;
+        using value_type = T;
+        using iterator = typename my::vector<T, Alloc>::iterator;
+        using const_iterator = typename my::vector<T, Alloc>::const_iterator;
+
+    private:
+        struct slot {
+            std::uint32_t index;      // in use: position in 'values', free: the next free slot
+            std::uint32_t generation;
+        };
+
+        using slot_alloc = typename my::allocator_traits<Alloc>::template rebind_alloc<slot>;
+        using index_alloc = typename my::allocator_traits<Alloc>::template rebind_alloc<std::uint32_t>;
+
+        static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+        my::vector<T, Alloc> values;
+        my::vector<std::uint32_t, index_alloc> owners; // owners[i]: the slot of values[i], for the fix-up on erase
+        my::vector<slot, slot_alloc> slots;
+        std::uint32_t free_head = npos;
+
+        const slot* find_slot(key_type key) const noexcept;
+
+        void release(std::uint32_t s) noexcept;
+
+    public:
+        slot_map() = default;
+
+        explicit slot_map(const Alloc& alloc);
+
+        template<typename... Args>
+        key_type emplace(Args&&... args);
+        key_type insert(const T& value);
+        key_type insert(T&& value);
+
+        // false if the key is stale
+        bool erase(key_type key);
+
+        bool contains(key_type key) const noexcept;
+
+        // nullptr if the key is stale
+        T* find(key_type key) noexcept;
+        const T* find(key_type key) const noexcept;
+
+        T& at(key_type key);
+        const T& at(key_type key) const;
+
+        // the key of the i-th value in iteration order, e.g. to erase while walking the values
+        key_type key_at(std::size_t i) const noexcept;
+
+        std::size_t size() const noexcept;
+        bool empty() const noexcept;
+        std::size_t capacity() const noexcept;
+
+        void reserve(std::size_t new_cap);
+
+        // every key handed out so far goes stale
+        void clear() noexcept;
+
+        iterator begin() noexcept;
+        iterator end() noexcept;
+        const_iterator begin() const noexcept;
+        const_iterator end() const noexcept;
+        const_iterator cbegin() const noexcept;
+        const_iterator cend() const noexcept;
+
+        T* data() noexcept;
+        const T* data() const noexcept;
+    };
+
+
+
+    template<typename T, typename Alloc>
+    slot_map<T, Alloc>::slot_map(const Alloc& alloc) : values(alloc), owners(index_alloc(alloc)), slots(slot_alloc(alloc)) {}
+
+    template<typename T, typename Alloc>
+    const typename slot_map<T, Alloc>::slot* slot_map<T, Alloc>::find_slot(key_type key) const noexcept {
+        if (key.index >= slots.size()) return nullptr;
+        const slot& s = slots[key.index];
+        return s.generation == key.generation && (key.generation & 1) ? &s : nullptr;
+    }
+
+    template<typename T, typename Alloc>
+    void slot_map<T, Alloc>::release(std::uint32_t s) noexcept {
+        if (++slots[s].generation == 0) return; // all 2^31 generations used up, retire the slot
+        slots[s].index = free_head;
+        free_head = s;
+    }
+
+    template<typename T, typename Alloc>
+    template<typename... Args>
+    typename slot_map<T, Alloc>::key_type slot_map<T, Alloc>::emplace(Args&&... args) {
+        if (free_head == npos) {
+            if (slots.size() == npos) {
+                throw std::length_error("slot_map::emplace: out of slots!");
+            }
+            slots.push_back(slot{npos, 0}); // a free slot: harmless if the constructor below throws
+            free_head = static_cast<std::uint32_t>(slots.size() - 1);
+        }
+
+        values.emplace_back(std::forward<Args>(args)...);
+        try {
+            owners.push_back(free_head);
+        }
+        catch (...) {
+            values.pop_back();
+            throw;
+        }
+
+        std::uint32_t s = free_head;
+        free_head = slots[s].index;
+        slots[s].index = static_cast<std::uint32_t>(values.size() - 1);
+        ++slots[s].generation;
+        return key_type{s, slots[s].generation};
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::key_type slot_map<T, Alloc>::insert(const T& value) {
+        return emplace(value);
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::key_type slot_map<T, Alloc>::insert(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    template<typename T, typename Alloc>
+    bool slot_map<T, Alloc>::erase(key_type key) {
+        if (!find_slot(key)) return false;
+
+        std::uint32_t pos = slots[key.index].index;
+        std::uint32_t last = static_cast<std::uint32_t>(values.size() - 1);
+        if (pos != last) {
+            values[pos] = std::move(values[last]);
+            owners[pos] = owners[last];
+            slots[owners[pos]].index = pos;
+        }
+        values.pop_back();
+        owners.pop_back();
+        release(key.index);
+        return true;
+    }
+
+    template<typename T, typename Alloc>
+    bool slot_map<T, Alloc>::contains(key_type key) const noexcept {
+        return find_slot(key) != nullptr;
+    }
+
+    template<typename T, typename Alloc>
+    T* slot_map<T, Alloc>::find(key_type key) noexcept {
+        const slot* s = find_slot(key);
+        return s ? values.data() + s->index : nullptr;
+    }
+
+    template<typename T, typename Alloc>
+    const T* slot_map<T, Alloc>::find(key_type key) const noexcept {
+        const slot* s = find_slot(key);
+        return s ? values.data() + s->index : nullptr;
+    }
+
+    template<typename T, typename Alloc>
+    T& slot_map<T, Alloc>::at(key_type key) {
+        T* p = find(key);
+        if (!p) {
+            throw std::out_of_range("slot_map::at: stale key!");
+        }
+        return *p;
+    }
+
+    template<typename T, typename Alloc>
+    const T& slot_map<T, Alloc>::at(key_type key) const {
+        const T* p = find(key);
+        if (!p) {
+            throw std::out_of_range("slot_map::at: stale key!");
+        }
+        return *p;
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::key_type slot_map<T, Alloc>::key_at(std::size_t i) const noexcept {
+        std::uint32_t s = owners[i];
+        return key_type{s, slots[s].generation};
+    }
+
+    template<typename T, typename Alloc>
+    std::size_t slot_map<T, Alloc>::size() const noexcept {
+        return values.size();
+    }
+
+    template<typename T, typename Alloc>
+    bool slot_map<T, Alloc>::empty() const noexcept {
+        return values.empty();
+    }
+
+    template<typename T, typename Alloc>
+    std::size_t slot_map<T, Alloc>::capacity() const noexcept {
+        return values.capacity();
+    }
+
+    template<typename T, typename Alloc>
+    void slot_map<T, Alloc>::reserve(std::size_t new_cap) {
+        values.reserve(new_cap);
+        owners.reserve(new_cap);
+        slots.reserve(new_cap);
+    }
+
+    template<typename T, typename Alloc>
+    void slot_map<T, Alloc>::clear() noexcept {
+        for (std::size_t i = values.size(); i != 0; --i) {
+            release(owners[i - 1]);
+        }
+        values.clear();
+        owners.clear();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::iterator slot_map<T, Alloc>::begin() noexcept {
+        return values.begin();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::iterator slot_map<T, Alloc>::end() noexcept {
+        return values.end();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::const_iterator slot_map<T, Alloc>::begin() const noexcept {
+        return values.cbegin();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::const_iterator slot_map<T, Alloc>::end() const noexcept {
+        return values.cend();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::const_iterator slot_map<T, Alloc>::cbegin() const noexcept {
+        return values.cbegin();
+    }
+
+    template<typename T, typename Alloc>
+    typename slot_map<T, Alloc>::const_iterator slot_map<T, Alloc>::cend() const noexcept {
+        return values.cend();
+    }
+
+    template<typename T, typename Alloc>
+    T* slot_map<T, Alloc>::data() noexcept {
+        return values.data();
+    }
+
+    template<typename T, typename Alloc>
+    const T* slot_map<T, Alloc>::data() const noexcept {
+        return values.data();
+    }
+
+};
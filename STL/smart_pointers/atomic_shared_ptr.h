@@ -0,0 +1,225 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "shared_ptr.h"
+
+namespace my {
+
+    // A my::shared_ptr<T> that can be loaded and replaced from several threads at once without a mutex.
+    //
+    // Split reference counting: the value lives in a heap node, and the atomic word packs the node's address
+    // (low 48 bits) with an "external" count of readers that are copying out of it right now (high 16 bits).
+    //  - load() bumps the external count with one fetch_add, copies the shared_ptr and gives its reference back:
+    //    with a CAS on the word if the node is still there, or through the node's "internal" count if it has been replaced.
+    //  - a writer swaps in a new node and moves the external count it took out to the internal one;
+    //    whoever brings the internal count to zero deletes the node.
+    // Nodes are never published twice, so a node address seen in the word can't be reused while a reader holds it (no ABA).
+    // Limits: 48-bit user space addresses (x86-64, AArch64) and at most 65535 loads in flight on the same node at once.
+    template<typename T>
+    class atomic_shared_ptr {
+
+        static_assert(sizeof(void*) == 8, "atomic_shared_ptr packs a counter into the upper bits of a 64-bit pointer");
+
+        struct Node {
+            my::shared_ptr<T> value;
+            std::atomic<std::ptrdiff_t> internal_cnt;
+
+            explicit Node(my::shared_ptr<T>&& value) noexcept : value(std::move(value)), internal_cnt(0) {}
+        };
+
+        static constexpr unsigned cnt_shift = 48u;
+        static constexpr std::uintptr_t one_ref = std::uintptr_t(1) << cnt_shift;
+        static constexpr std::uintptr_t node_mask = one_ref - 1u;
+
+        std::atomic<std::uintptr_t> packed;
+
+
+        static Node* node_of(std::uintptr_t word) noexcept {
+            return reinterpret_cast<Node*>(word & node_mask);
+        }
+
+        static std::ptrdiff_t refs_of(std::uintptr_t word) noexcept {
+            return static_cast<std::ptrdiff_t>(word >> cnt_shift);
+        }
+
+        static std::uintptr_t make_word(my::shared_ptr<T>&& value) {
+            if (!value.cb) return 0u; // empty pointers don't need a node
+            return reinterpret_cast<std::uintptr_t>(new Node(std::move(value)));
+        }
+
+        static bool same(const my::shared_ptr<T>& lhs, const my::shared_ptr<T>& rhs) noexcept {
+            return lhs.ptr == rhs.ptr && lhs.cb == rhs.cb;
+        }
+
+        // gives back a reference taken by acquire_word()
+        void release_ref(Node* node) noexcept;
+
+        // called once by the thread that unlinked the node: 'refs' external references go to the internal count
+        static void retire(Node* node, std::ptrdiff_t refs) noexcept;
+
+        std::uintptr_t acquire_word() noexcept {
+            return packed.fetch_add(one_ref, std::memory_order_acquire) + one_ref;
+        }
+
+    public:
+        static constexpr bool is_always_lock_free = std::atomic<std::uintptr_t>::is_always_lock_free;
+
+        atomic_shared_ptr() noexcept;
+
+        atomic_shared_ptr(my::shared_ptr<T> desired);
+
+        atomic_shared_ptr(const atomic_shared_ptr& other) = delete;
+
+        ~atomic_shared_ptr();
+
+        atomic_shared_ptr& operator=(const atomic_shared_ptr& other) = delete;
+
+        atomic_shared_ptr& operator=(my::shared_ptr<T> desired);
+
+        operator my::shared_ptr<T>() const noexcept;
+
+
+        my::shared_ptr<T> load() const noexcept;
+
+        void store(my::shared_ptr<T> desired);
+
+        my::shared_ptr<T> exchange(my::shared_ptr<T> desired);
+
+        // equal means the same object and the same control block; on failure 'expected' gets the current value
+        bool compare_exchange_strong(my::shared_ptr<T>& expected, my::shared_ptr<T> desired);
+
+        bool compare_exchange_weak(my::shared_ptr<T>& expected, my::shared_ptr<T> desired);
+
+        bool is_lock_free() const noexcept;
+    };
+
+
+    template<typename T>
+    atomic_shared_ptr<T>::atomic_shared_ptr() noexcept : packed(0u) {}
+
+    template<typename T>
+    atomic_shared_ptr<T>::atomic_shared_ptr(my::shared_ptr<T> desired) : packed(make_word(std::move(desired))) {}
+
+    template<typename T>
+    atomic_shared_ptr<T>::~atomic_shared_ptr() {
+        std::uintptr_t word = packed.load(std::memory_order_acquire);
+        retire(node_of(word), refs_of(word)); // nobody may use the object any more, so the count must be zero here
+    }
+
+    template<typename T>
+    atomic_shared_ptr<T>& atomic_shared_ptr<T>::operator=(my::shared_ptr<T> desired) {
+        store(std::move(desired));
+        return *this;
+    }
+
+    template<typename T>
+    atomic_shared_ptr<T>::operator my::shared_ptr<T>() const noexcept {
+        return load();
+    }
+
+
+    template<typename T>
+    void atomic_shared_ptr<T>::release_ref(Node* node) noexcept {
+        std::uintptr_t word = packed.load(std::memory_order_relaxed);
+        while (node_of(word) == node) {
+            // release: our read of node->value happens before the writer that will unlink and delete the node
+            if (packed.compare_exchange_weak(word, word - one_ref, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // the node has been replaced and the writer counted us in, so we settle up through the internal count
+        if (node && node->internal_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    template<typename T>
+    void atomic_shared_ptr<T>::retire(Node* node, std::ptrdiff_t refs) noexcept {
+        // readers that have already settled up left the internal count negative, so it hits zero exactly once
+        if (node && node->internal_cnt.fetch_add(refs, std::memory_order_acq_rel) + refs == 0) {
+            delete node;
+        }
+    }
+
+
+    template<typename T>
+    my::shared_ptr<T> atomic_shared_ptr<T>::load() const noexcept {
+        auto* self = const_cast<atomic_shared_ptr*>(this); // the counters change, the value doesn't
+        std::uintptr_t word = self->acquire_word();
+        Node* node = node_of(word);
+        my::shared_ptr<T> result;
+        if (node) {
+            result = node->value; // a plain relaxed increment of the object's use count, the node can't go away under us
+        }
+        self->release_ref(node);
+        return result;
+    }
+
+    template<typename T>
+    void atomic_shared_ptr<T>::store(my::shared_ptr<T> desired) {
+        exchange(std::move(desired));
+    }
+
+    template<typename T>
+    my::shared_ptr<T> atomic_shared_ptr<T>::exchange(my::shared_ptr<T> desired) {
+        std::uintptr_t new_word = make_word(std::move(desired));
+        std::uintptr_t old_word = packed.exchange(new_word, std::memory_order_acq_rel);
+        Node* old_node = node_of(old_word);
+        my::shared_ptr<T> result;
+        if (old_node) {
+            result = old_node->value; // copy, not move: readers that are still in load() may be reading it
+        }
+        retire(old_node, refs_of(old_word));
+        return result;
+    }
+
+    template<typename T>
+    bool atomic_shared_ptr<T>::compare_exchange_strong(my::shared_ptr<T>& expected, my::shared_ptr<T> desired) {
+        std::uintptr_t new_word = 0u;
+        bool new_word_made = false;
+
+        for (;;) {
+            std::uintptr_t word = acquire_word();
+            Node* node = node_of(word);
+            const my::shared_ptr<T> empty;
+            const my::shared_ptr<T>& current = node ? node->value : empty;
+
+            if (!same(current, expected)) {
+                expected = current;
+                release_ref(node);
+                if (new_word_made) {
+                    delete node_of(new_word); // it was never published
+                }
+                return false;
+            }
+
+            if (!new_word_made) {
+                new_word = make_word(std::move(desired));
+                new_word_made = true;
+            }
+
+            // the word changes whenever somebody else loads, so retry while the node stays the same
+            while (node_of(word) == node) {
+                if (packed.compare_exchange_weak(word, new_word, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    retire(node, refs_of(word) - 1); // all the readers counted in the word, except ourselves
+                    return true;
+                }
+            }
+
+            release_ref(node); // replaced by another writer in the meantime, compare again
+        }
+    }
+
+    template<typename T>
+    bool atomic_shared_ptr<T>::compare_exchange_weak(my::shared_ptr<T>& expected, my::shared_ptr<T> desired) {
+        return compare_exchange_strong(expected, std::move(desired));
+    }
+
+    template<typename T>
+    bool atomic_shared_ptr<T>::is_lock_free() const noexcept {
+        return packed.is_lock_free();
+    }
+
+};
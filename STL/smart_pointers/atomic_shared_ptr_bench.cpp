@@ -0,0 +1,89 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "atomic_shared_ptr.h"
+#include "shared_ptr.h"
+
+// Load throughput of my::atomic_shared_ptr against a my::shared_ptr behind a std::mutex, from 1 to max reader threads,
+// while one writer stores a new table every millisecond. Each reader loads the pointer and reads one entry.
+// Usage: atomic_shared_ptr_bench [milliseconds per point = 200] [max threads = 64], a Release build on a machine with that many cores
+
+struct table {
+    long entries[256];
+
+    explicit table(long version) {
+        for (long& e : entries) e = version;
+    }
+};
+
+class locked_ptr {
+    mutable std::mutex m;
+    my::shared_ptr<table> current;
+
+public:
+    explicit locked_ptr(my::shared_ptr<table> initial) : current(std::move(initial)) {}
+
+    my::shared_ptr<table> load() const {
+        std::lock_guard<std::mutex> lock(m);
+        return current;
+    }
+
+    void store(my::shared_ptr<table> value) {
+        std::lock_guard<std::mutex> lock(m);
+        current.swap(value); // the old table is released after the unlock
+    }
+};
+
+static volatile long sink;
+
+// loads per second, all readers together
+template<typename Ptr>
+static double measure(Ptr& ptr, int readers, int millis) {
+    std::atomic<bool> stop{false};
+    std::atomic<long> total{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t != readers; ++t) {
+        threads.emplace_back([&, t] {
+            long loads = 0;
+            long sum = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sum += ptr.load()->entries[(loads + t) & 255];
+                ++loads;
+            }
+            sink = sum;
+            total += loads;
+        });
+    }
+    std::thread writer([&] {
+        for (long version = 1; !stop.load(std::memory_order_relaxed); ++version) {
+            ptr.store(my::make_shared<table>(version));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+    stop = true;
+    for (std::thread& t : threads) t.join();
+    writer.join();
+    return double(total.load()) * 1000.0 / millis;
+}
+
+int main(int argc, char** argv) {
+    int millis = argc > 1 ? std::atoi(argv[1]) : 200;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : 64;
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    std::printf("%8s %26s %18s\n", "readers", "atomic_shared_ptr Mloads/s", "mutex");
+
+    my::atomic_shared_ptr<table> atomic(my::make_shared<table>(0));
+    locked_ptr locked(my::make_shared<table>(0));
+
+    for (int readers = 1; readers <= max_threads; readers *= 2) {
+        double a = measure(atomic, readers, millis);
+        double l = measure(locked, readers, millis);
+        std::printf("%8d %26.1f %18.1f\n", readers, a / 1e6, l / 1e6);
+    }
+    return 0;
+}
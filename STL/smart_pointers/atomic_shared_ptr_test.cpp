@@ -0,0 +1,135 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "atomic_shared_ptr.h"
+#include "shared_ptr.h"
+
+// Stress test for my::atomic_shared_ptr: readers load and check the object while writers store and exchange new ones,
+// a counter is incremented only through compare_exchange (so a lost update shows up in the total),
+// and every object has to be destroyed exactly once, after the last reader let it go.
+
+static std::atomic<long> live{0};
+static std::atomic<long> created{0};
+
+struct object {
+    long value;
+    long check;                    // always ~value while the object is alive
+    std::atomic<int> destroyed{0};
+
+    explicit object(long value) : value(value), check(~value) {
+        ++live;
+        ++created;
+    }
+
+    ~object() {
+        assert(destroyed.exchange(1) == 0); // exactly once
+        check = 0;
+        --live;
+    }
+
+    bool intact() const {
+        return destroyed.load() == 0 && check == ~value;
+    }
+};
+
+static void single_thread() {
+    {
+        my::atomic_shared_ptr<object> a;
+        assert(a.is_lock_free());
+        assert(!a.load());
+
+        auto first = my::make_shared<object>(1);
+        a.store(first);
+        assert(a.load() == first && first.use_count() == 3); // 'first', the node and the loaded copy
+
+        my::shared_ptr<object> old = a.exchange(my::make_shared<object>(2));
+        assert(old == first);
+        assert(a.load()->value == 2);
+
+        my::shared_ptr<object> expected = first;
+        assert(!a.compare_exchange_strong(expected, my::make_shared<object>(3)));
+        assert(expected && expected->value == 2);
+        assert(a.compare_exchange_strong(expected, my::shared_ptr<object>()));
+        assert(!a.load());
+
+        a = first;
+        assert(my::shared_ptr<object>(a) == first);
+        old.reset();
+        first.reset();
+        assert(live == 2); // 1 in 'a', 2 still in 'expected'
+    }
+    assert(live == 0);
+}
+
+static void readers_and_writers(int readers, int writers, long stores_per_writer) {
+    {
+        my::atomic_shared_ptr<object> current(my::make_shared<object>(0));
+        std::atomic<bool> stop{false};
+        std::atomic<long> loads{0};
+
+        std::vector<std::thread> threads;
+        for (int r = 0; r != readers; ++r) {
+            threads.emplace_back([&] {
+                long n = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    my::shared_ptr<object> p = current.load();
+                    assert(p && p->intact());
+                    ++n;
+                }
+                loads += n;
+            });
+        }
+        std::vector<std::thread> writer_threads;
+        for (int w = 0; w != writers; ++w) {
+            writer_threads.emplace_back([&, w] {
+                for (long i = 0; i != stores_per_writer; ++i) {
+                    long value = w * stores_per_writer + i;
+                    if (i % 2) {
+                        current.store(my::make_shared<object>(value));
+                    }
+                    else {
+                        my::shared_ptr<object> old = current.exchange(my::make_shared<object>(value));
+                        assert(old && old->intact());
+                    }
+                }
+            });
+        }
+        for (std::thread& t : writer_threads) t.join();
+        stop = true;
+        for (std::thread& t : threads) t.join();
+        assert(loads > 0);
+        assert(live == 1); // only the last one stored
+    }
+    assert(live == 0);
+}
+
+static void cas_counter(int threads, long increments) {
+    {
+        my::atomic_shared_ptr<object> counter(my::make_shared<object>(0));
+        std::vector<std::thread> workers;
+        for (int t = 0; t != threads; ++t) {
+            workers.emplace_back([&] {
+                for (long i = 0; i != increments; ++i) {
+                    my::shared_ptr<object> expected = counter.load();
+                    while (!counter.compare_exchange_weak(expected, my::make_shared<object>(expected->value + 1))) {
+                        assert(expected && expected->intact());
+                    }
+                }
+            });
+        }
+        for (std::thread& t : workers) t.join();
+        assert(counter.load()->value == threads * increments);
+    }
+    assert(live == 0);
+}
+
+int main() {
+    single_thread();
+    readers_and_writers(4, 2, 20000);
+    cas_counter(4, 5000);
+    std::printf("atomic_shared_ptr_test: %ld objects, all destroyed once\n", created.load());
+    return 0;
+}
@@ -0,0 +1,314 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace my {
+
+    // Biased reference counting (Choi, Shull, Torrellas, PACT'18) as a counting policy for shared_ptr/weak_ptr/ref_counted.
+    //
+    // A count is "owned" by the thread that created it. The owner changes its part of the count ('biased') with plain
+    // instructions, all the other threads use an atomic 'shared' part. The real count is biased + shared, so shared may
+    // go negative when a reference made by the owner is dropped by somebody else.
+    //  - implicit merge: when the owner's part drops to zero, the owner marks the count as merged and from then on
+    //    the shared part is the whole count, for every thread
+    //  - explicit merge: the non-owner whose decrement makes shared negative can't tell whether the count is dead,
+    //    so it queues the count to the owner thread; the owner merges it at its next merge point: when it creates
+    //    another biased count, when it calls biased_policy::drain() or when it exits. If the merged count is zero,
+    //    the object is released right there, through the hook the control block registered with set_release_hook().
+    //    Until then the object stays alive, so e.g. weak_ptr::lock() may still succeed.
+    //
+    // A count created at zero (ref_counted's) has no owner yet: it starts merged, and the first increment made by a thread
+    // with a record takes the bias. The object is often created by one thread and first referenced by another,
+    // which would otherwise move the shared part 0 -> 1 -> 0 with nobody to merge it.
+    //
+    // The shared word keeps the count in the upper bits and two flags in the lower ones, so that every decision
+    // (dead / queue it / already merged) is made by a single atomic RMW.
+
+    class biased_thread_record;
+
+    // what a thread record keeps in its queue, the counters of all widths derive from it
+    struct biased_pending_node {
+        biased_pending_node* next_pending = nullptr;
+        bool (*merge)(biased_pending_node*) noexcept = nullptr; // returns true if the merged count is zero
+        void (*release_hook)(void*) noexcept = nullptr;
+        void* hook_context = nullptr;
+
+        void release() noexcept {
+            if (release_hook) release_hook(hook_context);
+        }
+    };
+
+
+    class biased_thread_record {
+
+        std::mutex m;
+        bool alive = true;
+        biased_pending_node* pending = nullptr;
+        std::atomic<bool> has_pending{false};
+        biased_thread_record* next_free = nullptr;
+
+        static std::mutex& free_records_mutex() {
+            static std::mutex mtx;
+            return mtx;
+        }
+
+        // records of finished threads are reused and never freed, as counters that outlive their owner still point to them
+        static inline biased_thread_record* free_records = nullptr;
+
+        struct thread_holder {
+            biased_thread_record* record = nullptr;
+
+            ~thread_holder() {
+                if (record) record->retire();
+            }
+        };
+
+        static inline thread_local biased_thread_record* current_record = nullptr; // constant-initialized: a plain TLS load on the fast path
+
+        // merges the list on the owner's behalf and releases the dead counts outside the lock,
+        // as releasing an object may queue more counts to this very record
+        static void merge_all(biased_pending_node* list) noexcept {
+            for (biased_pending_node* node = list; node; ) {
+                biased_pending_node* next = node->next_pending;
+                if (node->merge(node)) {
+                    node->release();
+                }
+                node = next;
+            }
+        }
+
+        void retire() noexcept {
+            biased_pending_node* list;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                alive = false;
+                list = pending;
+                pending = nullptr;
+                has_pending.store(false, std::memory_order_relaxed);
+            }
+            current_record = nullptr; // counts created from now on (by other thread_local destructors) are born merged
+            merge_all(list);
+
+            std::lock_guard<std::mutex> lock(free_records_mutex());
+            next_free = free_records;
+            free_records = this;
+        }
+
+        void adopt() noexcept {
+            {
+                std::lock_guard<std::mutex> lock(m); // orders our use of the record after the merges of the previous owner's orphans
+                alive = true;
+            }
+            current_record = this;
+        }
+
+    public:
+        // the calling thread's record, nullptr while the thread is being torn down or if there's no memory for one:
+        // the counter constructor is noexcept, a count created without a record is simply born merged
+        static biased_thread_record* current() noexcept {
+            static thread_local thread_holder holder; // its destructor is the thread's last merge point
+            if (!current_record && !holder.record) {
+                biased_thread_record* record = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(free_records_mutex());
+                    if (free_records) {
+                        record = free_records;
+                        free_records = record->next_free;
+                    }
+                }
+                if (!record) record = new (std::nothrow) biased_thread_record;
+                if (!record) return nullptr; // tried again on the next count
+                record->adopt();
+                holder.record = record;
+            }
+            return current_record;
+        }
+
+        static biased_thread_record* current_if_any() noexcept {
+            return current_record;
+        }
+
+        // called by a non-owner thread; the owner is gone if it has exited, then its counts are merged right here
+        // (under the lock, so that a thread that reuses the record sees the merged state)
+        void enqueue(biased_pending_node* node) noexcept {
+            bool is_dead = false;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (alive) {
+                    node->next_pending = pending;
+                    pending = node;
+                    has_pending.store(true, std::memory_order_release);
+                    return;
+                }
+                is_dead = node->merge(node);
+            }
+            if (is_dead) node->release();
+        }
+
+        // the owner's merge point
+        void drain() noexcept {
+            if (!has_pending.load(std::memory_order_acquire)) return;
+            biased_pending_node* list;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                list = pending;
+                pending = nullptr;
+                has_pending.store(false, std::memory_order_relaxed);
+            }
+            merge_all(list);
+        }
+    };
+
+
+    template<typename Count>
+    struct basic_biased_policy {
+
+        class counter : private biased_pending_node {
+
+            using SCount = std::make_signed_t<Count>;
+
+            static constexpr SCount merged_flag = 1;
+            static constexpr SCount queued_flag = 2;
+            static constexpr SCount one = 4; // the count itself starts at bit 2
+
+            static SCount count_of(SCount word) noexcept {
+                return word >> 2; // arithmetic shift, the shared part may be negative
+            }
+
+            std::atomic<biased_thread_record*> home; // set once: at construction, or by the first increment of a zero count
+            bool biased_active;                // read and written by the owner thread only
+            Count biased;                      // read and written by the owner thread only
+            std::atomic<SCount> shared;
+
+            bool is_owner() const noexcept {
+                biased_thread_record* h = home.load(std::memory_order_relaxed);
+                return h && h == biased_thread_record::current_if_any() && biased_active;
+            }
+
+            // a merged zero count that is still alive was created at zero and has never been referenced: the calling thread
+            // becomes its owner. The CAS makes sure only one of two racing first increments does
+            bool try_take_bias() noexcept {
+                biased_thread_record* record = biased_thread_record::current();
+                if (!record) return false;
+                SCount expected = merged_flag;
+                if (!shared.compare_exchange_strong(expected, 0, std::memory_order_relaxed)) return false;
+                home.store(record, std::memory_order_relaxed); // before the reference is handed to anybody who may have to queue the count
+                biased_active = true;
+                biased = 1;
+                record->drain();
+                return true;
+            }
+
+            // runs on the owner thread (or on whoever found the owner gone), see biased_thread_record
+            static bool merge_queued(biased_pending_node* node) noexcept {
+                counter* self = static_cast<counter*>(node);
+                SCount now;
+                if (self->biased_active) {
+                    // not merged yet, and queued for sure, so one fetch_add both merges and clears the flag
+                    self->biased_active = false;
+                    SCount delta = static_cast<SCount>(self->biased) * one + merged_flag - queued_flag;
+                    self->biased = 0;
+                    now = self->shared.fetch_add(delta, std::memory_order_acq_rel) + delta;
+                }
+                else {
+                    now = self->shared.fetch_sub(queued_flag, std::memory_order_acq_rel) - queued_flag; // the owner has merged it meanwhile
+                }
+                return count_of(now) == 0;
+            }
+
+        public:
+            explicit counter(Count init) noexcept
+                : home(init != 0 ? biased_thread_record::current() : nullptr),
+                biased_active(home.load(std::memory_order_relaxed) != nullptr),
+                biased(biased_active ? init : 0),
+                shared(biased_active ? 0 : static_cast<SCount>(init) * one + merged_flag)
+            {
+                merge = &merge_queued;
+                if (biased_active) home.load(std::memory_order_relaxed)->drain();
+            }
+
+            counter(const counter&) = delete;
+            counter& operator=(const counter&) = delete;
+
+            // what to call when a queued count turns out to be zero at the owner's merge point
+            void set_release_hook(void (*hook)(void*) noexcept, void* context) noexcept {
+                release_hook = hook;
+                hook_context = context;
+            }
+
+            void increment() noexcept {
+                if (is_owner()) {
+                    ++biased;
+                }
+                else if (shared.load(std::memory_order_relaxed) != merged_flag || !try_take_bias()) {
+                    shared.fetch_add(one, std::memory_order_relaxed);
+                }
+            }
+
+            bool decrement() noexcept {
+                if (is_owner()) {
+                    if (--biased != 0) return false;
+                    // implicit merge: the shared part becomes the whole count
+                    biased_active = false;
+                    SCount old = shared.fetch_or(merged_flag, std::memory_order_acq_rel);
+                    return count_of(old) == 0 && !(old & queued_flag); // a queued count is released by the merge point
+                }
+
+                SCount old = shared.load(std::memory_order_relaxed);
+                for (;;) {
+                    SCount desired = old - one;
+                    bool queue_it = !(old & merged_flag) && !(old & queued_flag) && count_of(desired) < 0;
+                    if (queue_it) desired |= queued_flag; // set together with the decrement: from now on the queue keeps the object alive
+                    if (shared.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        if (queue_it) home.load(std::memory_order_relaxed)->enqueue(this);
+                        return (old & merged_flag) && !(old & queued_flag) && count_of(desired) == 0;
+                    }
+                }
+            }
+
+            // fails only for a merged zero count; a count that isn't merged yet has a reference in the biased part or in the queue
+            bool increment_if_nonzero() noexcept {
+                if (is_owner()) {
+                    ++biased;
+                    return true;
+                }
+                SCount old = shared.load(std::memory_order_relaxed);
+                for (;;) {
+                    if ((old & merged_flag) && !(old & queued_flag) && count_of(old) == 0) return false;
+                    if (shared.compare_exchange_weak(old, old + one, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
+            }
+
+            // exact on the owner thread, a lower bound elsewhere until the count is merged
+            std::size_t load() const noexcept {
+                SCount total = count_of(shared.load(std::memory_order_relaxed));
+                if (is_owner()) total += static_cast<SCount>(biased);
+                return total > 0 ? static_cast<std::size_t>(total) : 0u;
+            }
+
+            // conservative: false whenever the answer would need the other thread's part
+            bool unique() const noexcept {
+                SCount word = shared.load(std::memory_order_acquire);
+                if (word & queued_flag) return false;
+                if (is_owner()) return static_cast<SCount>(biased) + count_of(word) == 1;
+                return (word & merged_flag) && count_of(word) == 1;
+            }
+        };
+
+        // the calling thread's merge point, for threads that own biased counts but rarely create new ones
+        static void drain() noexcept {
+            if (biased_thread_record* record = biased_thread_record::current_if_any()) {
+                record->drain();
+            }
+        }
+    };
+
+
+    using biased_policy = basic_biased_policy<std::size_t>;
+
+};
@@ -0,0 +1,197 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "biased_ref_count_policy.h"
+#include "intrusive_ptr.h"
+#include "shared_ptr.h"
+#include "weak_ptr.h"
+
+// Stress test for my::biased_policy: counts created on one thread and copied/dropped on others,
+// queued merges, owners exiting while their counts are still held, and thread records being reused.
+
+using policy = my::biased_policy;
+
+static std::atomic<long> live{0};
+static std::atomic<long> created{0};
+
+struct object {
+    long id;
+    std::atomic<int> destroyed{0};
+
+    explicit object(long id) : id(id) {
+        ++live;
+        ++created;
+    }
+
+    ~object() {
+        assert(destroyed.exchange(1) == 0); // exactly once
+        --live;
+    }
+};
+
+struct intrusive_object : my::ref_counted<intrusive_object, policy> {
+    intrusive_object() { ++live; }
+    ~intrusive_object() { --live; }
+};
+
+template<typename T>
+class channel {
+    std::mutex m;
+    std::deque<T> q;
+
+public:
+    void push(T value) {
+        std::lock_guard<std::mutex> lock(m);
+        q.push_back(std::move(value));
+    }
+
+    bool pop(T& value) {
+        std::lock_guard<std::mutex> lock(m);
+        if (q.empty()) return false;
+        value = std::move(q.front());
+        q.pop_front();
+        return true;
+    }
+};
+
+using strong = my::shared_ptr<object, policy>;
+using weak = my::weak_ptr<object, policy>;
+
+static void single_thread() {
+    strong p = my::make_shared_with_policy<object, policy>(1);
+    strong q = p;
+    assert(p.use_count() == 2);
+    weak w(p);
+    p.reset();
+    q.reset();
+    assert(w.expired());
+    assert(live == 0);
+}
+
+// the owner's reference is dropped by another thread: the count is queued and merged at the owner's next merge point
+static void queued_merge() {
+    strong p = my::make_shared_with_policy<object, policy>(2);
+    strong q = p;
+    std::thread t([q = std::move(q)]() mutable { q.reset(); });
+    t.join();
+    p.reset();
+    assert(live == 1); // still queued
+    policy::drain();
+    assert(live == 0);
+}
+
+// the owner exits while another thread holds the count: its record merges what it can and is recycled
+static void owner_exits() {
+    strong keep;
+    std::thread t([&keep] { keep = my::make_shared_with_policy<object, policy>(3); });
+    t.join();
+    assert(live == 1);
+    keep.reset();
+    assert(live == 0);
+}
+
+static void intrusive() {
+    my::intrusive_ptr<intrusive_object> a = my::make_intrusive<intrusive_object>();
+    my::intrusive_ptr<intrusive_object> b = a;
+    std::thread t([b = std::move(b)]() mutable { b.reset(); });
+    t.join();
+    a.reset();
+    policy::drain();
+    assert(live == 0);
+}
+
+// the count of a ref_counted object starts at zero: the thread that takes the first reference owns it, not the one that made the object
+static void cross_thread_adoption() {
+    intrusive_object* raw = new intrusive_object;
+    std::thread([raw] {
+        my::intrusive_ptr<intrusive_object> p(raw);
+        my::intrusive_ptr<intrusive_object> q = p;
+    }).join();
+    assert(live == 0);
+
+    my::unique_ptr<intrusive_object> owned(new intrusive_object);
+    std::thread([&owned] {
+        my::intrusive_ptr<intrusive_object> p(std::move(owned));
+    }).join();
+    assert(live == 0);
+
+    // the first reference taken here, the last one dropped by another thread: queued to us, merged at our next merge point
+    my::intrusive_ptr<intrusive_object> mine(new intrusive_object);
+    std::thread([p = mine]() mutable { p.reset(); }).join();
+    mine.reset();
+    policy::drain();
+    assert(live == 0);
+}
+
+// producers create counts and keep some copies, consumers copy, drop and lock them; every round runs on fresh threads,
+// so the records of the previous round's threads are reused while counts queued to them may still be around
+static void stress(int rounds, int per_producer) {
+    for (int round = 0; round != rounds; ++round) {
+        channel<strong> strongs;
+        channel<weak> weaks;
+        std::atomic<int> producers_done{0};
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t != 2; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(round * 10 + t);
+                std::vector<strong> mine;
+                for (int i = 0; i != per_producer; ++i) {
+                    strong p = my::make_shared_with_policy<object, policy>(i);
+                    strongs.push(p);
+                    if (rng() % 3 == 0) weaks.push(weak(p));
+                    if (rng() % 2) mine.push_back(p);
+                    if (mine.size() > 50) mine.erase(mine.begin());
+                }
+                mine.clear();
+                ++producers_done;
+                policy::drain();
+            });
+        }
+        for (int t = 0; t != 2; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(100 + round * 10 + t);
+                strong p;
+                weak w;
+                std::vector<strong> held;
+                for (;;) {
+                    bool finished = producers_done == 2;
+                    bool got = false;
+                    if (strongs.pop(p)) {
+                        got = true;
+                        strong copy = p;
+                        if (rng() % 4 == 0) held.push_back(copy);
+                        if (held.size() > 20) held.erase(held.begin());
+                        p.reset();
+                    }
+                    if (weaks.pop(w)) {
+                        got = true;
+                        if (strong locked = w.lock()) assert(locked->destroyed == 0);
+                        w.reset();
+                    }
+                    if (finished && !got) break;
+                }
+                held.clear();
+            });
+        }
+        for (std::thread& t : threads) t.join();
+        assert(live == 0); // the producers exited, so everything queued to them is merged
+    }
+}
+
+int main() {
+    single_thread();
+    queued_merge();
+    owner_exits();
+    intrusive();
+    cross_thread_adoption();
+    stress(4, 20000);
+    std::printf("biased_ref_count_policy_test: %ld objects, all destroyed once\n", created.load());
+    return 0;
+}
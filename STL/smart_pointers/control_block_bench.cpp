@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "shared_ptr.h"
+
+// The copy and destruction paths of my::shared_ptr for every kind of control block, ns per operation:
+// make_shared, allocate_shared, a plain new, new with a deleter, new with a deleter and an allocator.
+// "destroy" is the last release alone (the block's manage() call), "create+destroy" includes the allocation.
+// Usage: control_block_bench [iterations = 10000000], a Release build
+//
+// For a before/after comparison build it once more with -DCONTROL_BLOCK_BENCH_BASELINE against the headers from before
+// the control blocks lost their vtable: that leaves out the 32-bit policy and the header sizes, which didn't exist then.
+
+struct object {
+    long payload[2] = {};
+};
+
+struct deleter {
+    void operator()(object* p) const noexcept { delete p; }
+};
+
+static volatile long sink; // keeps the copies from being optimised away
+
+template<typename F>
+static double ns_per_op(long ops, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(ops);
+}
+
+template<typename Ptr, typename Make>
+static void run(const char* name, long iterations, Make make) {
+    double create_destroy = ns_per_op(iterations, [&] {
+        for (long i = 0; i != iterations; ++i) {
+            Ptr p = make();
+            sink = p->payload[0];
+        }
+    });
+
+    const long objects = iterations / 10;
+    std::vector<Ptr> many;
+    many.reserve(objects);
+    for (long i = 0; i != objects; ++i) many.push_back(make());
+    double destroy = ns_per_op(objects, [&] { many.clear(); });
+
+    Ptr p = make();
+    double copy = ns_per_op(iterations, [&] {
+        for (long i = 0; i != iterations; ++i) {
+            Ptr c = p;
+            sink = c->payload[0];
+        }
+    });
+
+    std::printf("%-36s create+destroy %6.2f ns   destroy %6.2f ns   copy+destroy %6.2f ns\n", name, create_destroy, destroy, copy);
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 10'000'000;
+    using ptr = my::shared_ptr<object>;
+
+#ifndef CONTROL_BLOCK_BENCH_BASELINE
+    std::printf("control block header: %zu bytes (atomic_policy), %zu bytes (atomic_policy32)\n",
+                sizeof(my::Control_Block<my::atomic_policy>), sizeof(my::Control_Block<my::atomic_policy32>));
+#endif
+
+    run<ptr>("make_shared", iterations, [] { return my::make_shared<object>(); });
+    run<ptr>("allocate_shared", iterations, [] { return my::allocate_shared<object>(std::allocator<object>()); });
+    run<ptr>("new", iterations, [] { return ptr(new object); });
+    run<ptr>("new + deleter", iterations, [] { return ptr(new object, deleter()); });
+    run<ptr>("new + deleter + allocator", iterations, [] { return ptr(new object, deleter(), std::allocator<object>()); });
+
+#ifndef CONTROL_BLOCK_BENCH_BASELINE
+    using ptr32 = my::shared_ptr<object, my::atomic_policy32>;
+    run<ptr32>("make_shared (atomic_policy32)", iterations, [] { return my::make_shared_with_policy<object, my::atomic_policy32>(); });
+    run<ptr32>("new + deleter (atomic_policy32)", iterations, [] { return ptr32(new object, deleter()); });
+#endif
+    return 0;
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace my {
+
+    // Deferred destruction: dropping the last reference to a big object graph costs whatever its destructor costs,
+    // on whatever thread happened to drop it. With deferred_delete as the deleter, the object is pushed onto the
+    // reclaimer's retire list instead and destroyed later by drain(), either called by hand or by the reclaimer's own thread.
+    //
+    //  - the retire list is a lock-free stack: retire() is one allocation plus a CAS, drain() takes the whole list with one exchange
+    //  - the backlog is bounded: once 'capacity' objects are waiting, retire() destroys its object inline
+    //    (so does a failed allocation of the list node), memory never grows without limit because nobody drains
+    //  - ~deferred_reclaimer() stops the thread and destroys everything still waiting
+    //  - destructors run on another thread and in no particular order, they mustn't depend on the releasing thread's state
+
+    class deferred_reclaimer {
+
+        struct retired_node {
+            retired_node* next = nullptr;
+            void (*destroy)(retired_node*) noexcept = nullptr; // destroys the object and frees the node
+        };
+
+        template<typename T, typename D>
+        struct retired_object : retired_node {
+            T* ptr;
+            D del;
+
+            retired_object(T* ptr, D&& del) : ptr(ptr), del(std::move(del)) {
+                this->destroy = &destroy_this;
+            }
+
+            static void destroy_this(retired_node* node) noexcept {
+                auto* self = static_cast<retired_object*>(node);
+                self->del(self->ptr);
+                delete self;
+            }
+        };
+
+        std::atomic<retired_node*> head{nullptr};
+        std::atomic<std::size_t> backlog{0};
+        const std::size_t capacity;
+
+        std::mutex m;
+        std::condition_variable wake;
+        std::thread worker;
+        bool stopping = false;
+
+        void run(std::chrono::milliseconds period);
+
+    public:
+        static constexpr std::size_t default_capacity = 1u << 16;
+
+        explicit deferred_reclaimer(std::size_t capacity = default_capacity) noexcept;
+
+        deferred_reclaimer(const deferred_reclaimer&) = delete;
+        deferred_reclaimer& operator=(const deferred_reclaimer&) = delete;
+
+        ~deferred_reclaimer();
+
+        // the process-wide reclaimer, flushed at exit; static destructors that run after that must not retire into it
+        static deferred_reclaimer& global();
+
+        // hands p over to the reclaimer, del(p) runs in drain(); runs right here when the backlog is full
+        template<typename T, typename D>
+        void retire(T* p, D del) noexcept;
+
+        // destroys everything retired so far, including whatever those destructors retire themselves; returns how many objects
+        std::size_t drain() noexcept;
+
+        // a background thread that drains every 'period', or sooner once the list goes from empty to non-empty
+        void start(std::chrono::milliseconds period = std::chrono::milliseconds(10));
+
+        // joins the background thread and drains what's left
+        void stop() noexcept;
+
+        std::size_t pending() const noexcept;
+    };
+
+
+    // a deleter for my::shared_ptr / my::unique_ptr that defers D through a reclaimer:
+    //     my::shared_ptr<Graph> g(new Graph, my::deferred_delete<Graph>{});
+    template<typename T, typename D = std::default_delete<T>>
+    struct deferred_delete {
+        deferred_reclaimer* reclaimer = &deferred_reclaimer::global();
+        D del{};
+
+        void operator()(T* p) const noexcept {
+            if (p) reclaimer->retire(p, del);
+        }
+    };
+
+
+    inline deferred_reclaimer::deferred_reclaimer(std::size_t capacity) noexcept : capacity(capacity) {}
+
+    inline deferred_reclaimer::~deferred_reclaimer() {
+        stop();
+    }
+
+    inline deferred_reclaimer& deferred_reclaimer::global() {
+        static deferred_reclaimer instance;
+        return instance;
+    }
+
+    template<typename T, typename D>
+    void deferred_reclaimer::retire(T* p, D del) noexcept {
+        if (backlog.fetch_add(1, std::memory_order_relaxed) >= capacity) {
+            backlog.fetch_sub(1, std::memory_order_relaxed);
+            del(p); // back-pressure: the releasing thread pays, same as without deferral
+            return;
+        }
+
+        auto* node = new(std::nothrow) retired_object<T, D>(p, std::move(del));
+        if (!node) {
+            backlog.fetch_sub(1, std::memory_order_relaxed);
+            del(p); // moved-from only if the allocation succeeded
+            return;
+        }
+
+        retired_node* old = head.load(std::memory_order_relaxed);
+        do {
+            node->next = old;
+        } while (!head.compare_exchange_weak(old, node, std::memory_order_release, std::memory_order_relaxed));
+
+        // no lock around the notify: a wakeup lost to a racing wait is made up for by the period
+        if (!old) wake.notify_one();
+    }
+
+    inline std::size_t deferred_reclaimer::drain() noexcept {
+        std::size_t destroyed = 0;
+        // taking the whole list at once means no pops, so no ABA
+        while (retired_node* list = head.exchange(nullptr, std::memory_order_acquire)) {
+            while (list) {
+                retired_node* next = list->next;
+                list->destroy(list);
+                list = next;
+                ++destroyed;
+            }
+        }
+        backlog.fetch_sub(destroyed, std::memory_order_relaxed);
+        return destroyed;
+    }
+
+    inline void deferred_reclaimer::run(std::chrono::milliseconds period) {
+        std::unique_lock<std::mutex> lock(m);
+        while (!stopping) {
+            lock.unlock();
+            drain();
+            lock.lock();
+            if (stopping) break;
+            wake.wait_for(lock, period);
+        }
+    }
+
+    inline void deferred_reclaimer::start(std::chrono::milliseconds period) {
+        std::lock_guard<std::mutex> lock(m);
+        if (worker.joinable()) return;
+        stopping = false;
+        worker = std::thread([this, period] { run(period); });
+    }
+
+    inline void deferred_reclaimer::stop() noexcept {
+        std::thread finished;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+            finished = std::move(worker);
+        }
+        wake.notify_one();
+        if (finished.joinable()) finished.join();
+        drain();
+    }
+
+    inline std::size_t deferred_reclaimer::pending() const noexcept {
+        return backlog.load(std::memory_order_relaxed);
+    }
+
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "shared_ptr.h"
+#include "weak_ptr.h"
+
+namespace my {
+
+    // Derive from it to let the object hand out shared_ptrs to itself. weak_this is set by the first shared_ptr
+    // that takes ownership (make_shared, allocate_shared or a raw pointer constructor), see shared_ptr::enable_weak_this
+    template<typename T, typename Policy>
+    class enable_shared_from_this {
+
+        template<typename U, typename P>
+        friend class my::shared_ptr;
+
+        mutable my::weak_ptr<T, Policy> weak_this;
+
+    protected:
+        enable_shared_from_this() noexcept = default;
+
+        enable_shared_from_this(const enable_shared_from_this&) noexcept {} // a copy is a different object with its own owner
+
+        enable_shared_from_this& operator=(const enable_shared_from_this&) noexcept {
+            return *this;
+        }
+
+        ~enable_shared_from_this() = default;
+
+    public:
+        // throws my::empty_weak_ptr_exception if the object isn't owned by a shared_ptr
+        my::shared_ptr<T, Policy> shared_from_this();
+
+        my::shared_ptr<const T, Policy> shared_from_this() const;
+
+        my::weak_ptr<T, Policy> weak_from_this() noexcept;
+
+        my::weak_ptr<const T, Policy> weak_from_this() const noexcept;
+    };
+
+
+    template<typename T, typename Policy>
+    my::shared_ptr<T, Policy> enable_shared_from_this<T, Policy>::shared_from_this() {
+        return my::shared_ptr<T, Policy>(weak_this);
+    }
+
+    template<typename T, typename Policy>
+    my::shared_ptr<const T, Policy> enable_shared_from_this<T, Policy>::shared_from_this() const {
+        return my::shared_ptr<const T, Policy>(weak_this);
+    }
+
+    template<typename T, typename Policy>
+    my::weak_ptr<T, Policy> enable_shared_from_this<T, Policy>::weak_from_this() noexcept {
+        return weak_this;
+    }
+
+    template<typename T, typename Policy>
+    my::weak_ptr<const T, Policy> enable_shared_from_this<T, Policy>::weak_from_this() const noexcept {
+        return weak_this;
+    }
+
+};
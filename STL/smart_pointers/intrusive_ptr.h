@@ -0,0 +1,330 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "ref_count_policy.h"
+#include "unique_ptr.h"
+#include "../compressed_pair.h"
+
+namespace my {
+
+    // CRTP base that keeps the reference count inside the object, for my::intrusive_ptr: no control block,
+    // no second allocation and no second pointer to follow. Counting is atomic or not depending on Policy (see ref_count_policy.h).
+    // Deleter gets the Derived* when the last intrusive_ptr lets go, so objects may go back to a pool instead of 'delete'.
+    // It's kept in the object, next to the count: a stateful one (e.g. which pool) is given to the constructor
+    // or comes along from a my::unique_ptr, a stateless one takes no room.
+    template<typename Derived, typename Policy = atomic_policy, typename Deleter = std::default_delete<Derived>>
+    class ref_counted {
+
+        mutable my::compressed_pair<Deleter, typename Policy::counter> del_and_cnt;
+
+        typename Policy::counter& ref_cnt() const noexcept {
+            return del_and_cnt.second();
+        }
+
+        static void released(void* self) noexcept {
+            auto* base = static_cast<ref_counted*>(self);
+            Deleter del = std::move(base->get_deleter()); // it lives in the object it's about to destroy
+            del(static_cast<Derived*>(base));
+        }
+
+        void register_release_hook() noexcept {
+            // policies that may find the count dead later, outside of decrement() (see biased_ref_count_policy.h)
+            if constexpr (requires { ref_cnt().set_release_hook(&released, this); }) {
+                ref_cnt().set_release_hook(&released, this);
+            }
+        }
+
+    protected:
+        ref_counted() noexcept : del_and_cnt(std::in_place, 0u) {
+            static_assert(!(std::is_empty_v<Deleter> && !std::is_final_v<Deleter>) || sizeof(del_and_cnt) == sizeof(typename Policy::counter),
+                          "a stateless deleter must take no room in the object");
+            register_release_hook();
+        }
+
+        explicit ref_counted(Deleter del) noexcept : del_and_cnt(std::move(del), 0u) {
+            register_release_hook();
+        }
+
+        // a copy is a new object, nobody refers to it yet, and whoever made it decides how it goes away
+        ref_counted(const ref_counted&) noexcept : del_and_cnt(std::in_place, 0u) {
+            register_release_hook();
+        }
+
+        ref_counted& operator=(const ref_counted&) noexcept {
+            return *this;
+        }
+
+        ~ref_counted() = default;
+
+    public:
+        using deleter_type = Deleter;
+
+        std::size_t use_count() const noexcept {
+            return ref_cnt().load();
+        }
+
+        Deleter& get_deleter() noexcept {
+            return del_and_cnt.first();
+        }
+
+        const Deleter& get_deleter() const noexcept {
+            return del_and_cnt.first();
+        }
+
+        // intrusive_ptr finds these by ADL, so any other class may provide its own pair instead of deriving from ref_counted
+        friend void intrusive_ptr_add_ref(const ref_counted* p) noexcept {
+            p->ref_cnt().increment();
+        }
+
+        friend void intrusive_ptr_release(const ref_counted* p) noexcept {
+            if (p->ref_cnt().decrement()) {
+                released(const_cast<ref_counted*>(p));
+            }
+        }
+    };
+
+
+    // how an object adopted from a my::unique_ptr goes away: ref_counted's Deleter, 'delete' for classes with their own add_ref/release pair
+    template<typename U>
+    struct intrusive_deleter {
+        using type = std::default_delete<U>;
+    };
+
+    template<typename U>
+        requires requires { typename U::deleter_type; }
+    struct intrusive_deleter<U> {
+        using type = typename U::deleter_type;
+    };
+
+
+    template<typename T>
+    class intrusive_ptr {
+
+        template<typename U>
+        friend class intrusive_ptr;
+
+        T* ptr;
+
+    public:
+        intrusive_ptr() noexcept;
+
+        // add_ref = false adopts a reference the caller already holds (see detach())
+        intrusive_ptr(T* p, bool add_ref = true) noexcept;
+
+        intrusive_ptr(const intrusive_ptr& other) noexcept;
+
+        intrusive_ptr(intrusive_ptr&& other) noexcept;
+
+        template<typename U>
+        intrusive_ptr(const intrusive_ptr<U>& other) noexcept;
+
+        template<typename U>
+        intrusive_ptr(intrusive_ptr<U>&& other) noexcept;
+
+        // the object has no other owners, so this is just one uncontended increment. The unique_ptr's deleter has to be
+        // the one the object is released with (see intrusive_deleter), a ref_counted object takes it over
+        template<typename U, typename D>
+            requires std::is_convertible_v<U*, T*> && std::is_convertible_v<D, typename intrusive_deleter<U>::type>
+        intrusive_ptr(my::unique_ptr<U, D>&& uptr) noexcept;
+
+        ~intrusive_ptr();
+
+
+        intrusive_ptr& operator=(const intrusive_ptr& other) noexcept;
+
+        intrusive_ptr& operator=(intrusive_ptr&& other) noexcept;
+
+        template<typename U>
+        intrusive_ptr& operator=(const intrusive_ptr<U>& other) noexcept;
+
+        template<typename U>
+        intrusive_ptr& operator=(intrusive_ptr<U>&& other) noexcept;
+
+
+        //modifiers
+
+        void reset() noexcept;
+
+        void reset(T* p, bool add_ref = true) noexcept;
+
+        // gives up the pointer without decrementing the count, the caller becomes responsible for that reference
+        T* detach() noexcept;
+
+        void swap(intrusive_ptr& other) noexcept;
+
+
+        //observers
+
+        T* get() noexcept;
+        const T* get() const noexcept;
+
+        T& operator*();
+        const T& operator*() const;
+
+        T* operator->();
+        const T* operator->() const;
+
+        operator bool() const noexcept;
+
+        bool operator==(const intrusive_ptr& other) const noexcept;
+        bool operator!=(const intrusive_ptr& other) const noexcept;
+    };
+
+
+    template<typename T>
+    intrusive_ptr<T>::intrusive_ptr() noexcept : ptr(nullptr) {}
+
+    template<typename T>
+    intrusive_ptr<T>::intrusive_ptr(T* p, bool add_ref) noexcept : ptr(p) {
+        if (ptr && add_ref) intrusive_ptr_add_ref(ptr);
+    }
+
+    template<typename T>
+    intrusive_ptr<T>::intrusive_ptr(const intrusive_ptr& other) noexcept : ptr(other.ptr) {
+        if (ptr) intrusive_ptr_add_ref(ptr);
+    }
+
+    template<typename T>
+    intrusive_ptr<T>::intrusive_ptr(intrusive_ptr&& other) noexcept : ptr(other.ptr) {
+        other.ptr = nullptr;
+    }
+
+    template<typename T>
+    template<typename U>
+    intrusive_ptr<T>::intrusive_ptr(const intrusive_ptr<U>& other) noexcept : ptr(other.ptr) {
+        if (ptr) intrusive_ptr_add_ref(ptr);
+    }
+
+    template<typename T>
+    template<typename U>
+    intrusive_ptr<T>::intrusive_ptr(intrusive_ptr<U>&& other) noexcept : ptr(other.ptr) {
+        other.ptr = nullptr;
+    }
+
+    template<typename T>
+    template<typename U, typename D>
+        requires std::is_convertible_v<U*, T*> && std::is_convertible_v<D, typename intrusive_deleter<U>::type>
+    intrusive_ptr<T>::intrusive_ptr(my::unique_ptr<U, D>&& uptr) noexcept : ptr(nullptr) {
+        if constexpr (requires { typename U::deleter_type; }) {
+            if (uptr) uptr.get()->get_deleter() = std::move(uptr.get_deleter());
+        }
+        ptr = uptr.release();
+        if (ptr) intrusive_ptr_add_ref(ptr);
+    }
+
+    template<typename T>
+    intrusive_ptr<T>::~intrusive_ptr() {
+        if (ptr) intrusive_ptr_release(ptr);
+    }
+
+
+    template<typename T>
+    intrusive_ptr<T>& intrusive_ptr<T>::operator=(const intrusive_ptr& other) noexcept {
+        intrusive_ptr new_ptr(other);
+        swap(new_ptr);
+        return *this;
+    }
+
+    template<typename T>
+    intrusive_ptr<T>& intrusive_ptr<T>::operator=(intrusive_ptr&& other) noexcept {
+        intrusive_ptr new_ptr(std::move(other));
+        swap(new_ptr);
+        return *this;
+    }
+
+    template<typename T>
+    template<typename U>
+    intrusive_ptr<T>& intrusive_ptr<T>::operator=(const intrusive_ptr<U>& other) noexcept {
+        intrusive_ptr new_ptr(other);
+        swap(new_ptr);
+        return *this;
+    }
+
+    template<typename T>
+    template<typename U>
+    intrusive_ptr<T>& intrusive_ptr<T>::operator=(intrusive_ptr<U>&& other) noexcept {
+        intrusive_ptr new_ptr(std::move(other));
+        swap(new_ptr);
+        return *this;
+    }
+
+
+    template<typename T>
+    void intrusive_ptr<T>::reset() noexcept {
+        intrusive_ptr new_ptr;
+        swap(new_ptr);
+    }
+
+    template<typename T>
+    void intrusive_ptr<T>::reset(T* p, bool add_ref) noexcept {
+        intrusive_ptr new_ptr(p, add_ref);
+        swap(new_ptr);
+    }
+
+    template<typename T>
+    T* intrusive_ptr<T>::detach() noexcept {
+        T* value = ptr;
+        ptr = nullptr;
+        return value;
+    }
+
+    template<typename T>
+    void intrusive_ptr<T>::swap(intrusive_ptr& other) noexcept {
+        std::swap(ptr, other.ptr);
+    }
+
+
+    template<typename T>
+    T* intrusive_ptr<T>::get() noexcept {
+        return ptr;
+    }
+
+    template<typename T>
+    const T* intrusive_ptr<T>::get() const noexcept {
+        return ptr;
+    }
+
+    template<typename T>
+    T& intrusive_ptr<T>::operator*() {
+        return *ptr;
+    }
+
+    template<typename T>
+    const T& intrusive_ptr<T>::operator*() const {
+        return *ptr;
+    }
+
+    template<typename T>
+    T* intrusive_ptr<T>::operator->() {
+        return ptr;
+    }
+
+    template<typename T>
+    const T* intrusive_ptr<T>::operator->() const {
+        return ptr;
+    }
+
+    template<typename T>
+    intrusive_ptr<T>::operator bool() const noexcept {
+        return ptr != nullptr;
+    }
+
+    template<typename T>
+    bool intrusive_ptr<T>::operator==(const intrusive_ptr& other) const noexcept {
+        return ptr == other.ptr;
+    }
+
+    template<typename T>
+    bool intrusive_ptr<T>::operator!=(const intrusive_ptr& other) const noexcept {
+        return ptr != other.ptr;
+    }
+
+
+    template<typename T, typename... Args>
+    intrusive_ptr<T> make_intrusive(Args&&... args) {
+        return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+
+};
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "intrusive_ptr.h"
+#include "shared_ptr.h"
+
+// my::intrusive_ptr against my::shared_ptr (made with make_shared, so both are one allocation) for the three things
+// message objects go through: copies, passing by value through a call that can't be inlined, and destruction.
+// Usage: intrusive_ptr_bench [iterations], a Release build
+
+struct message {
+    long payload[4] = {};
+};
+
+struct atomic_message : message, my::ref_counted<atomic_message, my::atomic_policy> {};
+struct local_message : message, my::ref_counted<local_message, my::single_thread_policy> {};
+
+static volatile long sink; // keeps the calls from being optimised away
+
+template<typename F>
+static double ns_per_op(long ops, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(ops);
+}
+
+template<typename Ptr>
+[[gnu::noinline]] long consume(Ptr p) {
+    return p->payload[0];
+}
+
+template<typename Ptr, typename Make>
+static void run(const char* name, long iterations, Make make) {
+    Ptr p = make();
+    std::vector<Ptr> copies(64);
+
+    double copy = ns_per_op(iterations, [&] {
+        for (long i = 0; i != iterations; ++i) copies[i & 63] = p; // a copy and the release of the one it replaces
+    });
+    copies.assign(64, Ptr());
+
+    long sum = 0;
+    double by_value = ns_per_op(iterations, [&] {
+        for (long i = 0; i != iterations; ++i) sum += consume<Ptr>(p);
+    });
+
+    const long objects = iterations / 10;
+    std::vector<Ptr> many;
+    many.reserve(objects);
+    for (long i = 0; i != objects; ++i) many.push_back(make());
+    double destroy = ns_per_op(objects, [&] { many.clear(); });
+
+    sink = sum;
+    std::printf("%-32s copy %6.2f ns   by value %6.2f ns   destroy %6.2f ns\n", name, copy, by_value, destroy);
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 20'000'000;
+
+    run<my::shared_ptr<message>>("shared_ptr (atomic)", iterations, [] { return my::make_shared<message>(); });
+    run<my::intrusive_ptr<atomic_message>>("intrusive_ptr (atomic)", iterations, [] { return my::make_intrusive<atomic_message>(); });
+    run<my::local_shared_ptr<message>>("shared_ptr (single thread)", iterations, [] { return my::make_local_shared<message>(); });
+    run<my::intrusive_ptr<local_message>>("intrusive_ptr (single thread)", iterations, [] { return my::make_intrusive<local_message>(); });
+    return 0;
+}
@@ -0,0 +1,402 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "unique_ptr.h"
+
+namespace my {
+
+    // Recycles objects that are expensive to construct: acquire() hands out a my::unique_ptr<T, pool_deleter>,
+    // and when that pointer dies the object isn't destroyed but goes back to the pool, still constructed.
+    //
+    //  - every thread has its own free list per pool: acquire()/release on the same thread touch no shared memory at all
+    //  - a thread whose list is full (local_capacity) passes the object on to a shared lock-free stack,
+    //    that's also where objects released by other threads end up, so producer/consumer pairs work too.
+    //    A thread whose list is empty takes the whole shared stack with one exchange (no pops, no ABA)
+    //  - at most 'capacity' objects wait in the shared stack, past that (and past local_capacity) released objects are deleted
+    //  - Reset runs on every released object before it's cached (clear buffers, drop references), it must not throw;
+    //    if it returns bool, false means "don't keep this one" and the object is deleted
+    //  - the pool must outlive the pointers it handed out. Objects cached by other threads when the pool dies
+    //    are deleted when those threads exit or next use a pool
+
+    struct object_pool_options {
+        std::size_t capacity = 1024;      // objects kept in the shared stack
+        std::size_t local_capacity = 64;  // objects kept per thread
+    };
+
+    struct object_pool_stats {
+        std::size_t hits = 0;      // acquire() got a cached object
+        std::size_t misses = 0;    // acquire() had to construct one
+        std::size_t recycled = 0;  // released objects that were cached
+        std::size_t discarded = 0; // released objects that were deleted: the pool was full or Reset rejected them
+        std::size_t cached = 0;    // objects waiting in the pool right now
+    };
+
+    struct pool_no_reset {
+        template<typename T>
+        void operator()(T&) const noexcept {}
+    };
+
+
+    template<typename T, typename Reset = pool_no_reset>
+    class object_pool {
+
+        // the link lives next to the object, so caching it never allocates
+        struct node {
+            node* next = nullptr;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T* object() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+
+            static node* from(T* p) noexcept {
+                return reinterpret_cast<node*>(reinterpret_cast<unsigned char*>(p) - offsetof(node, storage));
+            }
+        };
+
+        struct local_cache;
+
+        // whatever the pointers and the thread caches need, shared so that a thread cache may outlive the pool
+        struct shared_state : std::enable_shared_from_this<shared_state> {
+            std::atomic<node*> shared{nullptr};
+            std::atomic<std::size_t> shared_size{0};
+            object_pool_options options;
+            Reset reset;
+
+            std::mutex m;                    // guards everything below: thread caches come and go rarely
+            bool closed = false;
+            std::vector<local_cache*> caches;
+            object_pool_stats retired;       // counters of the thread caches that are gone
+
+            shared_state(const object_pool_options& options, Reset&& reset) : options(options), reset(std::move(reset)) {}
+
+            void push_shared(node* first, node* last, std::size_t count) noexcept;
+            node* take_shared() noexcept;
+            void release(T* p) noexcept;
+        };
+
+        // only the owning thread writes to it, the atomics are here just to let stats() read it
+        struct local_cache {
+            std::shared_ptr<shared_state> state;
+            node* head = nullptr;
+            std::atomic<std::size_t> size{0};
+            std::atomic<std::size_t> hits{0};
+            std::atomic<std::size_t> misses{0};
+            std::atomic<std::size_t> recycled{0};
+            std::atomic<std::size_t> discarded{0};
+
+            static void bump(std::atomic<std::size_t>& counter, std::size_t value = 1) noexcept {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            void push(node* n) noexcept;
+            node* pop() noexcept;
+            void detach() noexcept;
+        };
+
+        struct thread_caches {
+            shared_state* last_state = nullptr;
+            local_cache* last_cache = nullptr;
+            std::vector<std::unique_ptr<local_cache>> all;
+
+            ~thread_caches();
+        };
+
+        // null once this thread's caches are destroyed: a static pool may die after the thread_locals of the main thread
+        static thread_caches* this_thread_caches() noexcept;
+        static bool& this_thread_done() noexcept;
+        static local_cache* cache_for(shared_state* state);
+        static void drop_cache(thread_caches& mine, shared_state* state) noexcept;
+        static void destroy(node* n) noexcept;
+
+        std::shared_ptr<shared_state> state;
+
+    public:
+        class pool_deleter {
+            shared_state* state = nullptr;
+
+        public:
+            pool_deleter() = default;
+            explicit pool_deleter(shared_state* state) noexcept : state(state) {}
+
+            void operator()(T* p) const noexcept { state->release(p); }
+        };
+
+        using pointer = my::unique_ptr<T, pool_deleter>;
+
+        explicit object_pool(const object_pool_options& options = {}, Reset reset = Reset{});
+
+        object_pool(const object_pool&) = delete;
+        object_pool& operator=(const object_pool&) = delete;
+
+        ~object_pool();
+
+        // a cached object as it was left by Reset, or a default-constructed one
+        pointer acquire();
+
+        // constructs up to n objects into the shared stack ahead of time, returns how many it made
+        std::size_t prewarm(std::size_t n);
+
+        object_pool_stats stats();
+    };
+
+
+
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::destroy(node* n) noexcept {
+        n->object()->~T();
+        delete n;
+    }
+
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::shared_state::push_shared(node* first, node* last, std::size_t count) noexcept {
+        shared_size.fetch_add(count, std::memory_order_relaxed); // before the nodes show up, so a taker never makes it wrap
+        node* old = shared.load(std::memory_order_relaxed);
+        do {
+            last->next = old;
+        } while (!shared.compare_exchange_weak(old, first, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    template<typename T, typename Reset>
+    typename object_pool<T, Reset>::node* object_pool<T, Reset>::shared_state::take_shared() noexcept {
+        if (!shared.load(std::memory_order_relaxed)) return nullptr; // don't dirty the line when there's nothing to take
+        return shared.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::shared_state::release(T* p) noexcept {
+        local_cache* cache = nullptr;
+        try {
+            cache = cache_for(this);
+        }
+        catch(...) {} // no memory for a thread cache: the shared stack still works
+
+        if constexpr (!std::is_void_v<std::invoke_result_t<Reset&, T&>>) {
+            if (!reset(*p)) {
+                if (cache) local_cache::bump(cache->discarded);
+                destroy(node::from(p));
+                return;
+            }
+        }
+        else {
+            reset(*p);
+        }
+
+        node* n = node::from(p);
+        if (cache && cache->size.load(std::memory_order_relaxed) < options.local_capacity) {
+            cache->push(n);
+            local_cache::bump(cache->recycled);
+            return;
+        }
+        if (shared_size.load(std::memory_order_relaxed) < options.capacity) { // may overshoot by a few under a race, that's fine
+            push_shared(n, n, 1);
+            if (cache) local_cache::bump(cache->recycled);
+            return;
+        }
+        if (cache) local_cache::bump(cache->discarded);
+        destroy(n);
+    }
+
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::local_cache::push(node* n) noexcept {
+        n->next = head;
+        head = n;
+        size.store(size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    template<typename T, typename Reset>
+    typename object_pool<T, Reset>::node* object_pool<T, Reset>::local_cache::pop() noexcept {
+        if (!head) {
+            node* list = state->take_shared();
+            if (!list) return nullptr;
+            std::size_t taken = 0;
+            for (node* n = list; n; n = n->next) ++taken;
+            state->shared_size.fetch_sub(taken, std::memory_order_relaxed);
+            head = list;
+            size.store(taken, std::memory_order_relaxed);
+        }
+        node* n = head;
+        head = n->next;
+        size.store(size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        return n;
+    }
+
+    // the thread is done with this pool: its objects go to the shared stack, or get deleted if the pool is gone
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::local_cache::detach() noexcept {
+        std::lock_guard<std::mutex> lock(state->m);
+        std::erase(state->caches, this);
+        state->retired.hits += hits.load(std::memory_order_relaxed);
+        state->retired.misses += misses.load(std::memory_order_relaxed);
+        state->retired.recycled += recycled.load(std::memory_order_relaxed);
+        state->retired.discarded += discarded.load(std::memory_order_relaxed);
+
+        if (!head) return;
+        if (state->closed) {
+            while (head) {
+                node* next = head->next;
+                destroy(head);
+                head = next;
+            }
+        }
+        else {
+            node* last = head;
+            while (last->next) last = last->next;
+            state->push_shared(head, last, size.load(std::memory_order_relaxed));
+        }
+        head = nullptr;
+        size.store(0, std::memory_order_relaxed);
+    }
+
+    template<typename T, typename Reset>
+    object_pool<T, Reset>::thread_caches::~thread_caches() {
+        this_thread_done() = true;
+        for (auto& cache : all) {
+            cache->detach();
+        }
+    }
+
+    template<typename T, typename Reset>
+    bool& object_pool<T, Reset>::this_thread_done() noexcept {
+        static thread_local bool done = false; // trivially destructible, so still readable while thread_locals are destroyed
+        return done;
+    }
+
+    template<typename T, typename Reset>
+    typename object_pool<T, Reset>::thread_caches* object_pool<T, Reset>::this_thread_caches() noexcept {
+        if (this_thread_done()) return nullptr;
+        static thread_local thread_caches mine;
+        return &mine;
+    }
+
+    template<typename T, typename Reset>
+    void object_pool<T, Reset>::drop_cache(thread_caches& mine, shared_state* state) noexcept {
+        if (mine.last_state == state) {
+            mine.last_state = nullptr;
+            mine.last_cache = nullptr;
+        }
+        std::erase_if(mine.all, [state](auto& cache) {
+            if (cache->state.get() != state) return false;
+            cache->detach();
+            return true;
+        });
+    }
+
+    template<typename T, typename Reset>
+    typename object_pool<T, Reset>::local_cache* object_pool<T, Reset>::cache_for(shared_state* state) {
+        thread_caches* current = this_thread_caches();
+        if (!current) return nullptr;
+        thread_caches& mine = *current;
+        if (mine.last_state == state) {
+            return mine.last_cache;
+        }
+
+        local_cache* found = nullptr;
+        for (auto& cache : mine.all) {
+            if (cache->state.get() == state) found = cache.get();
+        }
+        if (!found) {
+            // a good moment to let go of the caches of dead pools
+            std::erase_if(mine.all, [](auto& cache) {
+                bool closed;
+                {
+                    std::lock_guard<std::mutex> lock(cache->state->m);
+                    closed = cache->state->closed;
+                }
+                if (closed) cache->detach();
+                return closed;
+            });
+
+            auto cache = std::make_unique<local_cache>();
+            cache->state = state->shared_from_this();
+            found = cache.get();
+            mine.all.push_back(std::move(cache));
+            std::lock_guard<std::mutex> lock(state->m);
+            state->caches.push_back(found);
+        }
+        mine.last_state = state;
+        mine.last_cache = found;
+        return found;
+    }
+
+
+    template<typename T, typename Reset>
+    object_pool<T, Reset>::object_pool(const object_pool_options& options, Reset reset)
+        : state(std::make_shared<shared_state>(options, std::move(reset)))
+    {}
+
+    template<typename T, typename Reset>
+    object_pool<T, Reset>::~object_pool() {
+        if (thread_caches* mine = this_thread_caches()) {
+            drop_cache(*mine, state.get());
+        }
+
+        std::lock_guard<std::mutex> lock(state->m);
+        state->closed = true;
+        node* list = state->shared.exchange(nullptr, std::memory_order_acquire);
+        while (list) {
+            node* next = list->next;
+            destroy(list);
+            list = next;
+        }
+        state->shared_size.store(0, std::memory_order_relaxed);
+    }
+
+    template<typename T, typename Reset>
+    typename object_pool<T, Reset>::pointer object_pool<T, Reset>::acquire() {
+        local_cache* cache = cache_for(state.get());
+        if (node* n = cache ? cache->pop() : nullptr) {
+            local_cache::bump(cache->hits);
+            return pointer(n->object(), pool_deleter(state.get()));
+        }
+
+        if (cache) local_cache::bump(cache->misses);
+        auto* n = new node;
+        try {
+            ::new(static_cast<void*>(n->storage)) T();
+        }
+        catch(...) {
+            delete n;
+            throw;
+        }
+        return pointer(n->object(), pool_deleter(state.get()));
+    }
+
+    template<typename T, typename Reset>
+    std::size_t object_pool<T, Reset>::prewarm(std::size_t n) {
+        std::size_t made = 0;
+        while (made != n && state->shared_size.load(std::memory_order_relaxed) < state->options.capacity) {
+            auto* fresh = new node;
+            try {
+                ::new(static_cast<void*>(fresh->storage)) T();
+            }
+            catch(...) {
+                delete fresh;
+                throw;
+            }
+            state->push_shared(fresh, fresh, 1);
+            ++made;
+        }
+        return made;
+    }
+
+    template<typename T, typename Reset>
+    object_pool_stats object_pool<T, Reset>::stats() {
+        std::lock_guard<std::mutex> lock(state->m);
+        object_pool_stats result = state->retired;
+        result.cached = state->shared_size.load(std::memory_order_relaxed);
+        for (local_cache* cache : state->caches) {
+            result.hits += cache->hits.load(std::memory_order_relaxed);
+            result.misses += cache->misses.load(std::memory_order_relaxed);
+            result.recycled += cache->recycled.load(std::memory_order_relaxed);
+            result.discarded += cache->discarded.load(std::memory_order_relaxed);
+            result.cached += cache->size.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+};
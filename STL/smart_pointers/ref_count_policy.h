@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace my {
+
+    // How a reference count is kept. shared_ptr/weak_ptr take the policy as a template parameter, so that
+    // components that never share their pointers between threads don't pay for locked instructions.
+    //
+    // counter interface:
+    //   increment()            - one more reference
+    //   decrement()            - one reference less, true if it was the last one
+    //   increment_if_nonzero() - a reference from a weak one (weak_ptr::lock), fails once the count has dropped to zero
+    //   load()                 - the current value, only a hint when other threads are working with the same counter
+    //   unique()               - true if the caller holds the only reference, everything the others did before letting go is visible
+    //
+    // Count is the counter's width: 32-bit counts shrink the control block header from 24 to 16 bytes (see Control_Block in shared_ptr.h),
+    // at the price of a 4G references limit.
+
+
+    template<typename Count>
+    struct basic_single_thread_policy {
+
+        class counter {
+
+            Count cnt;
+
+        public:
+            explicit counter(Count init) noexcept : cnt(init) {}
+
+            void increment() noexcept {
+                ++cnt;
+            }
+
+            bool decrement() noexcept {
+                return --cnt == 0;
+            }
+
+            bool increment_if_nonzero() noexcept {
+                if (cnt == 0) return false;
+                ++cnt;
+                return true;
+            }
+
+            std::size_t load() const noexcept {
+                return cnt;
+            }
+
+            bool unique() const noexcept {
+                return cnt == 1;
+            }
+        };
+    };
+
+
+    template<typename Count>
+    struct basic_atomic_policy {
+
+        class counter {
+
+            std::atomic<Count> cnt;
+
+        public:
+            explicit counter(Count init) noexcept : cnt(init) {}
+
+            // a new reference is always made from an existing one, which keeps the object alive, so nothing has to be ordered here
+            void increment() noexcept {
+                cnt.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // release: our writes to the object happen before its destruction in another thread,
+            // acquire: the thread that destroys the object sees all the writes of the others
+            bool decrement() noexcept {
+                return cnt.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            }
+
+            bool increment_if_nonzero() noexcept {
+                Count current = cnt.load(std::memory_order_relaxed);
+                while (current != 0) {
+                    if (cnt.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            std::size_t load() const noexcept {
+                return cnt.load(std::memory_order_relaxed);
+            }
+
+            // acquire pairs with the release in the others' decrement()
+            bool unique() const noexcept {
+                return cnt.load(std::memory_order_acquire) == 1;
+            }
+        };
+    };
+
+
+    using single_thread_policy = basic_single_thread_policy<std::size_t>;
+    using atomic_policy = basic_atomic_policy<std::size_t>;
+
+    using single_thread_policy32 = basic_single_thread_policy<std::uint32_t>;
+    using atomic_policy32 = basic_atomic_policy<std::uint32_t>;
+
+};
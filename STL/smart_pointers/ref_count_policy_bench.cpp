@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "shared_ptr.h"
+
+// Copy + destroy of a my::shared_ptr under my::single_thread_policy and my::atomic_policy, ns per copy:
+//  - one thread: the price of the locked instructions alone
+//  - 1..max threads copying one shared object: all of them hammer the same counter's cache line
+//  - 1..max threads copying an object each: the uncontended cost, for comparison
+// Usage: ref_count_policy_bench [iterations per thread = 10000000] [max threads = 8], a Release build
+
+struct object {
+    long payload[4] = {};
+};
+
+static volatile long sink; // keeps the copies from being optimised away
+
+template<typename F>
+static double ns_per_op(long ops, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(ops);
+}
+
+template<typename Ptr>
+static void copy_loop(const Ptr& p, long iterations) {
+    for (long i = 0; i != iterations; ++i) {
+        Ptr copy = p;
+        sink = copy->payload[0];
+    }
+}
+
+// wall time per copy of one thread: with real parallelism it stays flat unless the threads fight over a cache line
+static double threaded(int threads, long iterations, bool shared) {
+    my::shared_ptr<object> common = my::make_shared<object>();
+    std::vector<my::shared_ptr<object>> own(threads);
+    for (auto& p : own) p = my::make_shared<object>();
+
+    return ns_per_op(iterations, [&] {
+        std::vector<std::thread> workers;
+        for (int t = 0; t != threads; ++t) {
+            workers.emplace_back([&, t] { copy_loop(shared ? common : own[t], iterations); });
+        }
+        for (std::thread& w : workers) w.join();
+    });
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 10'000'000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : 8;
+
+    my::local_shared_ptr<object> local = my::make_local_shared<object>();
+    my::shared_ptr<object> atomic = my::make_shared<object>();
+    double single = ns_per_op(iterations, [&] { copy_loop(local, iterations); });
+    double locked = ns_per_op(iterations, [&] { copy_loop(atomic, iterations); });
+    std::printf("one thread: single_thread_policy %6.2f ns   atomic_policy %6.2f ns\n", single, locked);
+
+    std::printf("%u hardware threads, atomic_policy\n", std::thread::hardware_concurrency());
+    std::printf("%8s %20s %20s\n", "threads", "one object (ns)", "object each (ns)");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double contended = threaded(threads, iterations, true);
+        double separate = threaded(threads, iterations, false);
+        std::printf("%8d %20.2f %20.2f\n", threads, contended, separate);
+    }
+    return 0;
+}
@@ -1,4 +1,14 @@
+#pragma once
+#include <cstddef>
 #include <exception>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "ref_count_policy.h"
+#include "../compressed_pair.h"
+#include "../uninitialized.h"
 
 
 
@@ -10,38 +20,169 @@ namespace my {
         }        
     };
 
-    template<typename T>
+    template<typename T, typename Policy = atomic_policy>
     class weak_ptr;
 
+    template<typename T, typename Policy = atomic_policy>
+    class shared_ptr;
+
     template<typename T>
-    class shared_ptr {
+    class atomic_shared_ptr;
+
+    template<typename T, typename Policy = atomic_policy>
+    class enable_shared_from_this;
+
+
+    // passed to make_shared_with_policy/allocate_shared_with_policy as the last argument, the object (or every array element)
+    // is default-initialized instead of value-initialized, see make_shared_for_overwrite
+    struct for_overwrite_t {
+        explicit for_overwrite_t() = default;
+    };
+
+    inline constexpr for_overwrite_t for_overwrite{};
+
+    template<typename... Args>
+    constexpr bool is_for_overwrite_v = false;
+
+    template<typename Arg>
+    constexpr bool is_for_overwrite_v<Arg> = std::is_same_v<std::remove_cvref_t<Arg>, for_overwrite_t>;
+
+
+    // which pointers a shared_ptr<T> may take, the standard's rules: without them shared_ptr<Base[]> would accept
+    // a Derived* (delete[] through a base pointer) or a shared_ptr<Derived[]> (indexed with the wrong stride).
+    //  - a raw pointer Y*: Y* converts to T* for objects, Y(*)[] to T(*)[] (or Y(*)[N] to T(*)[N]) for arrays
+    //  - another shared_ptr<Y>/weak_ptr<Y>: Y* converts to T*, or Y is U[N] and T is cv U[]
+    template<typename Y, typename T>
+    constexpr bool sp_convertible_v = std::is_convertible_v<Y*, T*>;
+
+    template<typename Y, typename U>
+    constexpr bool sp_convertible_v<Y, U[]> = std::is_convertible_v<Y(*)[], U(*)[]>;
+
+    template<typename Y, typename U, std::size_t N>
+    constexpr bool sp_convertible_v<Y, U[N]> = std::is_convertible_v<Y(*)[N], U(*)[N]>;
+
+    template<typename Y, typename T>
+    constexpr bool sp_compatible_v = std::is_convertible_v<Y*, T*>;
+
+    template<typename U, std::size_t N, typename V>
+    constexpr bool sp_compatible_v<U[N], V[]> = std::is_convertible_v<U(*)[], V(*)[]>;
+
+
+    // raw storage for a control block followed by array elements, allocators are rebound to it
+    // so that both the header and the elements end up properly aligned
+    template<std::size_t Align>
+    struct alignas(Align) cb_storage_unit {
+        unsigned char bytes[Align];
+    };
+
+
+    // what a control block is asked to do with the object and with itself
+    enum class cb_action {
+        destroy_object,
+        delete_control_block,
+        destroy_and_delete
+    };
+
+
+    // the part of a control block that doesn't depend on the object's type, so that shared_ptr<T> and shared_ptr<U>
+    // (and the weak_ptrs) made from the same object can all point to the same block.
+    // There's no vtable: every concrete block passes its own static manage() function, which is the only thing
+    // that knows how to destroy the object and give the memory back. One pointer and two counters make a 16 byte
+    // header with the 32-bit policies (24 bytes with the default ones), instead of vptr + 2 * size_t.
+    template<typename Policy>
+    struct Control_Block {
+
+        using manager_type = void (*)(Control_Block*, cb_action) noexcept;
+
+        manager_type manager;
+        typename Policy::counter cnt_shared;
+        typename Policy::counter cnt_weak; // the number of weak_ptrs + 1 while cnt_shared != 0, so that exactly one side frees the block
         
+        explicit Control_Block(manager_type manager) noexcept
+            : manager(manager),
+            cnt_shared(1u),
+            cnt_weak(1u)
+        {
+            // policies that may find a count dead later, outside of decrement() (see biased_ref_count_policy.h)
+            if constexpr (requires { cnt_shared.set_release_hook(&shared_released, this); }) {
+                cnt_shared.set_release_hook(&shared_released, this);
+                cnt_weak.set_release_hook(&weak_released, this);
+            }
+        }
 
-        template<typename U>
-        friend class my::weak_ptr;
+        void add_shared() noexcept {
+            cnt_shared.increment();
+        }
 
-        struct Control_Block {
-            
-            std::size_t cnt_shared;
-            std::size_t cnt_weak;
-            
-            explicit Control_Block() noexcept
-                : cnt_shared(1u),
-                cnt_weak(0u)
-            {}
+        bool add_shared_if_alive() noexcept {
+            return cnt_shared.increment_if_nonzero();
+        }
+
+        void release_shared() noexcept {
+            if (cnt_shared.decrement()) {
+                on_last_shared();
+            }
+        }
+
+        void on_last_shared() noexcept {
+            if (cnt_weak.unique()) {
+                // no weak_ptrs, and none can appear without a shared_ptr: one indirect call instead of two
+                manager(this, cb_action::destroy_and_delete);
+            }
+            else {
+                manager(this, cb_action::destroy_object);
+                release_weak(); // the +1 the shared owners held together
+            }
+        }
 
-            /*virtual bool has_alloc() const noexcept {
-                return false;
-            }*/
+        void add_weak() noexcept {
+            cnt_weak.increment();
+        }
 
-            virtual void delete_control_block() noexcept {
-                delete this;
+        void release_weak() noexcept {
+            if (cnt_weak.decrement()) {
+                manager(this, cb_action::delete_control_block);
             }
+        }
 
-            virtual void destroy_object() noexcept = 0;
+        static void shared_released(void* self) noexcept {
+            static_cast<Control_Block*>(self)->on_last_shared();
+        }
 
-            virtual ~Control_Block() = default;
-        };
+        static void weak_released(void* self) noexcept {
+            Control_Block* cb = static_cast<Control_Block*>(self);
+            cb->manager(cb, cb_action::delete_control_block);
+        }
+
+        std::size_t use_count() const noexcept {
+            return cnt_shared.load();
+        }
+
+        // not use_count() == 1: that load is relaxed, this one acquires what the released owners did to the object
+        bool unique() const noexcept {
+            return cnt_shared.unique();
+        }
+    };
+
+
+    template<typename T, typename Policy>
+    class shared_ptr {
+    public:
+
+        using element_type = std::remove_extent_t<T>; // T for T[] and T[N]
+
+    private:
+
+        template<typename U, typename P>
+        friend class my::weak_ptr;
+
+        template<typename U, typename P>
+        friend class my::shared_ptr;
+
+        template<typename U>
+        friend class my::atomic_shared_ptr;
+
+        using Control_Block = my::Control_Block<Policy>;
 
 
         template<typename U>
@@ -49,59 +190,63 @@ namespace my {
             
             U* value;
 
-            explicit Control_Block_Value(U* p) noexcept : value(p) {}
+            explicit Control_Block_Value(U* p) noexcept : Control_Block(&manage), value(p) {}
             
-            void destroy_object() noexcept override {
-                delete value;
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Control_Block_Value*>(base);
+                if (action != cb_action::delete_control_block) {
+                    if constexpr (std::is_array_v<T>) {
+                        delete[] self->value;
+                    }
+                    else {
+                        delete self->value;
+                    }
+                }
+                if (action != cb_action::destroy_object) delete self;
             }
 
         };
 
 
         template<typename U, typename Deleter>
-        struct Control_Block_Deleter : Control_Block_Value<U> {
+        struct Control_Block_Deleter : Control_Block {
             
-            Deleter del;
+            my::compressed_pair<Deleter, U*> del_and_value; // a stateless deleter takes no room
 
             explicit Control_Block_Deleter(U* p, const Deleter& del)
-                : Control_Block_Value<U>(p),
-                del(del)
+                : Control_Block(&manage),
+                del_and_value(del, p)
             {}
 
-            void destroy_object() noexcept override {
-                del(Control_Block_Value<U>::value);
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Control_Block_Deleter*>(base);
+                if (action != cb_action::delete_control_block) self->del_and_value.first()(self->del_and_value.second());
+                if (action != cb_action::destroy_object) delete self;
             }
 
         };
 
 
         template<typename U, typename Deleter, typename Alloc>
-        struct Control_Block_Alloc: Control_Block_Deleter<U, Deleter> {
+        struct Control_Block_Alloc : Control_Block {
             
-            Alloc alloc;
+            my::compressed_pair<Alloc, my::compressed_pair<Deleter, U*>> alloc_del_value;
         
             explicit Control_Block_Alloc(U* p, const Deleter& del, const Alloc& alloc)
-               : Control_Block_Deleter<U, Deleter>(p, del),
-              alloc(alloc)
+                : Control_Block(&manage),
+                alloc_del_value(alloc, my::compressed_pair<Deleter, U*>(del, p))
             {}
 
-           /*bool has_alloc() const noexcept override {
-               return true;
-           }*/
-
-        private:
-            
-            static void delete_control_block_helper(Control_Block_Alloc* control_block) noexcept {
-                using CB_Alloc_Type  = typename std::allocator_traits<Alloc>::template rebind_alloc<Control_Block_Alloc>;
-                CB_Alloc_Type cb_alloc = control_block->alloc;
-                std::allocator_traits<CB_Alloc_Type>::destroy(cb_alloc, control_block);
-                std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, control_block, 1);
-            }
-
-        public:
-           
-            void delete_control_block() noexcept override {
-                delete_control_block_helper(this);
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Control_Block_Alloc*>(base);
+                auto& del_and_value = self->alloc_del_value.second();
+                if (action != cb_action::delete_control_block) del_and_value.first()(del_and_value.second());
+                if (action != cb_action::destroy_object) {
+                    using CB_Alloc_Type  = typename std::allocator_traits<Alloc>::template rebind_alloc<Control_Block_Alloc>;
+                    CB_Alloc_Type cb_alloc = self->alloc_del_value.first();
+                    std::allocator_traits<CB_Alloc_Type>::destroy(cb_alloc, self);
+                    std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, self, 1);
+                }
             }
 
         };
@@ -109,79 +254,171 @@ namespace my {
 
         template<typename Alloc>
         struct Control_Block_Alloc_Shared : Control_Block {
+
+            union Storage {
+                T value; // same trick as in Make_Shared_CB, the union member is aligned for T, whatever T's alignment is
+
+                Storage() noexcept {}
+                ~Storage() {}
+            };
+
+            my::compressed_pair<Alloc, Storage> alloc_and_storage; // std::allocator takes no room in front of the object
             
-            Alloc alloc;
-            
-            explicit Control_Block_Alloc_Shared(const Alloc& alloc) : alloc(alloc) {}
-            
-            /*bool has_alloc() const noexcept override {
-                return true;
-            }*/
+            explicit Control_Block_Alloc_Shared(const Alloc& alloc) : Control_Block(&manage), alloc_and_storage(alloc, std::in_place) {}
 
-        private:
-        
-            static void delete_control_block_helper(Control_Block_Alloc_Shared* control_block) noexcept {
-                using CB_Alloc_Type = typename std::allocator_traits<Alloc>::template rebind_alloc<Alloc_Shared_Helper_Struct<Alloc>>;
-                CB_Alloc_Type cb_alloc = control_block->alloc;
-                std::allocator_traits<CB_Alloc_Type>::destroy(cb_alloc, control_block);
-                std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, static_cast<Alloc_Shared_Helper_Struct<Alloc>*>(control_block), 1);
+            Alloc& alloc() noexcept {
+                return alloc_and_storage.first();
             }
 
-        public:
-
-            void delete_control_block() noexcept override {
-                delete_control_block_helper(this);
-            }    
+            T* object() noexcept {
+                return &alloc_and_storage.second().value;
+            }
 
-            void destroy_object() noexcept override {
-                std::allocator_traits<Alloc>::destroy(alloc, reinterpret_cast<T*>(reinterpret_cast<char*>(this) + sizeof(*this))); // fix this later
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Control_Block_Alloc_Shared*>(base);
+                if (action != cb_action::delete_control_block) std::allocator_traits<Alloc>::destroy(self->alloc(), self->object());
+                if (action != cb_action::destroy_object) {
+                    using CB_Alloc_Type = typename std::allocator_traits<Alloc>::template rebind_alloc<Control_Block_Alloc_Shared>;
+                    CB_Alloc_Type cb_alloc = self->alloc();
+                    std::allocator_traits<CB_Alloc_Type>::destroy(cb_alloc, self);
+                    std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, self, 1);
+                }
             }
         
         };
 
 
 
+        // the object lives in a union member right after the counters, so the compiler places it at a properly aligned offset
+        // and the class-specific alignment of Make_Shared_CB makes 'new'/'delete' use the aligned operator new for over-aligned T
+        struct Make_Shared_CB : Control_Block {
 
+            union {
+                T value;
+            };
+
+            template<typename... Args>
+            explicit Make_Shared_CB(Args&&... args) : Control_Block(&manage) {
+                if constexpr (is_for_overwrite_v<Args...>) {
+                    new(&value) T;
+                }
+                else {
+                    new(&value) T(std::forward<Args>(args)...);
+                }
+            }
+
+            ~Make_Shared_CB() {} // value is destroyed by manage(), when the last shared_ptr dies
+            
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Make_Shared_CB*>(base);
+                if (action != cb_action::delete_control_block) self->value.~T();
+                if (action != cb_action::destroy_object) delete self;
+            }
 
-        template<typename Alloc>
-        struct Alloc_Shared_Helper_Struct : Control_Block_Alloc_Shared<Alloc> {
-            T value;
         };
 
-        
 
-        struct Make_Shared_CB : Control_Block {
-            
-            explicit Make_Shared_CB() noexcept = default;
-            
-            void destroy_object() noexcept override {
-                reinterpret_cast<T*>(reinterpret_cast<char*>(this) + sizeof(*this))->~T(); // fix this later
+        // shared_ptr<T[]>/shared_ptr<T[N]> from make_shared: the header and the elements share one allocation,
+        // laid out as [Control_Block_Array | padding | element_type[size]]
+        template<typename Alloc>
+        struct Control_Block_Array : Control_Block {
+
+            my::compressed_pair<Alloc, std::size_t> alloc_and_size; // the allocator is already rebound to element_type
+
+            explicit Control_Block_Array(const Alloc& alloc, std::size_t size) noexcept
+                : Control_Block(&manage),
+                alloc_and_size(alloc, size)
+            {}
+
+            Alloc& alloc() noexcept {
+                return alloc_and_size.first();
+            }
+
+            std::size_t size() const noexcept {
+                return alloc_and_size.second();
+            }
+
+            // elements get the allocator's alignment too (e.g. aligned_allocator<float, 64>), so that the buffer is SIMD-friendly
+            static constexpr std::size_t elements_alignment() noexcept {
+                return my::allocator_traits<Alloc>::alignment;
+            }
+
+            static constexpr std::size_t block_alignment() noexcept {
+                return alignof(Control_Block_Array) > elements_alignment() ? alignof(Control_Block_Array) : elements_alignment();
+            }
+
+            static constexpr std::size_t elements_offset() noexcept {
+                return (sizeof(Control_Block_Array) + elements_alignment() - 1u) / elements_alignment() * elements_alignment();
+            }
+
+            // Unit can't be a class-scope alias: the block's own size and alignment are known only inside member functions
+            static std::size_t units_for(std::size_t num_of_elem) {
+                using Unit = my::cb_storage_unit<block_alignment()>;
+                if (num_of_elem > (std::numeric_limits<std::size_t>::max() - elements_offset() - sizeof(Unit)) / sizeof(element_type)) {
+                    throw std::bad_array_new_length{};
+                }
+                return (elements_offset() + num_of_elem * sizeof(element_type) + sizeof(Unit) - 1u) / sizeof(Unit);
+            }
+
+            static Control_Block_Array* create(const Alloc& alloc, std::size_t num_of_elem) {
+                using Unit = my::cb_storage_unit<block_alignment()>;
+                using Unit_Alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Unit>;
+                Unit_Alloc unit_alloc(alloc);
+                Unit* memory = std::allocator_traits<Unit_Alloc>::allocate(unit_alloc, units_for(num_of_elem));
+                return ::new(static_cast<void*>(memory)) Control_Block_Array(alloc, num_of_elem);
+            }
+
+            static void free(Control_Block_Array* self) noexcept {
+                using Unit = my::cb_storage_unit<block_alignment()>;
+                using Unit_Alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Unit>;
+                Unit_Alloc unit_alloc(self->alloc());
+                std::size_t units = units_for(self->size());
+                self->~Control_Block_Array();
+                std::allocator_traits<Unit_Alloc>::deallocate(unit_alloc, reinterpret_cast<Unit*>(self), units);
+            }
+
+            element_type* elements() noexcept {
+                return reinterpret_cast<element_type*>(reinterpret_cast<unsigned char*>(this) + elements_offset());
+            }
+
+            static void manage(Control_Block* base, cb_action action) noexcept {
+                auto* self = static_cast<Control_Block_Array*>(base);
+                if (action != cb_action::delete_control_block && !my::is_trivially_destructible_by_v<Alloc, element_type>) {
+                    for (std::size_t i = self->size(); i != 0; --i) { // in reverse order, as for built-in arrays
+                        my::allocator_traits<Alloc>::destroy(self->alloc(), self->elements() + i - 1);
+                    }
+                }
+                if (action != cb_action::destroy_object) free(self);
             }
 
         };
   
 
-        T* ptr;
+        element_type* ptr;
         Control_Block* cb;
 
         
+        // keep the constructors below from hijacking copy construction from a non-const lvalue
+        struct make_shared_tag {};
+        struct allocate_shared_tag {};
+        struct allocate_array_tag {};
+
         template<typename... Args>
-        shared_ptr(Args&&... args) : ptr(nullptr), cb(static_cast<Control_Block*>(::operator new(sizeof(Make_Shared_CB) +sizeof(T)))) {
-            ptr = static_cast<T*>(static_cast<char*>(cb) + sizeof(Make_Shared_CB));
-            try {
-                new(ptr) T(std::forward<Args>(args)...);
-            }
-            catch(...) {
-                ::operator delete(cb, sizeof(Make_Shared_CB) + sizeof(T));
-                throw;
-            }
-            new(static_cast<Make_Shared_CB*>(cb)) Make_Shared_CB();  
+        shared_ptr(make_shared_tag, Args&&... args) : ptr(nullptr), cb(nullptr) {
+            Make_Shared_CB* temp_cb = new Make_Shared_CB(std::forward<Args>(args)...);
+            ptr = &temp_cb->value;
+            cb = temp_cb;
+            enable_weak_this(ptr, ptr);
         }
 
         template<typename Alloc, typename... Args>
-        shared_ptr(const Alloc& alloc, Args&&... args) : ptr(nullptr), cb(nullptr) {            
+        shared_ptr(allocate_shared_tag, const Alloc& alloc, Args&&... args) : ptr(nullptr), cb(nullptr) {            
+            
+            static_assert(!std::is_array_v<T>);
+            static_assert(!(std::is_empty_v<Alloc> && !std::is_final_v<Alloc>) || sizeof(Control_Block_Alloc_Shared<Alloc>) == sizeof(Make_Shared_CB),
+                          "allocate_shared with a stateless allocator must cost no more than make_shared");
             
-            using CB_Alloc_Type = typename std::allocator_traits<Alloc>::template rebind_alloc<Alloc_Shared_Helper_Struct<Alloc>>;
+            using CB_Alloc_Type = typename std::allocator_traits<Alloc>::template rebind_alloc<Control_Block_Alloc_Shared<Alloc>>;
             
             CB_Alloc_Type cb_alloc = alloc;
             
@@ -190,7 +427,12 @@ namespace my {
             try {
                 std::allocator_traits<CB_Alloc_Type>::construct(cb_alloc, temp_cb, alloc);
                 try {
-                    std::allocator_traits<Alloc>::construct(temp_cb->alloc, &static_cast<Alloc_Shared_Helper_Struct<Alloc>*>(temp_cb)->value, std::forward<Args>(args)...);
+                    if constexpr (is_for_overwrite_v<Args...>) {
+                        ::new(static_cast<void*>(temp_cb->object())) T;
+                    }
+                    else {
+                        std::allocator_traits<Alloc>::construct(temp_cb->alloc(), temp_cb->object(), std::forward<Args>(args)...);
+                    }
                 }
                 catch(...) {
                     std::allocator_traits<CB_Alloc_Type>::destroy(cb_alloc, temp_cb);
@@ -198,45 +440,100 @@ namespace my {
                 }
             }
             catch(...) {
-                std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, static_cast<Alloc_Shared_Helper_Struct<Alloc>*>(temp_cb), 1);
+                std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, temp_cb, 1);
                 throw;
             }
             
             cb = temp_cb;
-            ptr = &static_cast<Alloc_Shared_Helper_Struct<Alloc>*>(temp_cb)->value;
+            ptr = temp_cb->object();
+            enable_weak_this(ptr, ptr);
         }
 
+        // Init is nothing (value-initialization), a const element_type& (every element is a copy) or for_overwrite_t
+        template<typename Alloc, typename... Init>
+        shared_ptr(allocate_array_tag, const Alloc& alloc, std::size_t num_of_elem, const Init&... init) : ptr(nullptr), cb(nullptr) {
+
+            static_assert(std::rank_v<T> == 1, "only one-dimensional arrays are supported");
+
+            using Elem_Alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<element_type>;
+            using CB_Array = Control_Block_Array<Elem_Alloc>;
+
+            CB_Array* temp_cb = CB_Array::create(Elem_Alloc(alloc), num_of_elem);
+
+            try {
+                if constexpr (sizeof...(Init) == 0) {
+                    my::uninitialized_value_construct(temp_cb->alloc(), temp_cb->elements(), num_of_elem);
+                }
+                else if constexpr (is_for_overwrite_v<Init...>) {
+                    my::uninitialized_default_construct(temp_cb->alloc(), temp_cb->elements(), num_of_elem);
+                }
+                else {
+                    my::uninitialized_fill(temp_cb->alloc(), temp_cb->elements(), num_of_elem, static_cast<const element_type&>(init)...);
+                }
+            }
+            catch(...) {
+                CB_Array::free(temp_cb);
+                throw;
+            }
+
+            cb = temp_cb;
+            ptr = temp_cb->elements();
+        }
+
+        // if the object derives from enable_shared_from_this, its weak_this is pointed at the new owner:
+        // just one more weak reference on the block we've already got, no extra allocation.
+        // Overload resolution does the detection - Derived* -> Base* beats Derived* -> void*
+        template<typename U, typename X>
+        void enable_weak_this(U* p, const my::enable_shared_from_this<X, Policy>* base) noexcept {
+            if (base && base->weak_this.expired()) {
+                my::weak_ptr<X, Policy> owner;
+                owner.ptr = const_cast<X*>(static_cast<const X*>(p));
+                owner.cb = cb;
+                cb->add_weak();
+                base->weak_this = std::move(owner);
+            }
+        }
+
+        void enable_weak_this(const volatile void*, const volatile void*) noexcept {}
+
     public:
 
-        template<typename U, typename... Args>
-        friend shared_ptr<U> make_shared(Args&&... args);
+        template<typename U, typename P, typename... Args>
+        friend shared_ptr<U, P> make_shared_with_policy(Args&&... args);
 
-        template<typename U, typename Alloc, typename... Args>
-        friend shared_ptr<U> allocate_shared(const Alloc& alloc, Args&&... args);
+        template<typename U, typename P, typename Alloc, typename... Args>
+        friend shared_ptr<U, P> allocate_shared_with_policy(const Alloc& alloc, Args&&... args);
         
         shared_ptr() noexcept;
         
-        template<typename U>
+        template<typename U> requires sp_convertible_v<U, T>
         shared_ptr(U* p);
         
-        template<typename U, typename Deleter>
+        template<typename U, typename Deleter> requires sp_convertible_v<U, T>
         shared_ptr(U* p, const Deleter& del);
 
-        template<typename U, typename Deleter, typename Alloc>
+        template<typename U, typename Deleter, typename Alloc> requires sp_convertible_v<U, T>
         shared_ptr(U* p, const Deleter& del, const Alloc& alloc);
 
         shared_ptr(const shared_ptr& other) noexcept;
 
         shared_ptr(shared_ptr&& other) noexcept;
 
-        template<typename U>
-        shared_ptr(const shared_ptr<U>& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        shared_ptr(const shared_ptr<U, Policy>& other) noexcept;
 
+        template<typename U> requires sp_compatible_v<U, T>
+        shared_ptr(shared_ptr<U, Policy>&& other) noexcept;
+
+        // aliasing: shares ownership with 'other' but points to 'p', usually a member or a part of the object 'other' owns
         template<typename U>
-        shared_ptr(shared_ptr<U>&& other) noexcept;
+        shared_ptr(const shared_ptr<U, Policy>& other, element_type* p) noexcept;
 
         template<typename U>
-        shared_ptr(const weak_ptr<U>& wptr);
+        shared_ptr(shared_ptr<U, Policy>&& other, element_type* p) noexcept;
+
+        template<typename U> requires sp_compatible_v<U, T>
+        shared_ptr(const weak_ptr<U, Policy>& wptr);
         
         ~shared_ptr();
 
@@ -245,24 +542,24 @@ namespace my {
 
         shared_ptr& operator=(shared_ptr&& other) noexcept;
 
-        template<typename U>
-        shared_ptr& operator=(const shared_ptr<U>& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        shared_ptr& operator=(const shared_ptr<U, Policy>& other) noexcept;
 
-        template<typename U>
-        shared_ptr& operator=(shared_ptr<U>&& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        shared_ptr& operator=(shared_ptr<U, Policy>&& other) noexcept;
 
 
         //modifiers
 
         void reset() noexcept;
 
-        template<typename U>
+        template<typename U> requires sp_convertible_v<U, T>
         void reset(U* p);
 
-        template<typename U, typename Deleter>
+        template<typename U, typename Deleter> requires sp_convertible_v<U, T>
         void reset(U* p, const Deleter& del);
     
-        template<typename U, typename Deleter, typename Alloc>
+        template<typename U, typename Deleter, typename Alloc> requires sp_convertible_v<U, T>
         void reset(U* p, const Deleter& del, const Alloc& alloc);
 
         void swap(shared_ptr& other) noexcept;
@@ -270,14 +567,17 @@ namespace my {
     
         //observers
     
-        T* get() noexcept;
-        const T* get() const noexcept;
+        element_type* get() noexcept;
+        const element_type* get() const noexcept;
 
-        T& operator*();
-        const T& operator*() const;
+        T& operator*() requires (!std::is_array_v<T>);
+        const T& operator*() const requires (!std::is_array_v<T>);
 
-        T* operator->();
-        const T* operator->() const;
+        T* operator->() requires (!std::is_array_v<T>);
+        const T* operator->() const requires (!std::is_array_v<T>);
+
+        element_type& operator[](std::ptrdiff_t idx) requires std::is_array_v<T>;
+        const element_type& operator[](std::ptrdiff_t idx) const requires std::is_array_v<T>;
     
         std::size_t use_count() const noexcept;
 
@@ -288,75 +588,99 @@ namespace my {
     };
 
 
-    template<typename T>
-    shared_ptr<T>::shared_ptr() noexcept : ptr(nullptr), cb(nullptr) {}
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>::shared_ptr() noexcept : ptr(nullptr), cb(nullptr) {}
 
-    template<typename T>
-    template<typename U>
-    shared_ptr<T>::shared_ptr(U* p) : ptr(p), cb(new Control_Block_Value(p)) {}
+    template<typename T, typename Policy>
+    template<typename U> requires sp_convertible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(U* p) : ptr(p), cb(new Control_Block_Value(p)) {
+        if constexpr (!std::is_array_v<T>) enable_weak_this(p, p);
+    }
 
-    template<typename T>
-    template<typename U, typename Deleter>
-    shared_ptr<T>::shared_ptr(U* p, const Deleter& del) : ptr(p), cb(new Control_Block_Deleter(p,del)) {}
+    template<typename T, typename Policy>
+    template<typename U, typename Deleter> requires sp_convertible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(U* p, const Deleter& del) : ptr(p), cb(new Control_Block_Deleter(p,del)) {
+        static_assert(!(std::is_empty_v<Deleter> && !std::is_final_v<Deleter>) || sizeof(Control_Block_Deleter<U, Deleter>) == sizeof(Control_Block) + sizeof(U*),
+                      "a stateless deleter must take no room in the control block");
+        if constexpr (!std::is_array_v<T>) enable_weak_this(p, p);
+    }
 
-    template<typename T>
-    template<typename U, typename Deleter, typename Alloc>
-    shared_ptr<T>::shared_ptr(U* p, const Deleter& del, const Alloc& alloc) : ptr(p), cb(nullptr) {
+    template<typename T, typename Policy>
+    template<typename U, typename Deleter, typename Alloc> requires sp_convertible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(U* p, const Deleter& del, const Alloc& alloc) : ptr(p), cb(nullptr) {
+        static_assert(!(std::is_empty_v<Deleter> && !std::is_final_v<Deleter> && std::is_empty_v<Alloc> && !std::is_final_v<Alloc>)
+                      || sizeof(Control_Block_Alloc<U, Deleter, Alloc>) == sizeof(Control_Block) + sizeof(U*),
+                      "a stateless deleter and allocator must take no room in the control block");
         using CB_Alloc_Type = typename std::allocator_traits<Alloc>::template rebind_alloc<Control_Block_Alloc<U, Deleter, Alloc>>;
         CB_Alloc_Type cb_alloc = alloc;
-        cb = std::allocator_traits<CB_Alloc_Type>::allocate(cb_alloc, 1u);
+        Control_Block_Alloc<U, Deleter, Alloc>* temp_cb = std::allocator_traits<CB_Alloc_Type>::allocate(cb_alloc, 1u);
         try {
-            std::allocator_traits<CB_Alloc_Type>::construct(cb_alloc, reinterpret_cast<Control_Block_Alloc<U,Deleter,Alloc>*>(cb), p, del, alloc);
+            std::allocator_traits<CB_Alloc_Type>::construct(cb_alloc, temp_cb, p, del, alloc);
         }
         catch(...) {
-            std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, reinterpret_cast<Control_Block_Alloc<U, Deleter, Alloc>*>(cb), 1);
+            std::allocator_traits<CB_Alloc_Type>::deallocate(cb_alloc, temp_cb, 1);
             throw;
         }
+        cb = temp_cb;
+        if constexpr (!std::is_array_v<T>) enable_weak_this(p, p);
     }
 
-    template<typename T>
-    shared_ptr<T>::shared_ptr(const shared_ptr& other) noexcept : ptr(other.ptr), cb(other.cb) {
-        if (other.cb) other.cb->cnt_shared += 1;
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>::shared_ptr(const shared_ptr& other) noexcept : ptr(other.ptr), cb(other.cb) {
+        if (cb) cb->add_shared();
     } 
 
-    template<typename T>
-    shared_ptr<T>::shared_ptr(shared_ptr&& other) noexcept : ptr(other.ptr), cb(other.cb) {
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>::shared_ptr(shared_ptr&& other) noexcept : ptr(other.ptr), cb(other.cb) {
         other.ptr = nullptr;
         other.cb = nullptr;
     }
 
-    template<typename T>
-    template<typename U>
-    shared_ptr<T>::shared_ptr(const shared_ptr<U>& other) noexcept 
-        : ptr(other.get()), 
-        cb(reinterpret_cast<Control_Block*>(*(reinterpret_cast<char*>(&other) + sizeof(other.get())))) 
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(const shared_ptr<U, Policy>& other) noexcept 
+        : ptr(other.ptr), 
+        cb(other.cb) 
     {
-        if (cb) ++cb->shared_cnt;
+        if (cb) cb->add_shared();
     }
 
-    template<typename T>
-    template<typename U>
-    shared_ptr<T>::shared_ptr(shared_ptr<U>&& other) noexcept 
-        : ptr(other.get()),
-        cb(reinterpret_cast<Control_Block*>(*(reinterpret_cast<char*>(&other) + sizeof(other.get())))) 
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(shared_ptr<U, Policy>&& other) noexcept 
+        : ptr(other.ptr),
+        cb(other.cb) 
     {
-        if(cb) ++cb->cnt_shared;
-        other.reset();
+        other.ptr = nullptr; // the reference just changes hands, no need to touch the counter
+        other.cb = nullptr;
     }
     
-    template<typename T>
+    template<typename T, typename Policy>
+    template<typename U>
+    shared_ptr<T, Policy>::shared_ptr(const shared_ptr<U, Policy>& other, element_type* p) noexcept : ptr(p), cb(other.cb) {
+        if (cb) cb->add_shared();
+    }
+
+    template<typename T, typename Policy>
     template<typename U>
-    shared_ptr<T>::shared_ptr(const weak_ptr<U>& wptr) : ptr(wptr.ptr), cb(wptr.cb) {
-        if (wptr.use_count() == 0u) {
+    shared_ptr<T, Policy>::shared_ptr(shared_ptr<U, Policy>&& other, element_type* p) noexcept : ptr(p), cb(other.cb) {
+        other.ptr = nullptr;
+        other.cb = nullptr;
+    }
+
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    shared_ptr<T, Policy>::shared_ptr(const weak_ptr<U, Policy>& wptr) : ptr(wptr.ptr), cb(wptr.cb) {
+        if (!cb || !cb->add_shared_if_alive()) { // checking use_count() first would race with the last owner going away
             throw my::empty_weak_ptr_exception{};
         }
     }
 
 
 
-    template<typename T>
-    shared_ptr<T>& shared_ptr<T>::operator=(const shared_ptr& other) noexcept {
-        shared_ptr<T> new_ptr(other);
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>& shared_ptr<T, Policy>::operator=(const shared_ptr& other) noexcept {
+        shared_ptr new_ptr(other);
         swap(new_ptr);
         /*
         if (cb) {
@@ -373,9 +697,9 @@ namespace my {
         return *this;
     }
 
-    template<typename T>
-    shared_ptr<T>& shared_ptr<T>::operator=(shared_ptr&& other) noexcept {
-        shared_ptr<T> new_ptr(std::move(other));
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>& shared_ptr<T, Policy>::operator=(shared_ptr&& other) noexcept {
+        shared_ptr new_ptr(std::move(other));
         swap(new_ptr);
         /*
         if (cb) {
@@ -396,10 +720,10 @@ namespace my {
         return *this;
     }
 
-    template<typename T>
-    template<typename U>
-    shared_ptr<T>& shared_ptr<T>::operator=(const shared_ptr<U>& other) noexcept {
-        shared_ptr<T> new_ptr(other);
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    shared_ptr<T, Policy>& shared_ptr<T, Policy>::operator=(const shared_ptr<U, Policy>& other) noexcept {
+        shared_ptr new_ptr(other);
         swap(new_ptr);
         /*
         if (cb) {
@@ -417,10 +741,10 @@ namespace my {
         return *this;
     }
 
-    template<typename T>
-    template<typename U>
-    shared_ptr<T>& shared_ptr<T>::operator=(shared_ptr<U>&& other) noexcept {
-        shared_ptr<T> new_ptr(std::move(other));
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    shared_ptr<T, Policy>& shared_ptr<T, Policy>::operator=(shared_ptr<U, Policy>&& other) noexcept {
+        shared_ptr new_ptr(std::move(other));
         swap(new_ptr);
         /*if (cb) {
             if (cb->cnt_shared == 1u) {
@@ -439,25 +763,17 @@ namespace my {
         return *this;
     } 
 
-    template<typename T>
-    shared_ptr<T>::~shared_ptr() {
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>::~shared_ptr() {
         if (cb) {
-            if (--cb->cnt_shared == 0u) {
-
-                cb->destroy_object();
-                
-                if (cb->cnt_weak == 0u) {
-                    cb->delete_control_block();
-                }
-            
-            }
+            cb->release_shared(); // destroys the object and, if there're no weak_ptrs, the control block
         }
     }
 
 
-    template<typename T>
-    void shared_ptr<T>::reset() noexcept {
-        shared_ptr<T> new_ptr;
+    template<typename T, typename Policy>
+    void shared_ptr<T, Policy>::reset() noexcept {
+        shared_ptr new_ptr;
         swap(new_ptr);
         /*
         if (cb) {
@@ -472,10 +788,10 @@ namespace my {
         cb = nullptr;*/
     }
 
-    template<typename T>
-    template<typename U>
-    void shared_ptr<T>::reset(U* p) {
-        shared_ptr<T> new_ptr(p);
+    template<typename T, typename Policy>
+    template<typename U> requires sp_convertible_v<U, T>
+    void shared_ptr<T, Policy>::reset(U* p) {
+        shared_ptr new_ptr(p);
         swap(new_ptr);
         /*
         auto* new_cb = new Control_Block_Value(p);
@@ -491,10 +807,10 @@ namespace my {
         cb = new_cb;*/
     }
 
-    template<typename T>
-    template<typename U, typename Deleter>
-    void shared_ptr<T>::reset(U* p, const Deleter& del) {
-        shared_ptr<T> new_ptr(p,del);
+    template<typename T, typename Policy>
+    template<typename U, typename Deleter> requires sp_convertible_v<U, T>
+    void shared_ptr<T, Policy>::reset(U* p, const Deleter& del) {
+        shared_ptr new_ptr(p,del);
         swap(new_ptr);
         /*auto* new_cb = new Control_Block_Deleter(p,del);
         if (cb) {
@@ -510,83 +826,134 @@ namespace my {
         cb = new_cb;*/
     }
 
-    template<typename T>
-    template<typename U, typename Deleter, typename Alloc>
-    void shared_ptr<T>::reset(U* p, const Deleter& del, const Alloc& alloc) {
-        shared_ptr<T> new_ptr(p,del,alloc);
+    template<typename T, typename Policy>
+    template<typename U, typename Deleter, typename Alloc> requires sp_convertible_v<U, T>
+    void shared_ptr<T, Policy>::reset(U* p, const Deleter& del, const Alloc& alloc) {
+        shared_ptr new_ptr(p,del,alloc);
         swap(new_ptr);
     }
 
-    template<typename T>
-    void shared_ptr<T>::swap(shared_ptr& other) noexcept {
+    template<typename T, typename Policy>
+    void shared_ptr<T, Policy>::swap(shared_ptr& other) noexcept {
         std::swap(ptr, other.ptr);
         std::swap(cb, other.cb);
     }
 
-    template<typename T>
-    T& shared_ptr<T>::operator*() {
+    template<typename T, typename Policy>
+    typename shared_ptr<T, Policy>::element_type* shared_ptr<T, Policy>::get() noexcept {
+        return ptr;
+    }
+
+    template<typename T, typename Policy>
+    const typename shared_ptr<T, Policy>::element_type* shared_ptr<T, Policy>::get() const noexcept {
+        return ptr;
+    }
+
+    template<typename T, typename Policy>
+    T& shared_ptr<T, Policy>::operator*() requires (!std::is_array_v<T>) {
         return *ptr;
     }
 
-    template<typename T>
-    const T& shared_ptr<T>::operator*() const {
+    template<typename T, typename Policy>
+    const T& shared_ptr<T, Policy>::operator*() const requires (!std::is_array_v<T>) {
         return *ptr;
     }
 
-    template<typename T>
-    T* shared_ptr<T>::operator->() {
+    template<typename T, typename Policy>
+    T* shared_ptr<T, Policy>::operator->() requires (!std::is_array_v<T>) {
         return ptr;
     }
 
-    template<typename T>
-    const T* shared_ptr<T>::operator->() const {
+    template<typename T, typename Policy>
+    const T* shared_ptr<T, Policy>::operator->() const requires (!std::is_array_v<T>) {
         return ptr;
     }
 
-    template<typename T>
-    std::size_t shared_ptr<T>::use_count() const noexcept {
-        return cb->cnt_shared;
+    template<typename T, typename Policy>
+    typename shared_ptr<T, Policy>::element_type& shared_ptr<T, Policy>::operator[](std::ptrdiff_t idx) requires std::is_array_v<T> {
+        return ptr[idx];
     }
 
-    template<typename T>
-    bool shared_ptr<T>::unique() const noexcept {
-        return (cb && (cb->cnt_shared == 1u));
+    template<typename T, typename Policy>
+    const typename shared_ptr<T, Policy>::element_type& shared_ptr<T, Policy>::operator[](std::ptrdiff_t idx) const requires std::is_array_v<T> {
+        return ptr[idx];
     }
 
-    template<typename T>
-    shared_ptr<T>::operator bool() const noexcept {
+    template<typename T, typename Policy>
+    std::size_t shared_ptr<T, Policy>::use_count() const noexcept {
+        return cb ? cb->use_count() : 0u;
+    }
+
+    template<typename T, typename Policy>
+    bool shared_ptr<T, Policy>::unique() const noexcept {
+        return cb && cb->unique();
+    }
+
+    template<typename T, typename Policy>
+    shared_ptr<T, Policy>::operator bool() const noexcept {
         return ptr != nullptr;
     }
 
 
+    // make_shared/allocate_shared for any counting policy, e.g. atomic_policy32 for the most compact blocks.
+    // For arrays the arguments are (n[, value]) for T[] and ([value]) for T[N]; my::for_overwrite as the last one skips value-initialization
+    template<typename T, typename Policy, typename Alloc, typename... Args>
+    shared_ptr<T, Policy> allocate_shared_with_policy(const Alloc& alloc, Args&&... args) {
+        using sptr = shared_ptr<T, Policy>;
+        if constexpr (std::is_unbounded_array_v<T>) {
+            return sptr(typename sptr::allocate_array_tag{}, alloc, std::forward<Args>(args)...);
+        }
+        else if constexpr (std::is_bounded_array_v<T>) {
+            return sptr(typename sptr::allocate_array_tag{}, alloc, std::extent_v<T>, std::forward<Args>(args)...);
+        }
+        else {
+            return sptr(typename sptr::allocate_shared_tag{}, alloc, std::forward<Args>(args)...);
+        }
+    }
+
+    template<typename T, typename Policy, typename... Args>
+    shared_ptr<T, Policy> make_shared_with_policy(Args&&... args) {
+        if constexpr (std::is_array_v<T>) {
+            return allocate_shared_with_policy<T, Policy>(std::allocator<std::remove_extent_t<T>>{}, std::forward<Args>(args)...);
+        }
+        else {
+            return shared_ptr<T, Policy>(typename shared_ptr<T, Policy>::make_shared_tag{}, std::forward<Args>(args)...);
+        }
+    }
+
     template<typename T, typename... Args>
     shared_ptr<T> make_shared(Args&&... args) {
-        return shared_ptr<T>(std::forward<Args>(args)...);        
+        return make_shared_with_policy<T, atomic_policy>(std::forward<Args>(args)...);
     }
 
     template<typename T, typename Alloc, typename... Args>
     shared_ptr<T> allocate_shared(const Alloc& alloc, Args&&... args) {
-        return shared_ptr<T>(alloc, std::forward<Args>(args)...);        
+        return allocate_shared_with_policy<T, atomic_policy>(alloc, std::forward<Args>(args)...);
     }
 
-};
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+    // the object/elements are default-initialized: no zero-fill for buffers that are going to be overwritten anyway
+    template<typename T, typename... Args>
+    shared_ptr<T> make_shared_for_overwrite(Args&&... args) {
+        return make_shared_with_policy<T, atomic_policy>(std::forward<Args>(args)..., for_overwrite);
+    }
 
+    template<typename T, typename Alloc, typename... Args>
+    shared_ptr<T> allocate_shared_for_overwrite(const Alloc& alloc, Args&&... args) {
+        return allocate_shared_with_policy<T, atomic_policy>(alloc, std::forward<Args>(args)..., for_overwrite);
+    }
 
+    //the same for pointers that never leave their thread: plain counters instead of atomic ones
+    template<typename T>
+    using local_shared_ptr = shared_ptr<T, single_thread_policy>;
 
+    template<typename T, typename... Args>
+    shared_ptr<T, single_thread_policy> make_local_shared(Args&&... args) {
+        return make_shared_with_policy<T, single_thread_policy>(std::forward<Args>(args)...);
+    }
 
+    template<typename T, typename Alloc, typename... Args>
+    shared_ptr<T, single_thread_policy> allocate_local_shared(const Alloc& alloc, Args&&... args) {
+        return allocate_shared_with_policy<T, single_thread_policy>(alloc, std::forward<Args>(args)...);
+    }
 
+};
\ No newline at end of file
@@ -1,13 +1,20 @@
+#pragma once
+#include <cstddef>
 #include <memory>
 #include <type_traits>
+#include <utility>
+#include "../compressed_pair.h"
+#include "../uninitialized.h"
 
 namespace my {
     template<typename T, typename Deleter = std::default_delete<T>>
     class unique_ptr {
         
-        T* ptr;
-        Deleter del;
-        
+        my::compressed_pair<Deleter, T*> storage; // a stateless deleter takes no room: sizeof(unique_ptr<T>) == sizeof(T*)
+
+        T*& ptr() noexcept { return storage.second(); }
+        T* ptr() const noexcept { return storage.second(); }
+
     public:
         //constructors
         unique_ptr() noexcept(std::is_nothrow_default_constructible_v<Deleter>);
@@ -73,42 +80,38 @@ namespace my {
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::unique_ptr() 
         noexcept(std::is_nothrow_default_constructible_v<Deleter>) 
-        : ptr(nullptr) 
+        : storage(std::in_place, nullptr) 
     {}
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::unique_ptr(T* p) 
         noexcept(std::is_nothrow_default_constructible_v<Deleter>) 
-        : ptr(p) 
+        : storage(std::in_place, p) 
     {}
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::unique_ptr(T* p, const Deleter& d) 
         noexcept(std::is_nothrow_copy_constructible_v<Deleter>) 
-        : ptr(p), 
-        del(d) 
+        : storage(d, p) 
     {}
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::unique_ptr(T* p, Deleter&& d) 
         noexcept(std::is_nothrow_move_constructible_v<Deleter>) 
-        : ptr(p), 
-        del(std::move(d)) 
+        : storage(std::move(d), p) 
     {}
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::unique_ptr(unique_ptr&& other) 
         noexcept(std::is_nothrow_move_constructible_v<Deleter>) 
-        : ptr(other.release()), 
-        del(std::move(other.del)) 
+        : storage(std::move(other.get_deleter()), other.release()) 
     {}
 
     template<typename T, typename Deleter> 
     template<typename U, typename D>
     unique_ptr<T, Deleter>::unique_ptr(unique_ptr<U, D>&& other) 
         noexcept(std::is_nothrow_move_constructible_v<Deleter>) 
-        : ptr(other.release()), 
-        del(std::move(other.get_deleter()))
+        : storage(std::move(other.get_deleter()), other.release())
     {}
 
 
@@ -117,9 +120,9 @@ namespace my {
     template<typename T, typename Deleter>
     unique_ptr<T,Deleter>& unique_ptr<T,Deleter>::operator=(unique_ptr&& other) noexcept(std::is_nothrow_move_assignable_v<Deleter>) {
         //static_assert(std::is_nothrow_move_assignable_v<Deleter>); may be added to provide exception safety
-        if (other != *this) {
+        if (this != &other) {
             reset(other.release());
-            if (del != other.del) del = std::move(other.del);
+            get_deleter() = std::move(other.get_deleter());
         }
         return *this;
     }
@@ -128,7 +131,7 @@ namespace my {
     template<typename U, typename D>
     unique_ptr<T, Deleter>& unique_ptr<T,Deleter>::operator=(unique_ptr<U, D>&& other) noexcept(std::is_nothrow_move_assignable_v<Deleter>) {
             reset(other.release());
-            if (del != other.get_deleter()) del = std::move(other.del);
+            get_deleter() = std::move(other.get_deleter());
             return *this;
     }
 
@@ -136,7 +139,7 @@ namespace my {
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::~unique_ptr() {
-        if (ptr) del(ptr);
+        if (ptr()) get_deleter()(ptr());
     }
     
 
@@ -144,72 +147,70 @@ namespace my {
 
     template<typename T, typename Deleter>
     T* unique_ptr<T, Deleter>::release() noexcept {
-        T* value = ptr;
-        ptr = nullptr;
+        T* value = ptr();
+        ptr() = nullptr;
         return value;
     }
 
     template<typename T, typename Deleter>
     void unique_ptr<T, Deleter>::reset(T* p) noexcept {
-        if (ptr) {
-            del(ptr);
+        T* old = ptr();
+        ptr() = p; // first, so that a deleter that reaches back into this unique_ptr sees the new value
+        if (old) {
+            get_deleter()(old);
         }
-        ptr = p;
     }
 
     template<typename T, typename Deleter>
     void unique_ptr<T, Deleter>::swap(unique_ptr& other) noexcept(std::is_nothrow_swappable_v<Deleter>) {
-        std::swap(ptr, other.ptr);
-        if (del != other.del) {
-            std::swap(del, other.del);
-        }
+        storage.swap(other.storage);
     } 
 
     //observers
 
     template<typename T, typename Deleter>
     T* unique_ptr<T, Deleter>::get() noexcept {
-        return ptr;
+        return ptr();
     }
 
     template<typename T, typename Deleter>
     const T* unique_ptr<T, Deleter>::get() const noexcept {
-        return ptr;
+        return ptr();
     }
 
     template<typename T, typename Deleter>
     Deleter& unique_ptr<T, Deleter>::get_deleter() noexcept {
-        return del;
+        return storage.first();
     }
     
     template<typename T, typename Deleter>
     const Deleter& unique_ptr<T, Deleter>::get_deleter() const noexcept {
-        return del;
+        return storage.first();
     }
 
     template<typename T, typename Deleter>
     unique_ptr<T, Deleter>::operator bool() const noexcept {
-        return (ptr != nullptr);
+        return (ptr() != nullptr);
     }
 
     template<typename T, typename Deleter>
     T& unique_ptr<T, Deleter>::operator*() {
-        return *ptr;
+        return *ptr();
     }
 
     template<typename T, typename Deleter>
     const T& unique_ptr<T, Deleter>::operator*() const {
-        return *ptr;
+        return *ptr();
     }
     
     template<typename T, typename Deleter>
     T* unique_ptr<T, Deleter>::operator->() {
-        return ptr;
+        return ptr();
     }
 
     template<typename T, typename Deleter>
     const T* unique_ptr<T, Deleter>::operator->() const {
-        return ptr;
+        return ptr();
     }
 
 
@@ -217,51 +218,357 @@ namespace my {
 
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator==(const unique_ptr& other) const noexcept {
-        return (ptr == other.ptr);
+        return (ptr() == other.ptr());
     }
     
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator!=(const unique_ptr& other) const noexcept {
-        return (ptr != other.ptr);
+        return (ptr() != other.ptr());
     }
 
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator>(const unique_ptr& other) const noexcept {
-        return (ptr > other.ptr);
+        return (ptr() > other.ptr());
     }
 
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator<(const unique_ptr& other) const noexcept {
-        return (ptr < other.ptr);
+        return (ptr() < other.ptr());
     }
 
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator>=(const unique_ptr& other) const noexcept {
-        return (ptr >= other.ptr);
+        return (ptr() >= other.ptr());
     }
 
     template<typename T, typename Deleter>
     bool unique_ptr<T, Deleter>::operator<=(const unique_ptr& other) const noexcept {
-        return (ptr <= other.ptr);
+        return (ptr() <= other.ptr());
     }
 
+    // unique_ptr<T[]>: the same, but released with delete[] (std::default_delete<T[]>) and indexed instead of dereferenced.
+    // No conversions from unique_ptr<Derived[]>: pointer arithmetic on Base* over an array of Derived is broken anyway
+    template<typename T, typename Deleter>
+    class unique_ptr<T[], Deleter> {
+
+        my::compressed_pair<Deleter, T*> storage;
+
+        T*& ptr() noexcept { return storage.second(); }
+        T* ptr() const noexcept { return storage.second(); }
+
+    public:
+        //constructors
+        unique_ptr() noexcept(std::is_nothrow_default_constructible_v<Deleter>);
+
+        explicit unique_ptr(T* p) noexcept(std::is_nothrow_default_constructible_v<Deleter>);
+
+        unique_ptr(T* p, const Deleter& d) noexcept(std::is_nothrow_copy_constructible_v<Deleter>);
+
+        unique_ptr(T* p, Deleter&& d) noexcept(std::is_nothrow_move_constructible_v<Deleter>);
+
+        unique_ptr(const unique_ptr& other) = delete;
+
+        unique_ptr(unique_ptr&& other) noexcept(std::is_nothrow_move_constructible_v<Deleter>);
+
+        //assignment operators
+        unique_ptr& operator=(const unique_ptr& other) = delete;
+
+        unique_ptr& operator=(unique_ptr&& other) noexcept(std::is_nothrow_move_assignable_v<Deleter>);
+
+        //modifiers
+        T* release() noexcept;
+        void reset(T* p = nullptr) noexcept;
+        void swap(unique_ptr& other) noexcept(std::is_nothrow_swappable_v<Deleter>);
+
+        //observers
+        T* get() noexcept;
+        const T* get() const noexcept;
+
+        Deleter& get_deleter() noexcept;
+        const Deleter& get_deleter() const noexcept;
+
+        operator bool() const noexcept;
+
+        T& operator[](std::size_t i);
+        const T& operator[](std::size_t i) const;
+
+        //comparison operators
+        bool operator==(const unique_ptr& other) const noexcept;
+        bool operator!=(const unique_ptr& other) const noexcept;
+
+        //destructor
+        ~unique_ptr();
+    };
+
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::unique_ptr()
+        noexcept(std::is_nothrow_default_constructible_v<Deleter>)
+        : storage(std::in_place, nullptr)
+    {}
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::unique_ptr(T* p)
+        noexcept(std::is_nothrow_default_constructible_v<Deleter>)
+        : storage(std::in_place, p)
+    {}
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::unique_ptr(T* p, const Deleter& d)
+        noexcept(std::is_nothrow_copy_constructible_v<Deleter>)
+        : storage(d, p)
+    {}
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::unique_ptr(T* p, Deleter&& d)
+        noexcept(std::is_nothrow_move_constructible_v<Deleter>)
+        : storage(std::move(d), p)
+    {}
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::unique_ptr(unique_ptr&& other)
+        noexcept(std::is_nothrow_move_constructible_v<Deleter>)
+        : storage(std::move(other.get_deleter()), other.release())
+    {}
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>& unique_ptr<T[], Deleter>::operator=(unique_ptr&& other) noexcept(std::is_nothrow_move_assignable_v<Deleter>) {
+        if (this != &other) {
+            reset(other.release());
+            get_deleter() = std::move(other.get_deleter());
+        }
+        return *this;
+    }
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::~unique_ptr() {
+        if (ptr()) get_deleter()(ptr());
+    }
+
+    template<typename T, typename Deleter>
+    T* unique_ptr<T[], Deleter>::release() noexcept {
+        T* value = ptr();
+        ptr() = nullptr;
+        return value;
+    }
+
+    template<typename T, typename Deleter>
+    void unique_ptr<T[], Deleter>::reset(T* p) noexcept {
+        T* old = ptr();
+        ptr() = p;
+        if (old) {
+            get_deleter()(old);
+        }
+    }
+
+    template<typename T, typename Deleter>
+    void unique_ptr<T[], Deleter>::swap(unique_ptr& other) noexcept(std::is_nothrow_swappable_v<Deleter>) {
+        storage.swap(other.storage);
+    }
+
+    template<typename T, typename Deleter>
+    T* unique_ptr<T[], Deleter>::get() noexcept {
+        return ptr();
+    }
+
+    template<typename T, typename Deleter>
+    const T* unique_ptr<T[], Deleter>::get() const noexcept {
+        return ptr();
+    }
+
+    template<typename T, typename Deleter>
+    Deleter& unique_ptr<T[], Deleter>::get_deleter() noexcept {
+        return storage.first();
+    }
+
+    template<typename T, typename Deleter>
+    const Deleter& unique_ptr<T[], Deleter>::get_deleter() const noexcept {
+        return storage.first();
+    }
+
+    template<typename T, typename Deleter>
+    unique_ptr<T[], Deleter>::operator bool() const noexcept {
+        return (ptr() != nullptr);
+    }
+
+    template<typename T, typename Deleter>
+    T& unique_ptr<T[], Deleter>::operator[](std::size_t i) {
+        return ptr()[i];
+    }
+
+    template<typename T, typename Deleter>
+    const T& unique_ptr<T[], Deleter>::operator[](std::size_t i) const {
+        return ptr()[i];
+    }
+
+    template<typename T, typename Deleter>
+    bool unique_ptr<T[], Deleter>::operator==(const unique_ptr& other) const noexcept {
+        return (ptr() == other.ptr());
+    }
+
+    template<typename T, typename Deleter>
+    bool unique_ptr<T[], Deleter>::operator!=(const unique_ptr& other) const noexcept {
+        return (ptr() != other.ptr());
+    }
+
+
     //we don't need a custom deleter, because an object is constructed within this function using standard methods(calls 'new' operator)
-    template<typename T, typename... Args>
+    template<typename T, typename... Args> requires (!std::is_array_v<T>)
     unique_ptr<T> make_unique(Args&&... args) {
         T* ptr = new T(std::forward<Args>(args)...);
         return unique_ptr<T>(ptr);
     }
 
-};
+    // n value-initialized elements: zeroes for scalars
+    template<typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique(std::size_t num_of_elem) {
+        return unique_ptr<T>(new std::remove_extent_t<T>[num_of_elem]());
+    }
+
+    template<typename T, typename... Args> requires std::is_bounded_array_v<T>
+    void make_unique(Args&&...) = delete;
+
+    // default-initialized: trivial types keep whatever the memory holds, for buffers that are about to be filled anyway
+    template<typename T> requires (!std::is_array_v<T>)
+    unique_ptr<T> make_unique_for_overwrite() {
+        return unique_ptr<T>(new T);
+    }
+
+    template<typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique_for_overwrite(std::size_t num_of_elem) {
+        return unique_ptr<T>(new std::remove_extent_t<T>[num_of_elem]);
+    }
+
+    template<typename T, typename... Args> requires std::is_bounded_array_v<T>
+    void make_unique_for_overwrite(Args&&...) = delete;
 
 
+    // The deleter of allocate_unique: destroys and deallocates through my::allocator_traits, so the memory goes back
+    // to the arena/pool it came from. The allocator is an (empty) base, with std::allocator the unique_ptr stays one pointer.
+    // For T[] the element count is kept too, allocators need it back in deallocate()
+    template<typename T, typename Alloc>
+    class allocator_delete : private my::compressed_pair_elem<typename my::allocator_traits<Alloc>::template rebind_alloc<T>, 0> {
 
+        using alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<T>;
+        using traits = my::allocator_traits<alloc_type>;
+        using base = my::compressed_pair_elem<alloc_type, 0>;
 
+        static_assert(std::is_same_v<typename traits::pointer, T*>, "allocators with fancy pointers are not supported");
 
+    public:
+        allocator_delete() = default;
 
+        explicit allocator_delete(const alloc_type& alloc) : base(alloc) {}
 
+        alloc_type& get_allocator() noexcept { return base::get(); }
 
+        void operator()(T* p) noexcept {
+            traits::destroy(get_allocator(), p);
+            traits::deallocate(get_allocator(), p, 1);
+        }
+    };
 
+    template<typename T, typename Alloc>
+    class allocator_delete<T[], Alloc> {
 
+        using alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<T>;
+        using traits = my::allocator_traits<alloc_type>;
 
+        static_assert(std::is_same_v<typename traits::pointer, T*>, "allocators with fancy pointers are not supported");
+
+        my::compressed_pair<alloc_type, std::size_t> alloc_and_size;
+
+    public:
+        allocator_delete() : alloc_and_size(std::in_place, 0) {}
+
+        allocator_delete(const alloc_type& alloc, std::size_t num_of_elem) : alloc_and_size(alloc, num_of_elem) {}
+
+        alloc_type& get_allocator() noexcept { return alloc_and_size.first(); }
+
+        std::size_t size() const noexcept { return alloc_and_size.second(); }
+
+        void operator()(T* p) noexcept {
+            my::destroy_n(get_allocator(), p, size());
+            traits::deallocate(get_allocator(), p, size());
+        }
+    };
 
+
+    namespace unique_ptr_detail {
+
+        // allocates one T from 'alloc' and builds it with 'construct'; the memory goes back if that throws
+        template<typename T, typename Alloc, typename Construct>
+        unique_ptr<T, allocator_delete<T, Alloc>> allocate_unique_with(const Alloc& alloc, Construct construct) {
+            using deleter = allocator_delete<T, Alloc>;
+            using alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<T>;
+            using traits = my::allocator_traits<alloc_type>;
+
+            alloc_type rebound(alloc);
+            T* p = traits::allocate(rebound, 1);
+            try {
+                construct(rebound, p);
+            }
+            catch(...) {
+                traits::deallocate(rebound, p, 1);
+                throw;
+            }
+            return unique_ptr<T, deleter>(p, deleter(rebound));
+        }
+
+        template<typename T, typename Alloc, typename Construct>
+        unique_ptr<T[], allocator_delete<T[], Alloc>> allocate_unique_array_with(const Alloc& alloc, std::size_t num_of_elem, Construct construct) {
+            using deleter = allocator_delete<T[], Alloc>;
+            using alloc_type = typename my::allocator_traits<Alloc>::template rebind_alloc<T>;
+            using traits = my::allocator_traits<alloc_type>;
+
+            alloc_type rebound(alloc);
+            T* p = traits::allocate(rebound, num_of_elem);
+            try {
+                construct(rebound, p, num_of_elem); // the my::uninitialized_* algorithms clean up after themselves
+            }
+            catch(...) {
+                traits::deallocate(rebound, p, num_of_elem);
+                throw;
+            }
+            return unique_ptr<T[], deleter>(p, deleter(rebound, num_of_elem));
+        }
+
+    };
+
+    // make_unique with the memory coming from 'alloc' (rebound to T), constructed with allocator_traits::construct
+    template<typename T, typename Alloc, typename... Args> requires (!std::is_array_v<T>)
+    unique_ptr<T, allocator_delete<T, Alloc>> allocate_unique(const Alloc& alloc, Args&&... args) {
+        return unique_ptr_detail::allocate_unique_with<T>(alloc, [&](auto& a, T* p) {
+            my::allocator_traits<std::remove_reference_t<decltype(a)>>::construct(a, p, std::forward<Args>(args)...);
+        });
+    }
+
+    template<typename T, typename Alloc> requires std::is_unbounded_array_v<T>
+    unique_ptr<T, allocator_delete<T, Alloc>> allocate_unique(const Alloc& alloc, std::size_t num_of_elem) {
+        return unique_ptr_detail::allocate_unique_array_with<std::remove_extent_t<T>>(alloc, num_of_elem, [](auto& a, auto* p, std::size_t n) {
+            my::uninitialized_value_construct(a, p, n);
+        });
+    }
+
+    // no value-initialization, same as make_unique_for_overwrite: an arena buffer that is about to be filled costs no memset
+    template<typename T, typename Alloc> requires (!std::is_array_v<T>)
+    unique_ptr<T, allocator_delete<T, Alloc>> allocate_unique_for_overwrite(const Alloc& alloc) {
+        return unique_ptr_detail::allocate_unique_with<T>(alloc, [](auto&, T* p) {
+            ::new(static_cast<void*>(p)) T;
+        });
+    }
+
+    template<typename T, typename Alloc> requires std::is_unbounded_array_v<T>
+    unique_ptr<T, allocator_delete<T, Alloc>> allocate_unique_for_overwrite(const Alloc& alloc, std::size_t num_of_elem) {
+        return unique_ptr_detail::allocate_unique_array_with<std::remove_extent_t<T>>(alloc, num_of_elem, [](auto& a, auto* p, std::size_t n) {
+            my::uninitialized_default_construct(a, p, n);
+        });
+    }
+
+
+    static_assert(sizeof(unique_ptr<int>) == sizeof(int*), "unique_ptr with a stateless deleter must fit in a register");
+    static_assert(sizeof(unique_ptr<int, void(*)(int*)>) == 2 * sizeof(void*));
+    static_assert(sizeof(unique_ptr<int[]>) == sizeof(int*));
+    static_assert(sizeof(unique_ptr<int, allocator_delete<int, std::allocator<int>>>) == sizeof(int*));
+
+};
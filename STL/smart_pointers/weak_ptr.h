@@ -1,45 +1,52 @@
+#pragma once
 #include "shared_ptr.h"
 
 namespace my {
 
-    template<typename T>
+    template<typename T, typename Policy>
     class weak_ptr {
 
-        T* ptr;
-        typename my::shared_ptr<T>::Control_Block* cb;
+        template<typename U, typename P>
+        friend class my::shared_ptr;
+
+        template<typename U, typename P>
+        friend class my::weak_ptr;
+
+        std::remove_extent_t<T>* ptr;
+        my::Control_Block<Policy>* cb;
     
     public:
         weak_ptr() noexcept;
         
-        template<typename U>
-        weak_ptr(const shared_ptr<U>& sptr) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr(const shared_ptr<U, Policy>& sptr) noexcept;
         
         weak_ptr(const weak_ptr& other) noexcept;
         
         weak_ptr(weak_ptr&& other) noexcept;
         
-        template<typename U>
-        weak_ptr(const weak_ptr<U>& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr(const weak_ptr<U, Policy>& other) noexcept;
 
-        template<typename U>
-        weak_ptr(weak_ptr<U>&& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr(weak_ptr<U, Policy>&& other) noexcept;
 
         ~weak_ptr();
 
         //assignment operators
 
-        template<typename U>
-        weak_ptr& operator=(const shared_ptr<U>& sptr) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr& operator=(const shared_ptr<U, Policy>& sptr) noexcept;
         
         weak_ptr& operator=(const weak_ptr& other) noexcept;
         
         weak_ptr& operator=(weak_ptr&& other) noexcept;
         
-        template<typename U>
-        weak_ptr& operator=(const weak_ptr<U>& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr& operator=(const weak_ptr<U, Policy>& other) noexcept;
 
-        template<typename U>
-        weak_ptr& operator=(weak_ptr<U>&& other) noexcept;
+        template<typename U> requires sp_compatible_v<U, T>
+        weak_ptr& operator=(weak_ptr<U, Policy>&& other) noexcept;
 
          //modifiers
         
@@ -53,87 +60,83 @@ namespace my {
 
         bool expired() const noexcept;
 
-        my::shared_ptr<T> lock() const noexcept;
+        my::shared_ptr<T, Policy> lock() const noexcept;
     
     };
 
 
-    template<typename T>
-    weak_ptr<T>::weak_ptr() noexcept : ptr(nullptr), cb(nullptr) {}
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>::weak_ptr() noexcept : ptr(nullptr), cb(nullptr) {}
 
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>::weak_ptr(const shared_ptr<U>& sptr) noexcept : ptr(sptr.ptr), cb(ptr.cb) {
-        if (cb) ++cb->cnt_weak;
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>::weak_ptr(const shared_ptr<U, Policy>& sptr) noexcept : ptr(sptr.ptr), cb(sptr.cb) {
+        if (cb) cb->add_weak();
     }
 
-    template<typename T>
-    weak_ptr<T>::weak_ptr(const weak_ptr& other) noexcept : ptr(other.ptr), cb(other.cb) {
-        if (cb) ++cb->cnt_weak;
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>::weak_ptr(const weak_ptr& other) noexcept : ptr(other.ptr), cb(other.cb) {
+        if (cb) cb->add_weak();
     }
 
-    template<typename T>
-    weak_ptr<T>::weak_ptr(weak_ptr&& other) noexcept : ptr(other.ptr), cb(other.cb) {
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>::weak_ptr(weak_ptr&& other) noexcept : ptr(other.ptr), cb(other.cb) {
         other.ptr = nullptr;
         other.cb = nullptr;
     }
 
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>::weak_ptr(const weak_ptr<U>& other) noexcept : weak_ptr(other.lock()) {}
+    // U* -> T* may need to adjust the pointer, which can be done only while the object is alive
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>::weak_ptr(const weak_ptr<U, Policy>& other) noexcept : weak_ptr(other.lock()) {}
 
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>::weak_ptr(weak_ptr<U>&& other) noexcept : weak_ptr(other.lock()) {
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>::weak_ptr(weak_ptr<U, Policy>&& other) noexcept : weak_ptr(other.lock()) {
         other.reset();
     }
 
-    template<typename T>
-    weak_ptr<T>::~weak_ptr() {
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>::~weak_ptr() {
         if (cb) {
-            if ((cb->cnt_shared == 0u) && (cb->cnt_weak == 1u)) {
-                cb->delete_control_block();
-            }
-            else {
-                --cb->cnt_weak;
-            }
+            cb->release_weak(); // the block goes away with the last weak reference, the shared owners count as one
         }
     }
 
     
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>& weak_ptr<T>::operator=(const shared_ptr<U>& sptr) noexcept {
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>& weak_ptr<T, Policy>::operator=(const shared_ptr<U, Policy>& sptr) noexcept {
         weak_ptr new_weak_ptr(sptr);
         swap(new_weak_ptr);
         return *this;
     }
 
-    template<typename T>
-    weak_ptr<T>& weak_ptr<T>::operator=(const weak_ptr& other) noexcept {
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>& weak_ptr<T, Policy>::operator=(const weak_ptr& other) noexcept {
         weak_ptr new_weak_ptr(other);
         swap(new_weak_ptr);
         return *this;
     }
 
-    template<typename T>
-    weak_ptr<T>& weak_ptr<T>::operator=(weak_ptr&& other) noexcept {
+    template<typename T, typename Policy>
+    weak_ptr<T, Policy>& weak_ptr<T, Policy>::operator=(weak_ptr&& other) noexcept {
         weak_ptr new_weak_ptr(std::move(other));
         swap(new_weak_ptr);
         return *this;
     }
 
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>& weak_ptr<T>::operator=(const weak_ptr<U>& other) noexcept {
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>& weak_ptr<T, Policy>::operator=(const weak_ptr<U, Policy>& other) noexcept {
         weak_ptr new_weak_ptr(other);
         swap(new_weak_ptr);
         return *this;
     }
 
-    template<typename T>
-    template<typename U>
-    weak_ptr<T>& weak_ptr<T>::operator=(weak_ptr<U>&& other) noexcept {
+    template<typename T, typename Policy>
+    template<typename U> requires sp_compatible_v<U, T>
+    weak_ptr<T, Policy>& weak_ptr<T, Policy>::operator=(weak_ptr<U, Policy>&& other) noexcept {
         weak_ptr new_weak_ptr(std::move(other));
         swap(new_weak_ptr);
         return *this;
@@ -142,50 +145,40 @@ namespace my {
 
      //modifiers
         
-    template<typename T>
-    void weak_ptr<T>::reset() noexcept {
+    template<typename T, typename Policy>
+    void weak_ptr<T, Policy>::reset() noexcept {
         weak_ptr new_weak_ptr;
         swap(new_weak_ptr);
     }
 
-    template<typename T>
-    void weak_ptr<T>::swap(weak_ptr& other) noexcept {
+    template<typename T, typename Policy>
+    void weak_ptr<T, Policy>::swap(weak_ptr& other) noexcept {
         std::swap(ptr, other.ptr);
         std::swap(cb, other.cb);
     }
 
     //observers
 
-    template<typename T>
-    std::size_t weak_ptr<T>::use_count() const noexcept {
-        return cb ? cb->cnt_shared : 0;
+    template<typename T, typename Policy>
+    std::size_t weak_ptr<T, Policy>::use_count() const noexcept {
+        return cb ? cb->use_count() : 0u;
     }
 
-    template<typename T>
-    bool weak_ptr<T>::expired() const noexcept {
+    template<typename T, typename Policy>
+    bool weak_ptr<T, Policy>::expired() const noexcept {
         return use_count() == 0;
     }
 
-    template<typename T>
-    my::shared_ptr<T> weak_ptr<T>::lock() const noexcept {
-        return expired()? shared_ptr<T>() : shared_ptr<T>(*this);
+    // expired() followed by a copy would race with the last shared_ptr going away in another thread,
+    // so the shared count is bumped only if it's still not zero, in one atomic step
+    template<typename T, typename Policy>
+    my::shared_ptr<T, Policy> weak_ptr<T, Policy>::lock() const noexcept {
+        my::shared_ptr<T, Policy> result;
+        if (cb && cb->add_shared_if_alive()) {
+            result.ptr = ptr;
+            result.cb = cb;
+        }
+        return result;
     }
 
 };
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
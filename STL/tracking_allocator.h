@@ -0,0 +1,308 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "alloc_traits.h"
+
+namespace my {
+
+    // aggregated statistics of one allocation site, produced by tracking_registry::snapshot()
+    struct allocation_report {
+
+        static constexpr std::size_t histogram_size = 65; // bucket i counts requests of [2^(i-1), 2^i) bytes, bucket 0 - zero-sized ones
+
+        std::string label;
+        std::size_t allocations = 0;
+        std::size_t deallocations = 0;
+        std::size_t total_bytes = 0;
+        std::size_t live_bytes = 0;
+        std::size_t peak_bytes = 0;
+        std::array<std::size_t, histogram_size> histogram{};
+    };
+
+
+    class tracking_registry {
+
+        // every thread gets its own block per site, so the hot path never writes to a shared cache line
+        // only the owning thread writes to it, the atomics are here just to let snapshot() read it safely
+        struct thread_counters {
+            std::atomic<std::size_t> allocations{0};
+            std::atomic<std::size_t> deallocations{0};
+            std::atomic<std::size_t> bytes_allocated{0};
+            std::atomic<std::size_t> bytes_deallocated{0};
+            std::array<std::atomic<std::size_t>, allocation_report::histogram_size> histogram{};
+
+            static void bump(std::atomic<std::size_t>& counter, std::size_t value, bool single_writer) noexcept {
+                if (single_writer) {
+                    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); // no need in a locked RMW
+                }
+                else {
+                    counter.fetch_add(value, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        // the thread's counter blocks by site id; once it's destroyed, deallocations from other thread_locals' destructors
+        // go to the shared block
+        struct thread_cache {
+            std::vector<thread_counters*> by_site;
+
+            ~thread_cache() {
+                this_thread_done() = true;
+            }
+        };
+
+    public:
+
+        class site {
+
+            friend class tracking_registry;
+
+            std::string label;
+            std::size_t id;
+            std::atomic<std::size_t> live_bytes{0}; // the peak cannot be restored from per-thread counters, hence these two are shared
+            std::atomic<std::size_t> peak_bytes{0};
+            std::vector<std::unique_ptr<thread_counters>> counters; // guarded by the registry mutex
+            thread_counters shared; // for threads that couldn't get a block of their own, updated with locked RMWs
+
+            explicit site(std::string label, std::size_t id) : label(std::move(label)), id(id) {}
+
+        public:
+
+            const std::string& name() const noexcept {
+                return label;
+            }
+
+            void on_allocate(std::size_t bytes) noexcept;
+
+            void on_deallocate(std::size_t bytes) noexcept;
+        };
+
+        static site* find_or_create(std::string_view label);
+
+        static site* find_or_create(const std::source_location& loc);
+
+        static std::vector<allocation_report> snapshot();
+
+        static void dump(std::ostream& out);
+
+    private:
+
+        static std::mutex& registry_mutex() {
+            static std::mutex m;
+            return m;
+        }
+
+        static std::map<std::string, std::unique_ptr<site>, std::less<>>& sites() {
+            static std::map<std::string, std::unique_ptr<site>, std::less<>> s; // sites are never removed, so the pointers handed out stay valid
+            return s;
+        }
+
+        static bool& this_thread_done() noexcept;
+
+        // null if the thread has no block for the site and can't get one: out of memory, or past its thread_local destructors
+        static thread_counters* local_counters(site& s) noexcept;
+    };
+
+
+    inline tracking_registry::site* tracking_registry::find_or_create(std::string_view label) {
+        std::lock_guard lg(registry_mutex());
+        auto& all = sites();
+        auto it = all.find(label);
+        if (it == all.end()) {
+            std::string key(label);
+            it = all.emplace(key, std::unique_ptr<site>(new site(key, all.size()))).first;
+        }
+        return it->second.get();
+    }
+
+    inline tracking_registry::site* tracking_registry::find_or_create(const std::source_location& loc) {
+        std::string label = std::string(loc.file_name()) + ':' + std::to_string(loc.line()) + " (" + loc.function_name() + ')';
+        return find_or_create(label);
+    }
+
+    inline bool& tracking_registry::this_thread_done() noexcept {
+        static thread_local bool done = false; // trivially destructible, so still readable while thread_locals are destroyed
+        return done;
+    }
+
+    inline tracking_registry::thread_counters* tracking_registry::local_counters(site& s) noexcept {
+        if (this_thread_done()) return nullptr;
+        thread_local thread_cache cache;
+        if (s.id < cache.by_site.size() && cache.by_site[s.id]) {
+            return cache.by_site[s.id];
+        }
+        // slow path: first allocation of this thread on this site. It allocates itself, and deallocate() can't throw
+        try {
+            std::lock_guard lg(registry_mutex());
+            if (cache.by_site.size() <= s.id) {
+                cache.by_site.resize(s.id + 1, nullptr);
+            }
+            s.counters.push_back(std::make_unique<thread_counters>()); // outlives the thread, so its numbers stay in the report
+            cache.by_site[s.id] = s.counters.back().get();
+            return cache.by_site[s.id];
+        }
+        catch (...) {
+            return nullptr;
+        }
+    }
+
+    inline void tracking_registry::site::on_allocate(std::size_t bytes) noexcept {
+        thread_counters* mine = local_counters(*this);
+        thread_counters& c = mine ? *mine : shared;
+        thread_counters::bump(c.allocations, 1, mine != nullptr);
+        thread_counters::bump(c.bytes_allocated, bytes, mine != nullptr);
+        thread_counters::bump(c.histogram[std::bit_width(bytes)], 1, mine != nullptr);
+
+        std::size_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        std::size_t peak = peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    inline void tracking_registry::site::on_deallocate(std::size_t bytes) noexcept {
+        thread_counters* mine = local_counters(*this);
+        thread_counters& c = mine ? *mine : shared;
+        thread_counters::bump(c.deallocations, 1, mine != nullptr);
+        thread_counters::bump(c.bytes_deallocated, bytes, mine != nullptr);
+        live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    inline std::vector<allocation_report> tracking_registry::snapshot() {
+        std::vector<allocation_report> result;
+        std::lock_guard lg(registry_mutex());
+        for (const auto& [key, s] : sites()) {
+            allocation_report r;
+            r.label = s->label;
+            auto add = [&r](const thread_counters& c) {
+                r.allocations += c.allocations.load(std::memory_order_relaxed);
+                r.deallocations += c.deallocations.load(std::memory_order_relaxed);
+                r.total_bytes += c.bytes_allocated.load(std::memory_order_relaxed);
+                for (std::size_t i = 0; i != allocation_report::histogram_size; ++i) {
+                    r.histogram[i] += c.histogram[i].load(std::memory_order_relaxed);
+                }
+            };
+            for (const auto& c : s->counters) {
+                add(*c);
+            }
+            add(s->shared);
+            r.live_bytes = s->live_bytes.load(std::memory_order_relaxed);
+            r.peak_bytes = s->peak_bytes.load(std::memory_order_relaxed);
+            result.push_back(std::move(r));
+        }
+        return result;
+    }
+
+    inline void tracking_registry::dump(std::ostream& out) {
+        for (const allocation_report& r : snapshot()) {
+            out << r.label << '\n'
+                << "    allocations: " << r.allocations << ", deallocations: " << r.deallocations << '\n'
+                << "    total bytes: " << r.total_bytes << ", live bytes: " << r.live_bytes << ", peak bytes: " << r.peak_bytes << '\n'
+                << "    sizes:";
+            for (std::size_t i = 0; i != allocation_report::histogram_size; ++i) {
+                if (r.histogram[i] == 0) continue;
+                std::size_t upper = i == 0 ? 0 : (i == 64 ? ~std::size_t(0) : (std::size_t(1) << i) - 1);
+                out << " <=" << upper << ':' << r.histogram[i];
+            }
+            out << '\n';
+        }
+    }
+
+
+    // wraps any allocator and reports every allocate/deallocate to the site it was created at
+    // NB: pass the allocator explicitly where a container is created, a defaulted Alloc() argument
+    // inside the container would make all of them share the container's own line
+    template<typename Alloc>
+    class tracking_allocator {
+
+        template<typename AAlloc>
+        friend class tracking_allocator;
+
+        using traits = my::allocator_traits<Alloc>;
+
+        Alloc alloc;
+        tracking_registry::site* site;
+
+    public:
+        using value_type = typename traits::value_type;
+        using size_type = typename traits::size_type;
+        using difference_type = typename traits::difference_type;
+        using propagate_on_container_copy_assignment = typename traits::propagate_on_container_copy_assignment;
+        using propagate_on_container_move_assignment = typename traits::propagate_on_container_move_assignment;
+        using propagate_on_container_swap = typename traits::propagate_on_container_swap;
+        using is_always_equal = typename traits::is_always_equal; // the site is only accounting, memory can be freed through any of the copies
+
+        static constexpr std::size_t alignment = traits::alignment;
+
+        template<typename U>
+        struct rebind {
+            using other = tracking_allocator<typename traits::template rebind_alloc<U>>;
+        };
+
+        tracking_allocator(std::source_location loc = std::source_location::current())
+            : alloc(),
+            site(tracking_registry::find_or_create(loc))
+        {}
+
+        explicit tracking_allocator(const Alloc& alloc, std::source_location loc = std::source_location::current())
+            : alloc(alloc),
+            site(tracking_registry::find_or_create(loc))
+        {}
+
+        explicit tracking_allocator(std::string_view label, const Alloc& alloc = Alloc())
+            : alloc(alloc),
+            site(tracking_registry::find_or_create(label))
+        {}
+
+        template<typename AAlloc>
+        tracking_allocator(const tracking_allocator<AAlloc>& other) noexcept
+            : alloc(other.alloc),
+            site(other.site)
+        {}
+
+        value_type* allocate(std::size_t num_of_elem) {
+            value_type* p = traits::allocate(alloc, num_of_elem);
+            site->on_allocate(num_of_elem * sizeof(value_type));
+            return p;
+        }
+
+        void deallocate(value_type* p, std::size_t num_of_elem) noexcept {
+            if (!p) return; // containers like my::vector release their null buffer unconditionally
+            site->on_deallocate(num_of_elem * sizeof(value_type));
+            traits::deallocate(alloc, p, num_of_elem);
+        }
+
+        tracking_allocator select_on_container_copy_construction() const {
+            tracking_allocator copy(*this);
+            copy.alloc = traits::select_on_container_copy_construction(alloc);
+            return copy;
+        }
+
+        std::size_t max_size() const noexcept {
+            return traits::max_size(alloc);
+        }
+
+        const Alloc& underlying() const noexcept {
+            return alloc;
+        }
+
+        const std::string& label() const noexcept {
+            return site->name();
+        }
+
+        template<typename AAlloc>
+        bool operator==(const tracking_allocator<AAlloc>& other) const noexcept {
+            return alloc == other.alloc;
+        }
+    };
+
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "alloc_traits.h"
+
+namespace my {
+
+    // Algorithms over raw (not yet constructed) memory that go through my::allocator_traits.
+    // Every function either constructs the whole range or, if an element throws, destroys what it has
+    // already built and rethrows - the caller only has to give the memory back.
+    // When the element type is trivially copyable and the allocator doesn't customize construct/destroy,
+    // the loops are replaced with memcpy/memmove/memset at compile time.
+
+    template<typename Alloc, typename T, typename... Args>
+    constexpr bool is_bitwise_constructible_v = std::is_trivially_copyable_v<T> && !my::allocator_traits<Alloc>::template has_custom_construct<T, Args...>;
+
+    template<typename Alloc, typename T>
+    constexpr bool is_trivially_destructible_by_v = std::is_trivially_destructible_v<T> && !my::allocator_traits<Alloc>::template has_custom_destroy<T>;
+
+
+    template<typename Alloc, typename T>
+    void destroy_n(Alloc& alloc, T* first, std::size_t num_of_elem) noexcept {
+        if constexpr (!is_trivially_destructible_by_v<Alloc, T>) {
+            for(std::size_t i = 0; i != num_of_elem; ++i) {
+                my::allocator_traits<Alloc>::destroy(alloc, first + i);
+            }
+        }
+    }
+
+
+    template<typename Alloc, typename InputIt, typename T>
+    T* uninitialized_copy(Alloc& alloc, InputIt first, InputIt last, T* dest) {
+        using source_type = typename std::iterator_traits<InputIt>::value_type;
+
+        if constexpr (std::is_pointer_v<InputIt> && std::is_same_v<std::remove_cv_t<source_type>, T>
+                      && is_bitwise_constructible_v<Alloc, T, const T&>) {
+            std::size_t num_of_elem = static_cast<std::size_t>(last - first);
+            if (num_of_elem != 0) {
+                std::memcpy(dest, first, num_of_elem * sizeof(T));
+            }
+            return dest + num_of_elem;
+        }
+        else {
+            T* current = dest;
+            try {
+                for(; first != last; ++first, ++current) {
+                    my::allocator_traits<Alloc>::construct(alloc, current, *first);
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, static_cast<std::size_t>(current - dest));
+                throw;
+            }
+            return current;
+        }
+    }
+
+
+    template<typename Alloc, typename T>
+    T* uninitialized_move(Alloc& alloc, T* first, T* last, T* dest) {
+        if constexpr (is_bitwise_constructible_v<Alloc, T, T&&>) {
+            std::size_t num_of_elem = static_cast<std::size_t>(last - first);
+            if (num_of_elem != 0) {
+                std::memcpy(dest, first, num_of_elem * sizeof(T));
+            }
+            return dest + num_of_elem;
+        }
+        else {
+            T* current = dest;
+            try {
+                for(; first != last; ++first, ++current) {
+                    my::allocator_traits<Alloc>::construct(alloc, current, std::move(*first));
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, static_cast<std::size_t>(current - dest));
+                throw;
+            }
+            return current;
+        }
+    }
+
+
+    template<typename Alloc, typename T>
+    T* uninitialized_fill(Alloc& alloc, T* dest, std::size_t num_of_elem, const T& value) {
+        if constexpr (is_bitwise_constructible_v<Alloc, T, const T&> && sizeof(T) == 1) {
+            unsigned char byte;
+            std::memcpy(&byte, &value, 1);
+            std::memset(dest, byte, num_of_elem);
+            return dest + num_of_elem;
+        }
+        else if constexpr (is_bitwise_constructible_v<Alloc, T, const T&>) {
+            for(std::size_t i = 0; i != num_of_elem; ++i) {
+                std::memcpy(dest + i, &value, sizeof(T)); // vectorizes, as opposed to construct_at calls through the traits
+            }
+            return dest + num_of_elem;
+        }
+        else {
+            std::size_t i = 0;
+            try {
+                for(; i != num_of_elem; ++i) {
+                    my::allocator_traits<Alloc>::construct(alloc, dest + i, value);
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, i);
+                throw;
+            }
+            return dest + num_of_elem;
+        }
+    }
+
+
+    template<typename Alloc, typename T>
+    T* uninitialized_value_construct(Alloc& alloc, T* dest, std::size_t num_of_elem) {
+        // value-initialized scalars are all-zero bits (member pointers are the only exception)
+        if constexpr (std::is_scalar_v<T> && !std::is_member_pointer_v<T> && is_bitwise_constructible_v<Alloc, T>) {
+            if (num_of_elem != 0) {
+                std::memset(dest, 0, num_of_elem * sizeof(T));
+            }
+            return dest + num_of_elem;
+        }
+        else {
+            std::size_t i = 0;
+            try {
+                for(; i != num_of_elem; ++i) {
+                    my::allocator_traits<Alloc>::construct(alloc, dest + i);
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, i);
+                throw;
+            }
+            return dest + num_of_elem;
+        }
+    }
+
+
+    // default-initialization: trivial types are left with whatever the memory holds (make_shared_for_overwrite, buffers about to be filled).
+    // The elements are created with placement new and not through the allocator, same as std::uninitialized_default_construct_n
+    template<typename Alloc, typename T>
+    T* uninitialized_default_construct(Alloc& alloc, T* dest, std::size_t num_of_elem) {
+        if constexpr (std::is_trivially_default_constructible_v<T>) {
+            return dest + num_of_elem;
+        }
+        else {
+            std::size_t i = 0;
+            try {
+                for(; i != num_of_elem; ++i) {
+                    ::new(static_cast<void*>(dest + i)) T;
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, i);
+                throw;
+            }
+            return dest + num_of_elem;
+        }
+    }
+
+
+    // moves [first, last) to dest and destroys the source; if T's move constructor may throw and T is copyable,
+    // the elements are copied instead, so on exception the source range is left untouched (strong guarantee)
+    // the ranges may overlap only in the bitwise case, which is exactly what insert/erase-like shifts need
+    template<typename Alloc, typename T>
+    T* uninitialized_relocate(Alloc& alloc, T* first, T* last, T* dest) {
+        std::size_t num_of_elem = static_cast<std::size_t>(last - first);
+        if constexpr (is_bitwise_constructible_v<Alloc, T, T&&> && is_trivially_destructible_by_v<Alloc, T>) {
+            if (num_of_elem != 0) {
+                std::memmove(dest, first, num_of_elem * sizeof(T));
+            }
+        }
+        else {
+            std::size_t i = 0;
+            try {
+                for(; i != num_of_elem; ++i) {
+                    my::allocator_traits<Alloc>::construct(alloc, dest + i, std::move_if_noexcept(*(first + i)));
+                }
+            }
+            catch(...) {
+                destroy_n(alloc, dest, i);
+                throw;
+            }
+            destroy_n(alloc, first, num_of_elem);
+        }
+        return dest + num_of_elem;
+    }
+
+};